@@ -0,0 +1,269 @@
+/**
+ * \file BenchmarkClient.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BenchmarkClient.h"
+#include "LatencyRecorder.h"
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+
+BenchmarkClient::BenchmarkClient(boost::asio::io_service& a_IOService, E_CLIENT_ROLE a_eClientRole, const std::string& a_SerialPortName, LatencyRecorder& a_UplinkLatency):
+    m_IOService(a_IOService), m_Socket(a_IOService), m_eClientRole(a_eClientRole), m_SerialPortName(a_SerialPortName), m_UplinkLatency(a_UplinkLatency),
+    m_ReadBuffer(max_length), m_SendTimer(a_IOService) {
+    m_bStarted = false;
+    m_bConnected = false;
+    m_bFailed = false;
+    m_ReadBufferFill = 0;
+    m_bSending = false;
+    m_eTrafficPattern = TRAFFIC_PATTERN_RELIABLE;
+    m_Rate = 0;
+    m_PayloadSize = 16;
+    m_SequenceNumber = 0;
+    m_bWriting = false;
+    ResetStatistics();
+}
+
+BenchmarkClient::~BenchmarkClient() {
+    Stop();
+}
+
+void BenchmarkClient::Start(const boost::asio::ip::tcp::endpoint& a_Endpoint) {
+    m_bStarted = true;
+    auto self(shared_from_this());
+    m_Socket.async_connect(a_Endpoint, [this, self](const boost::system::error_code& a_ErrorCode) {
+        if (!m_bStarted) {
+            return;
+        } // if
+        
+        if (a_ErrorCode) {
+            Fail("connect: " + a_ErrorCode.message());
+            return;
+        } // if
+        
+        // Session header: version, SAP, serial port name
+        unsigned char l_ServiceAccessPointSpecifier = 0x01;
+        switch (m_eClientRole) {
+            case CLIENT_ROLE_PAYLOAD:     l_ServiceAccessPointSpecifier = 0x01; break;
+            case CLIENT_ROLE_PORT_STATUS: l_ServiceAccessPointSpecifier = 0x10; break;
+            case CLIENT_ROLE_RAW:         l_ServiceAccessPointSpecifier = 0x33; break;
+            case CLIENT_ROLE_DISSECTED:   l_ServiceAccessPointSpecifier = 0x43; break;
+        } // switch
+        
+        boost::system::error_code l_ErrorCode;
+        m_Socket.set_option(boost::asio::ip::tcp::no_delay(true), l_ErrorCode);
+        m_bConnected = true;
+        m_WriteBuffer.clear();
+        m_WriteBuffer.emplace_back(0x00);
+        m_WriteBuffer.emplace_back(l_ServiceAccessPointSpecifier);
+        m_WriteBuffer.emplace_back((unsigned char)m_SerialPortName.size());
+        m_WriteBuffer.insert(m_WriteBuffer.end(), m_SerialPortName.begin(), m_SerialPortName.end());
+        DoWrite();
+        DoRead();
+    });
+}
+
+void BenchmarkClient::StartSending(E_TRAFFIC_PATTERN a_eTrafficPattern, unsigned int a_Rate, size_t a_PayloadSize) {
+    // Only payload clients may send data packets
+    if ((m_eClientRole != CLIENT_ROLE_PAYLOAD) || (m_bSending)) {
+        return;
+    } // if
+    
+    m_bSending = true;
+    m_eTrafficPattern = a_eTrafficPattern;
+    m_Rate = a_Rate;
+    m_PayloadSize = std::max<size_t>(a_PayloadSize, 16);
+    if (m_Rate) {
+        m_SendTimer.expires_from_now(boost::posix_time::microseconds(1000000 / m_Rate));
+        StartSendTimer();
+    } else if ((m_bConnected) && (!m_bWriting)) {
+        SendPacket();
+    } // else if
+}
+
+void BenchmarkClient::Stop() {
+    if (!m_bStarted) {
+        return;
+    } // if
+    
+    m_bStarted = false;
+    m_bSending = false;
+    m_SendTimer.cancel();
+    boost::system::error_code l_ErrorCode;
+    m_Socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, l_ErrorCode);
+    m_Socket.close(l_ErrorCode);
+}
+
+void BenchmarkClient::ResetStatistics() {
+    ::memset(&m_Statistics, 0x00, sizeof(m_Statistics));
+}
+
+void BenchmarkClient::DoRead() {
+    auto self(shared_from_this());
+    m_Socket.async_read_some(boost::asio::buffer(&m_ReadBuffer[m_ReadBufferFill], m_ReadBuffer.size() - m_ReadBufferFill),
+                             [this, self](const boost::system::error_code& a_ErrorCode, std::size_t a_BytesRead) {
+        if (!m_bStarted) {
+            return;
+        } // if
+        
+        if (a_ErrorCode) {
+            Fail("read: " + a_ErrorCode.message());
+            return;
+        } // if
+        
+        m_ReadBufferFill += a_BytesRead;
+        if (InterpretReceivedBytes()) {
+            DoRead();
+        } // if
+    });
+}
+
+void BenchmarkClient::DoWrite() {
+    auto self(shared_from_this());
+    m_bWriting = true;
+    boost::asio::async_write(m_Socket, boost::asio::buffer(m_WriteBuffer), [this, self](const boost::system::error_code& a_ErrorCode, std::size_t) {
+        m_bWriting = false;
+        if (!m_bStarted) {
+            return;
+        } // if
+        
+        if (a_ErrorCode) {
+            Fail("write: " + a_ErrorCode.message());
+            return;
+        } // if
+        
+        if ((m_bSending) && (m_Rate == 0)) {
+            // Back-to-back, stalled only by the HDLCd
+            SendPacket();
+        } // if
+    });
+}
+
+void BenchmarkClient::StartSendTimer() {
+    auto self(shared_from_this());
+    m_SendTimer.async_wait([this, self](const boost::system::error_code& a_ErrorCode) {
+        if ((a_ErrorCode) || (!m_bStarted) || (!m_bSending)) {
+            return;
+        } // if
+        
+        if ((m_bConnected) && (!m_bWriting)) {
+            SendPacket();
+        } else {
+            ++m_Statistics.m_PacketsDeferred;
+        } // else
+        
+        m_SendTimer.expires_at(m_SendTimer.expires_at() + boost::posix_time::microseconds(1000000 / m_Rate));
+        StartSendTimer();
+    });
+}
+
+void BenchmarkClient::SendPacket() {
+    // Data packet: type, length, sequence number, timestamp, filler
+    bool l_bReliable = ((m_eTrafficPattern == TRAFFIC_PATTERN_RELIABLE) || ((m_eTrafficPattern == TRAFFIC_PATTERN_MIXED) && (m_SequenceNumber & 0x01)));
+    m_WriteBuffer.resize(3 + m_PayloadSize);
+    m_WriteBuffer[0] = (l_bReliable ? 0x04 : 0x00);
+    m_WriteBuffer[1] = ((m_PayloadSize >> 8) & 0xFF);
+    m_WriteBuffer[2] = (m_PayloadSize & 0xFF);
+    LatencyRecorder::WriteTimestamp(&m_WriteBuffer[3], m_SequenceNumber++);
+    LatencyRecorder::WriteTimestamp(&m_WriteBuffer[11], LatencyRecorder::GetTimestamp());
+    for (size_t l_Index = 19; l_Index < m_WriteBuffer.size(); ++l_Index) {
+        m_WriteBuffer[l_Index] = (l_Index & 0xFF);
+    } // for
+    
+    ++m_Statistics.m_PacketsSent;
+    DoWrite();
+}
+
+bool BenchmarkClient::InterpretReceivedBytes() {
+    uint64_t l_Now = LatencyRecorder::GetTimestamp();
+    size_t l_Offset = 0;
+    while (l_Offset < m_ReadBufferFill) {
+        const unsigned char* l_Packet = &m_ReadBuffer[l_Offset];
+        size_t l_Available = (m_ReadBufferFill - l_Offset);
+        size_t l_PacketSize = 0;
+        switch (l_Packet[0] & 0xF0) {
+            case 0x00: {
+                // Data packet
+                if (l_Available < 3) {
+                    break;
+                } // if
+                
+                size_t l_PayloadSize = ((l_Packet[1] << 8) | l_Packet[2]);
+                if (l_Available < (3 + l_PayloadSize)) {
+                    break;
+                } // if
+                
+                l_PacketSize = (3 + l_PayloadSize);
+                ++m_Statistics.m_DataPacketsReceived;
+                m_Statistics.m_BytesReceived += l_PayloadSize;
+                if ((m_eClientRole == CLIENT_ROLE_PAYLOAD) && ((l_Packet[0] & 0x03) == 0x00) && (l_PayloadSize >= 16)) {
+                    // A valid uplink payload of the device simulator
+                    m_UplinkLatency.Add(LatencyRecorder::ReadTimestamp(&l_Packet[11]), l_Now);
+                } // if
+                
+                break;
+            }
+            case 0x10: {
+                // Control packet
+                if (l_Available >= 2) {
+                    l_PacketSize = 2;
+                    ++m_Statistics.m_ControlPacketsReceived;
+                } // if
+                
+                break;
+            }
+            case 0x30: {
+                // Extended control packet
+                if ((l_Available >= 4) && (l_Available >= (size_t)(4 + ((l_Packet[2] << 8) | l_Packet[3])))) {
+                    l_PacketSize = (4 + ((l_Packet[2] << 8) | l_Packet[3]));
+                    ++m_Statistics.m_ControlPacketsReceived;
+                } // if
+                
+                break;
+            }
+            default: {
+                // Batched data packets were not requested
+                Fail("unexpected packet type");
+                return false;
+            }
+        } // switch
+        
+        if (l_PacketSize == 0) {
+            // Incomplete
+            break;
+        } // if
+        
+        l_Offset += l_PacketSize;
+    } // while
+    
+    // Keep the incomplete remainder
+    if (l_Offset) {
+        ::memmove(&m_ReadBuffer[0], &m_ReadBuffer[l_Offset], m_ReadBufferFill - l_Offset);
+        m_ReadBufferFill -= l_Offset;
+    } // if
+    
+    return true;
+}
+
+void BenchmarkClient::Fail(const std::string& a_Reason) {
+    std::cerr << "Benchmark client of " << m_SerialPortName << " failed: " << a_Reason << std::endl;
+    m_bFailed = true;
+    Stop();
+}
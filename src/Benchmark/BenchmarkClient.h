@@ -0,0 +1,114 @@
+/**
+ * \file BenchmarkClient.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_CLIENT_H
+#define BENCHMARK_CLIENT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/asio.hpp>
+class LatencyRecorder;
+
+// The role of a client, i.e., its session type
+typedef enum {
+    CLIENT_ROLE_PAYLOAD     = 0, // Payload RX/TX, only received data are delivered (gateway mode)
+    CLIENT_ROLE_PORT_STATUS = 1, // Port status only
+    CLIENT_ROLE_RAW         = 2, // HDLC raw, RX and TX
+    CLIENT_ROLE_DISSECTED   = 3  // HDLC dissected, RX and TX
+} E_CLIENT_ROLE;
+
+// The kind of data packets sent by payload clients
+typedef enum {
+    TRAFFIC_PATTERN_RELIABLE   = 0,
+    TRAFFIC_PATTERN_UNRELIABLE = 1,
+    TRAFFIC_PATTERN_MIXED      = 2  // Alternating
+} E_TRAFFIC_PATTERN;
+
+/*! \class BenchmarkClient
+ *  \brief Class BenchmarkClient
+ * 
+ *  A client of the access protocol of the HDLCd, generating load for benchmarks. Payload clients send data packets at
+ *  a fixed rate, or back-to-back if the rate is 0. Each payload starts with a 64-bit sequence number and a 64-bit
+ *  CLOCK_MONOTONIC timestamp, the same format as the uplink payloads of the device simulator. Received uplink payloads
+ *  are evaluated by payload clients for the device-to-TCP latency. All other clients just count the received packets.
+ */
+class BenchmarkClient: public std::enable_shared_from_this<BenchmarkClient> {
+public:
+    // CTOR and DTOR
+    BenchmarkClient(boost::asio::io_service& a_IOService, E_CLIENT_ROLE a_eClientRole, const std::string& a_SerialPortName, LatencyRecorder& a_UplinkLatency);
+    ~BenchmarkClient();
+    
+    void Start(const boost::asio::ip::tcp::endpoint& a_Endpoint);
+    void StartSending(E_TRAFFIC_PATTERN a_eTrafficPattern, unsigned int a_Rate, size_t a_PayloadSize);
+    void Stop();
+    bool IsFailed() const { return m_bFailed; }
+    
+    // Statistics
+    typedef struct {
+        uint64_t m_PacketsSent;
+        uint64_t m_PacketsDeferred;    //!< Sends skipped due to backpressure of the HDLCd
+        uint64_t m_DataPacketsReceived;
+        uint64_t m_BytesReceived;
+        uint64_t m_ControlPacketsReceived;
+    } Statistics;
+    const Statistics& GetStatistics() const { return m_Statistics; }
+    void ResetStatistics();
+    
+private:
+    // Internal helpers
+    void DoRead();
+    void DoWrite();
+    void StartSendTimer();
+    void SendPacket();
+    bool InterpretReceivedBytes();
+    void Fail(const std::string& a_Reason);
+    
+    // Members
+    boost::asio::io_service& m_IOService;
+    boost::asio::ip::tcp::socket m_Socket;
+    E_CLIENT_ROLE m_eClientRole;
+    std::string m_SerialPortName;
+    LatencyRecorder& m_UplinkLatency;
+    bool m_bStarted;
+    bool m_bConnected;
+    bool m_bFailed;
+    
+    // Receiving
+    enum { max_length = 131072 }; // Sufficient for the largest data packet
+    std::vector<unsigned char> m_ReadBuffer;
+    size_t m_ReadBufferFill;
+    
+    // Sending
+    bool m_bSending;
+    E_TRAFFIC_PATTERN m_eTrafficPattern;
+    unsigned int m_Rate;
+    size_t m_PayloadSize;
+    uint64_t m_SequenceNumber;
+    std::vector<unsigned char> m_WriteBuffer;
+    bool m_bWriting;
+    boost::asio::deadline_timer m_SendTimer;
+    
+    Statistics m_Statistics;
+};
+
+#endif // BENCHMARK_CLIENT_H
@@ -0,0 +1,88 @@
+/**
+ * \file LatencyRecorder.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LatencyRecorder.h"
+#include <algorithm>
+#include <chrono>
+
+LatencyRecorder::LatencyRecorder() {
+    m_bRecording = false;
+    m_bSorted = true;
+    m_Start = 0;
+    m_Samples.reserve(1024 * 1024);
+}
+
+void LatencyRecorder::Start(uint64_t a_Now) {
+    m_bRecording = true;
+    m_bSorted = true;
+    m_Start = a_Now;
+    m_Samples.clear();
+}
+
+void LatencyRecorder::Stop() {
+    m_bRecording = false;
+}
+
+void LatencyRecorder::Add(uint64_t a_Sent, uint64_t a_Received) {
+    if ((m_bRecording) && (a_Sent >= m_Start) && (a_Received >= a_Sent)) {
+        m_Samples.emplace_back(a_Received - a_Sent);
+        m_bSorted = false;
+    } // if
+}
+
+uint64_t LatencyRecorder::GetPercentile(double a_Percentile) {
+    if (m_Samples.empty()) {
+        return 0;
+    } // if
+    
+    if (!m_bSorted) {
+        std::sort(m_Samples.begin(), m_Samples.end());
+        m_bSorted = true;
+    } // if
+    
+    // Nearest rank
+    size_t l_Index = (size_t)(a_Percentile / 100.0 * m_Samples.size());
+    return m_Samples[std::min(l_Index, m_Samples.size() - 1)];
+}
+
+uint64_t LatencyRecorder::GetMaximum() {
+    return GetPercentile(100.0);
+}
+
+uint64_t LatencyRecorder::GetTimestamp() {
+    // The same clock as used by the device simulator for uplink payloads
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyRecorder::WriteTimestamp(unsigned char* a_Buffer, uint64_t a_Value) {
+    for (int l_Index = 0; l_Index < 8; ++l_Index) {
+        a_Buffer[l_Index] = ((a_Value >> (56 - 8 * l_Index)) & 0xFF);
+    } // for
+}
+
+uint64_t LatencyRecorder::ReadTimestamp(const unsigned char* a_Buffer) {
+    uint64_t l_Value = 0;
+    for (int l_Index = 0; l_Index < 8; ++l_Index) {
+        l_Value = ((l_Value << 8) | a_Buffer[l_Index]);
+    } // for
+    
+    return l_Value;
+}
@@ -0,0 +1,61 @@
+/**
+ * \file LatencyRecorder.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_RECORDER_H
+#define LATENCY_RECORDER_H
+
+#include <vector>
+#include <stdint.h>
+
+/*! \class LatencyRecorder
+ *  \brief Class LatencyRecorder
+ * 
+ *  Collects latency samples of a measurement interval. Only samples of payloads that were sent after the start of the
+ *  interval are recorded, thus, payloads of the warmup phase do not distort the result. All timestamps are
+ *  CLOCK_MONOTONIC in nanoseconds.
+ */
+class LatencyRecorder {
+public:
+    // CTOR
+    LatencyRecorder();
+    
+    void Start(uint64_t a_Now);
+    void Stop();
+    void Add(uint64_t a_Sent, uint64_t a_Received);
+    
+    // Evaluation, in nanoseconds
+    uint64_t GetCount() const { return m_Samples.size(); }
+    uint64_t GetPercentile(double a_Percentile);
+    uint64_t GetMaximum();
+    
+    static uint64_t GetTimestamp();
+    static void WriteTimestamp(unsigned char* a_Buffer, uint64_t a_Value);
+    static uint64_t ReadTimestamp(const unsigned char* a_Buffer);
+    
+private:
+    // Members
+    bool m_bRecording;
+    bool m_bSorted;
+    uint64_t m_Start;
+    std::vector<uint64_t> m_Samples;
+};
+
+#endif // LATENCY_RECORDER_H
@@ -0,0 +1,131 @@
+/**
+ * \file MicroBenchmark.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MicroBenchmark.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Counts all heap allocations of the process. The benchmarks are single-threaded, a plain counter is sufficient.
+static uint64_t g_Allocations = 0;
+
+void* operator new(std::size_t a_Size) {
+    ++g_Allocations;
+    void* l_Pointer = std::malloc(a_Size ? a_Size : 1);
+    if (!l_Pointer) {
+        throw std::bad_alloc();
+    } // if
+    
+    return l_Pointer;
+}
+
+void* operator new[](std::size_t a_Size) {
+    return operator new(a_Size);
+}
+
+void operator delete(void* a_Pointer) noexcept {
+    std::free(a_Pointer);
+}
+
+void operator delete[](void* a_Pointer) noexcept {
+    std::free(a_Pointer);
+}
+
+void operator delete(void* a_Pointer, std::size_t) noexcept {
+    std::free(a_Pointer);
+}
+
+void operator delete[](void* a_Pointer, std::size_t) noexcept {
+    std::free(a_Pointer);
+}
+
+MicroBenchmark::MicroBenchmark(double a_MinimumSeconds, const std::string& a_Filter): m_MinimumSeconds(a_MinimumSeconds), m_Filter(a_Filter) {
+}
+
+bool MicroBenchmark::Run(const std::string& a_Name, size_t a_BytesPerIteration, std::function<size_t()> a_Function) {
+    if ((!m_Filter.empty()) && (a_Name.find(m_Filter) == std::string::npos)) {
+        return false;
+    } // if
+    
+    // Warm up caches and lazily allocated buffers first
+    a_Function();
+    
+    Result l_Result;
+    l_Result.m_Name = a_Name;
+    for (uint64_t l_Iterations = 1; ; l_Iterations *= 2) {
+        uint64_t l_Frames = 0;
+        uint64_t l_Allocations = g_Allocations;
+        auto l_Start = std::chrono::steady_clock::now();
+        for (uint64_t l_Iteration = 0; l_Iteration < l_Iterations; ++l_Iteration) {
+            l_Frames += a_Function();
+        } // for
+        
+        double l_Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - l_Start).count();
+        l_Allocations = (g_Allocations - l_Allocations);
+        if ((l_Seconds >= m_MinimumSeconds) || (l_Iterations >= (1ULL << 40))) {
+            l_Result.m_Iterations = l_Iterations;
+            l_Result.m_Seconds = l_Seconds;
+            l_Result.m_Bytes = (l_Iterations * a_BytesPerIteration);
+            l_Result.m_Frames = l_Frames;
+            l_Result.m_Allocations = l_Allocations;
+            break;
+        } // if
+    } // for
+    
+    m_Results.emplace_back(l_Result);
+    return true;
+}
+
+void MicroBenchmark::PrintResults(std::ostream& a_OutputStream, bool a_bJson) const {
+    char l_Line[256];
+    if (a_bJson) {
+        a_OutputStream << "[" << std::endl;
+    } else {
+        snprintf(l_Line, sizeof(l_Line), "%-36s %12s %12s %12s %14s\n", "benchmark", "ns/iter", "MB/s", "frames/s", "allocs/frame");
+        a_OutputStream << l_Line;
+    } // else
+    
+    for (auto it = m_Results.begin(); it != m_Results.end(); ++it) {
+        double l_NanosecondsPerIteration = (it->m_Seconds * 1e9 / it->m_Iterations);
+        double l_BytesPerSecond  = (it->m_Bytes / it->m_Seconds);
+        double l_FramesPerSecond = (it->m_Frames / it->m_Seconds);
+        double l_AllocationsPerFrame = (it->m_Frames ? ((double)it->m_Allocations / it->m_Frames) : 0.0);
+        if (a_bJson) {
+            snprintf(l_Line, sizeof(l_Line), "  {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_iteration\": %.1f, \"bytes_per_s\": %.0f, "
+                     "\"frames_per_s\": %.0f, \"allocations_per_frame\": %.3f}%s\n", it->m_Name.c_str(), (unsigned long long)it->m_Iterations,
+                     l_NanosecondsPerIteration, l_BytesPerSecond, l_FramesPerSecond, l_AllocationsPerFrame, ((it + 1 == m_Results.end()) ? "" : ","));
+        } else {
+            snprintf(l_Line, sizeof(l_Line), "%-36s %12.1f %12.1f %12.0f %14.3f\n", it->m_Name.c_str(), l_NanosecondsPerIteration,
+                     (l_BytesPerSecond / 1e6), l_FramesPerSecond, l_AllocationsPerFrame);
+        } // else
+        
+        a_OutputStream << l_Line;
+    } // for
+    
+    if (a_bJson) {
+        a_OutputStream << "]" << std::endl;
+    } // if
+}
+
+uint64_t MicroBenchmark::GetAllocations() {
+    return g_Allocations;
+}
@@ -0,0 +1,66 @@
+/**
+ * \file MicroBenchmark.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MICRO_BENCHMARK_H
+#define MICRO_BENCHMARK_H
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*! \class MicroBenchmark
+ *  \brief Class MicroBenchmark
+ * 
+ *  Runs single functions of the HDLC code in a loop and reports the time, the throughput, and the number of heap
+ *  allocations. Each function runs a fixed workload per iteration and returns the number of frames it processed. The
+ *  number of iterations is doubled until the measurement lasts for the given minimum time, thus, the result does not
+ *  depend on the speed of the machine. Heap allocations are counted via replaced global operators new and delete,
+ *  which are part of this translation unit.
+ */
+class MicroBenchmark {
+public:
+    // CTOR
+    MicroBenchmark(double a_MinimumSeconds, const std::string& a_Filter);
+    
+    bool Run(const std::string& a_Name, size_t a_BytesPerIteration, std::function<size_t()> a_Function);
+    void PrintResults(std::ostream& a_OutputStream, bool a_bJson) const;
+    
+    static uint64_t GetAllocations();
+    
+private:
+    // Members
+    double m_MinimumSeconds;
+    std::string m_Filter;
+    
+    typedef struct {
+        std::string m_Name;
+        uint64_t m_Iterations;
+        double m_Seconds;
+        uint64_t m_Bytes;
+        uint64_t m_Frames;
+        uint64_t m_Allocations;
+    } Result;
+    std::vector<Result> m_Results;
+};
+
+#endif // MICRO_BENCHMARK_H
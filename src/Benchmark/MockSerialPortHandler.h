@@ -0,0 +1,67 @@
+/**
+ * \file MockSerialPortHandler.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOCK_SERIAL_PORT_HANDLER_H
+#define MOCK_SERIAL_PORT_HANDLER_H
+
+#include <vector>
+#include <stdint.h>
+#include "ISerialPortHandler.h"
+
+/*! \class MockSerialPortHandler
+ *  \brief Class MockSerialPortHandler
+ * 
+ *  Stands in for the SerialPortHandler to drive a ProtocolState object without a serial port and without clients.
+ *  Transmitted HDLC frames are not written anywhere, but the last one is kept for inspection. Buffers for clients are
+ *  only counted.
+ */
+class MockSerialPortHandler: public ISerialPortHandler {
+public:
+    // CTOR
+    MockSerialPortHandler(bool a_bSniffers): m_bSniffers(a_bSniffers), m_TransmittedFrames(0), m_DeliveredBuffers(0) {}
+    
+    // Methods called by the HDLC ProtocolState object
+    bool RequiresBufferType(E_BUFFER_TYPE a_eBufferType) const {
+        return ((a_eBufferType == BUFFER_TYPE_PAYLOAD) || ((m_bSniffers) && ((a_eBufferType == BUFFER_TYPE_RAW) || (a_eBufferType == BUFFER_TYPE_DISSECTED))));
+    }
+    
+    bool RequiresHdlcFrame(E_BUFFER_TYPE) const { return false; }
+    void DeliverBufferToClients(E_BUFFER_TYPE, const std::vector<unsigned char>&, bool, bool, bool, const HdlcFrame*) { ++m_DeliveredBuffers; }
+    void DeliverGapToClients(E_BUFFER_TYPE, uint32_t) {}
+    void ChangeBaudRate() {}
+    void PropagateSerialPortState() {}
+    void TransmitHDLCFrame(const std::vector<unsigned char> &a_Payload) { m_LastTransmittedFrame = a_Payload; ++m_TransmittedFrames; }
+    void QueryForPayload(bool, bool) {}
+    
+    // Inspection
+    const std::vector<unsigned char>& GetLastTransmittedFrame() const { return m_LastTransmittedFrame; }
+    uint64_t GetTransmittedFrames() const { return m_TransmittedFrames; }
+    uint64_t GetDeliveredBuffers() const { return m_DeliveredBuffers; }
+    
+private:
+    // Members
+    bool m_bSniffers;
+    std::vector<unsigned char> m_LastTransmittedFrame;
+    uint64_t m_TransmittedFrames;
+    uint64_t m_DeliveredBuffers;
+};
+
+#endif // MOCK_SERIAL_PORT_HANDLER_H
@@ -0,0 +1,593 @@
+/**
+ * \file DeviceSimulator.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DeviceSimulator.h"
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <boost/system/system_error.hpp>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "FrameGenerator.h"
+
+DeviceSimulator::DeviceSimulator(boost::asio::io_service& a_IOService, const DeviceSimulatorSettings& a_Settings): m_IOService(a_IOService), m_Settings(a_Settings),
+    m_RandomGenerator(a_Settings.m_Seed), m_Master(a_IOService), m_Stdin(a_IOService), m_TurnaroundTimer(a_IOService), m_RetransmissionTimer(a_IOService),
+    m_UplinkTimer(a_IOService) {
+    m_bStarted = false;
+    m_SlaveFileDescriptor = -1;
+    m_bLinked = false;
+    m_bWriting = false;
+    m_RSeqIncoming = 0;
+    m_UnackedFrames = 0;
+    m_bBusy = false;
+    m_bTurnaroundTimerRunning = false;
+    m_SSeqOutgoing = 0;
+    m_SSeqUnacked = 0;
+    m_bPeerBusy = false;
+    m_bRetransmissionTimerRunning = false;
+    m_UplinkSequence = 0;
+    ::memset(&m_Statistics, 0x00, sizeof(m_Statistics));
+}
+
+DeviceSimulator::~DeviceSimulator() {
+    Stop();
+}
+
+bool DeviceSimulator::Start() {
+    assert(!m_bStarted);
+    if (!OpenPseudoTerminal()) {
+        return false;
+    } // if
+    
+    m_bStarted = true;
+    DoRead();
+    
+    // Commands are optional, e.g., stdin may be /dev/null
+    int l_Stdin = (m_Settings.m_bCommands ? ::dup(STDIN_FILENO) : -1);
+    if (l_Stdin >= 0) {
+        boost::system::error_code l_ErrorCode;
+        m_Stdin.assign(l_Stdin, l_ErrorCode);
+        if (!l_ErrorCode) {
+            DoReadCommand();
+        } else {
+            ::close(l_Stdin);
+        } // else
+    } // if
+    
+    if (m_Settings.m_UplinkRate) {
+        m_UplinkTimer.expires_from_now(boost::posix_time::microseconds(1000000 / m_Settings.m_UplinkRate));
+        StartUplinkTimer();
+    } // if
+    
+    return true;
+}
+
+void DeviceSimulator::Stop() {
+    if (!m_bStarted) {
+        return;
+    } // if
+    
+    m_bStarted = false;
+    boost::system::error_code l_ErrorCode;
+    m_TurnaroundTimer.cancel();
+    m_RetransmissionTimer.cancel();
+    m_UplinkTimer.cancel();
+    m_Stdin.close(l_ErrorCode);
+    m_Master.close(l_ErrorCode);
+    if (m_SlaveFileDescriptor >= 0) {
+        ::close(m_SlaveFileDescriptor);
+        m_SlaveFileDescriptor = -1;
+    } // if
+    
+    if (m_bLinked) {
+        m_bLinked = false;
+        ::unlink(m_Settings.m_LinkPath.c_str());
+    } // if
+}
+
+void DeviceSimulator::PrintStatistics(std::ostream& a_OutputStream) const {
+    a_OutputStream << "frames received:          " << m_Statistics.m_FramesReceived << std::endl
+                   << "frames invalid:           " << m_Statistics.m_FramesInvalid << std::endl
+                   << "frames transmitted:       " << m_Statistics.m_FramesTransmitted << std::endl
+                   << "probes answered:          " << m_Statistics.m_ProbesAnswered << std::endl
+                   << "I-frames accepted:        " << m_Statistics.m_IFramesAccepted << std::endl
+                   << "I-frames out of sequence: " << m_Statistics.m_IFramesOutOfSequence << std::endl
+                   << "I-frames refused (RNR):   " << m_Statistics.m_IFramesRefused << std::endl
+                   << "UI-frames received:       " << m_Statistics.m_UIFramesReceived << std::endl
+                   << "uplink payloads:          " << m_Statistics.m_UplinkPayloads << std::endl
+                   << "uplink payloads dropped:  " << m_Statistics.m_UplinkDropped << std::endl
+                   << "retransmissions:          " << m_Statistics.m_Retransmissions << std::endl
+                   << "injected bit errors:      " << m_Statistics.m_InjectedBitErrors << std::endl
+                   << "injected RX drops:        " << m_Statistics.m_InjectedRxDrops << std::endl
+                   << "injected TX drops:        " << m_Statistics.m_InjectedTxDrops << std::endl
+                   << "baud rate mismatches:     " << m_Statistics.m_BaudRateMismatches << std::endl;
+}
+
+bool DeviceSimulator::OpenPseudoTerminal() {
+    int l_MasterFileDescriptor = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (l_MasterFileDescriptor < 0) {
+        std::cerr << "Failed to open a pseudo terminal: " << ::strerror(errno) << std::endl;
+        return false;
+    } // if
+    
+    const char* l_SlaveName = NULL;
+    if ((::grantpt(l_MasterFileDescriptor) != 0) || (::unlockpt(l_MasterFileDescriptor) != 0) || ((l_SlaveName = ::ptsname(l_MasterFileDescriptor)) == NULL)) {
+        std::cerr << "Failed to prepare the pseudo terminal: " << ::strerror(errno) << std::endl;
+        ::close(l_MasterFileDescriptor);
+        return false;
+    } // if
+    
+    // Raw mode until the HDLCd configures the serial port itself
+    m_SlavePath = l_SlaveName;
+    m_SlaveFileDescriptor = ::open(m_SlavePath.c_str(), O_RDWR | O_NOCTTY);
+    struct termios l_Termios;
+    if ((m_SlaveFileDescriptor < 0) || (::tcgetattr(m_SlaveFileDescriptor, &l_Termios) != 0)) {
+        std::cerr << "Failed to open " << m_SlavePath << ": " << ::strerror(errno) << std::endl;
+        ::close(l_MasterFileDescriptor);
+        return false;
+    } // if
+    
+    ::cfmakeraw(&l_Termios);
+    ::tcsetattr(m_SlaveFileDescriptor, TCSANOW, &l_Termios);
+    m_Master.assign(l_MasterFileDescriptor);
+    
+    // Replace a stale link of a previous run, but never anything else
+    if (!m_Settings.m_LinkPath.empty()) {
+        struct stat l_Stat;
+        if ((::lstat(m_Settings.m_LinkPath.c_str(), &l_Stat) == 0) && (S_ISLNK(l_Stat.st_mode))) {
+            ::unlink(m_Settings.m_LinkPath.c_str());
+        } // if
+        
+        if (::symlink(m_SlavePath.c_str(), m_Settings.m_LinkPath.c_str()) != 0) {
+            std::cerr << "Failed to link " << m_Settings.m_LinkPath << " to " << m_SlavePath << ": " << ::strerror(errno) << std::endl;
+            return false;
+        } // if
+        
+        m_bLinked = true;
+    } // if
+    
+    std::cerr << "Simulated device at " << m_SlavePath << (m_bLinked ? (", linked at " + m_Settings.m_LinkPath) : std::string()) << std::endl;
+    return true;
+}
+
+void DeviceSimulator::DoRead() {
+    auto self(shared_from_this());
+    m_Master.async_read_some(boost::asio::buffer(m_ReadBuffer, max_length), [this, self](const boost::system::error_code& a_ErrorCode, std::size_t a_BytesRead) {
+        if (!m_bStarted) {
+            return;
+        } // if
+        
+        if (a_ErrorCode) {
+            std::cerr << "Failed to read from the pseudo terminal: " << a_ErrorCode.message() << std::endl;
+            m_IOService.stop();
+            return;
+        } // if
+        
+        if (!IsBaudRateMatching()) {
+            // At a wrong baud rate, the device sees only junk
+            ++m_Statistics.m_BaudRateMismatches;
+            m_FrameParser.Reset();
+        } else {
+            m_DeserializedFrames.clear();
+            m_FrameParser.AddReceivedRawBytes(m_ReadBuffer, a_BytesRead, m_DeserializedFrames);
+            for (auto it = m_DeserializedFrames.begin(); it != m_DeserializedFrames.end(); ++it) {
+                ++m_Statistics.m_FramesReceived;
+                if (it->m_bMessageInvalid) {
+                    ++m_Statistics.m_FramesInvalid;
+                } else if (Chance(m_Settings.m_RxDropRate)) {
+                    ++m_Statistics.m_InjectedRxDrops;
+                } else {
+                    InterpretFrame(it->m_HdlcFrame);
+                } // else
+            } // for
+        } // else
+        
+        DoRead();
+    });
+}
+
+void DeviceSimulator::DoWrite() {
+    auto self(shared_from_this());
+    m_bWriting = true;
+    boost::asio::async_write(m_Master, boost::asio::buffer(m_WriteQueue.front()), [this, self](const boost::system::error_code& a_ErrorCode, std::size_t) {
+        m_bWriting = false;
+        if (!m_bStarted) {
+            return;
+        } // if
+        
+        if (a_ErrorCode) {
+            std::cerr << "Failed to write to the pseudo terminal: " << a_ErrorCode.message() << std::endl;
+            m_IOService.stop();
+            return;
+        } // if
+        
+        m_WriteQueue.pop_front();
+        if (!m_WriteQueue.empty()) {
+            DoWrite();
+        } // if
+    });
+}
+
+void DeviceSimulator::DoReadCommand() {
+    auto self(shared_from_this());
+    boost::asio::async_read_until(m_Stdin, m_CommandBuffer, '\n', [this, self](const boost::system::error_code& a_ErrorCode, std::size_t) {
+        if ((!m_bStarted) || (a_ErrorCode)) {
+            // No more commands, e.g., end of file
+            return;
+        } // if
+        
+        std::istream l_InputStream(&m_CommandBuffer);
+        std::string l_Command;
+        std::getline(l_InputStream, l_Command);
+        ExecuteCommand(l_Command);
+        if (m_bStarted) {
+            DoReadCommand();
+        } // if
+    });
+}
+
+void DeviceSimulator::ExecuteCommand(const std::string& a_Command) {
+    std::stringstream l_Command(a_Command);
+    std::string l_Verb;
+    l_Command >> l_Verb;
+    if (l_Verb.empty()) {
+        return;
+    } else if (l_Verb == "rnr") {
+        // Refuse all subsequent I-frames until "rr"
+        m_bBusy = true;
+        SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_RNR, false);
+    } else if (l_Verb == "rr") {
+        m_bBusy = false;
+        SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_RR, false);
+    } else if (l_Verb == "rej") {
+        SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_REJ, false);
+    } else if (l_Verb == "srej") {
+        SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_SREJ, false);
+    } else if (l_Verb == "baud") {
+        unsigned int l_BaudRate = 0;
+        if (l_Command >> l_BaudRate) {
+            m_Settings.m_BaudRate = l_BaudRate;
+        } else {
+            std::cerr << "Usage: baud RATE, 0 to accept any baud rate" << std::endl;
+        } // else
+    } else if (l_Verb == "stats") {
+        PrintStatistics(std::cout);
+    } else if (l_Verb == "quit") {
+        m_IOService.stop();
+    } else {
+        std::cerr << "Unknown command " << l_Verb << ", expected rnr, rr, rej, srej, baud RATE, stats, or quit" << std::endl;
+    } // else
+}
+
+bool DeviceSimulator::IsBaudRateMatching() const {
+    // The HDLCd configures the baud rate via the slave side
+    if (m_Settings.m_BaudRate == 0) {
+        return true;
+    } // if
+    
+    struct termios l_Termios;
+    if (::tcgetattr(m_SlaveFileDescriptor, &l_Termios) != 0) {
+        return true;
+    } // if
+    
+    speed_t l_Speed = ::cfgetospeed(&l_Termios);
+    switch (m_Settings.m_BaudRate) {
+        case 9600:   return (l_Speed == B9600);
+        case 19200:  return (l_Speed == B19200);
+        case 38400:  return (l_Speed == B38400);
+        case 57600:  return (l_Speed == B57600);
+        case 115200: return (l_Speed == B115200);
+        case 230400: return (l_Speed == B230400);
+        default:     return false;
+    } // switch
+}
+
+void DeviceSimulator::InterpretFrame(const HdlcFrame& a_HdlcFrame) {
+    switch (a_HdlcFrame.GetHDLCFrameType()) {
+        case HdlcFrame::HDLC_FRAMETYPE_U_TEST: {
+            // A probe of the HDLCd
+            HdlcFrame l_HdlcFrame;
+            l_HdlcFrame.SetAddress(a_HdlcFrame.GetAddress());
+            l_HdlcFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_U_TEST);
+            l_HdlcFrame.SetPF(a_HdlcFrame.IsPF());
+            TransmitFrame(l_HdlcFrame);
+            ++m_Statistics.m_ProbesAnswered;
+            break;
+        }
+        case HdlcFrame::HDLC_FRAMETYPE_U_UI: {
+            ++m_Statistics.m_UIFramesReceived;
+            if (m_OnPayloadCallback) {
+                m_OnPayloadCallback(a_HdlcFrame.GetPayload(), false);
+            } // if
+            
+            if (m_Settings.m_bEcho) {
+                SendUplinkPayload(a_HdlcFrame.GetPayload(), false);
+            } // if
+            
+            break;
+        }
+        case HdlcFrame::HDLC_FRAMETYPE_I: {
+            if (m_bBusy) {
+                // Refused, the HDLCd queries us periodically
+                ++m_Statistics.m_IFramesRefused;
+                SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_RNR, false);
+            } else if (a_HdlcFrame.GetSSeq() == m_RSeqIncoming) {
+                ++m_Statistics.m_IFramesAccepted;
+                m_RSeqIncoming = ((m_RSeqIncoming + 1) & 0x07);
+                ++m_UnackedFrames;
+                if (m_OnPayloadCallback) {
+                    m_OnPayloadCallback(a_HdlcFrame.GetPayload(), true);
+                } // if
+                
+                if (m_Settings.m_bEcho) {
+                    SendUplinkPayload(a_HdlcFrame.GetPayload(), true);
+                } // if
+                
+                ScheduleAck();
+            } else {
+                ++m_Statistics.m_IFramesOutOfSequence;
+                if (m_Settings.m_eNakMode == NAK_MODE_REJ) {
+                    SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_REJ, false);
+                } else if (m_Settings.m_eNakMode == NAK_MODE_SREJ) {
+                    SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_SREJ, false);
+                } // else if
+            } // else
+            
+            ProcessAck(a_HdlcFrame.GetRSeq());
+            break;
+        }
+        case HdlcFrame::HDLC_FRAMETYPE_S_RR: {
+            m_bPeerBusy = false;
+            if (a_HdlcFrame.IsPF()) {
+                // A query of our receive state
+                SendSFrame((m_bBusy ? HdlcFrame::HDLC_FRAMETYPE_S_RNR : HdlcFrame::HDLC_FRAMETYPE_S_RR), true);
+            } // if
+            
+            ProcessAck(a_HdlcFrame.GetRSeq());
+            break;
+        }
+        case HdlcFrame::HDLC_FRAMETYPE_S_RNR: {
+            m_bPeerBusy = true;
+            ProcessAck(a_HdlcFrame.GetRSeq());
+            break;
+        }
+        case HdlcFrame::HDLC_FRAMETYPE_S_REJ:
+        case HdlcFrame::HDLC_FRAMETYPE_S_SREJ: {
+            // Go back to the requested I-frame, this simulator does not retransmit selectively
+            m_bPeerBusy = false;
+            ProcessAck(a_HdlcFrame.GetRSeq());
+            Retransmit();
+            break;
+        }
+        default:
+            // Not used by the HDLCd
+            break;
+    } // switch
+}
+
+void DeviceSimulator::ProcessAck(unsigned char a_RSeq) {
+    // Release all I-frames up to, but excluding, the given sequence number. Ignore acks for frames we never sent.
+    unsigned char l_Acked = ((a_RSeq - m_SSeqUnacked) & 0x07);
+    if (l_Acked > m_UnackedPayloads.size()) {
+        SendIFrames();
+        return;
+    } // if
+    
+    for (unsigned char l_Index = 0; l_Index < l_Acked; ++l_Index) {
+        m_UnackedPayloads.pop_front();
+    } // for
+    
+    m_SSeqUnacked = (a_RSeq & 0x07);
+    if (l_Acked) {
+        // Progress: restart the retransmission timer for the remaining I-frames
+        m_bRetransmissionTimerRunning = false;
+        m_RetransmissionTimer.cancel();
+        if (!m_UnackedPayloads.empty()) {
+            StartRetransmissionTimer();
+        } // if
+    } // if
+    
+    SendIFrames();
+}
+
+void DeviceSimulator::ScheduleAck() {
+    // Ack immediately if the window is full or no turnaround time is configured, otherwise after the turnaround time
+    if ((m_UnackedFrames >= m_Settings.m_Window) || (m_Settings.m_TurnaroundMicroseconds == 0)) {
+        SendAck();
+        return;
+    } // if
+    
+    if (!m_bTurnaroundTimerRunning) {
+        m_bTurnaroundTimerRunning = true;
+        auto self(shared_from_this());
+        m_TurnaroundTimer.expires_from_now(boost::posix_time::microseconds(m_Settings.m_TurnaroundMicroseconds));
+        m_TurnaroundTimer.async_wait([this, self](const boost::system::error_code& a_ErrorCode) {
+            if ((!a_ErrorCode) && (m_bStarted) && (m_bTurnaroundTimerRunning)) {
+                m_bTurnaroundTimerRunning = false;
+                SendAck();
+            } // if
+        });
+    } // if
+}
+
+void DeviceSimulator::SendAck() {
+    // Piggyback the ack on an I-frame, if possible
+    SendIFrames();
+    if (m_UnackedFrames) {
+        SendSFrame(HdlcFrame::HDLC_FRAMETYPE_S_RR, false);
+    } // if
+}
+
+void DeviceSimulator::SendSFrame(HdlcFrame::E_HDLC_FRAMETYPE a_eHDLCFrameType, bool a_bPF) {
+    // Each S-frame carries an ack for all accepted I-frames
+    HdlcFrame l_HdlcFrame;
+    l_HdlcFrame.SetAddress(0x30);
+    l_HdlcFrame.SetHDLCFrameType(a_eHDLCFrameType);
+    l_HdlcFrame.SetPF(a_bPF);
+    l_HdlcFrame.SetRSeq(m_RSeqIncoming);
+    TransmitFrame(l_HdlcFrame);
+    m_UnackedFrames = 0;
+    m_bTurnaroundTimerRunning = false;
+    m_TurnaroundTimer.cancel();
+}
+
+void DeviceSimulator::SendIFrames() {
+    // Fill the send window
+    while ((!m_bPeerBusy) && (!m_UplinkQueue.empty()) && (m_UnackedPayloads.size() < m_Settings.m_Window)) {
+        m_UnackedPayloads.emplace_back(std::move(m_UplinkQueue.front()));
+        m_UplinkQueue.pop_front();
+        HdlcFrame l_HdlcFrame;
+        l_HdlcFrame.SetAddress(0x30);
+        l_HdlcFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_I);
+        l_HdlcFrame.SetSSeq(m_SSeqOutgoing);
+        l_HdlcFrame.SetRSeq(m_RSeqIncoming);
+        l_HdlcFrame.SetPayload(m_UnackedPayloads.back());
+        TransmitFrame(l_HdlcFrame);
+        m_SSeqOutgoing = ((m_SSeqOutgoing + 1) & 0x07);
+        m_UnackedFrames = 0;
+        m_bTurnaroundTimerRunning = false;
+        m_TurnaroundTimer.cancel();
+        if (!m_bRetransmissionTimerRunning) {
+            StartRetransmissionTimer();
+        } // if
+    } // while
+}
+
+void DeviceSimulator::Retransmit() {
+    // Go-back-N: send all unacked I-frames again
+    unsigned char l_SSeq = m_SSeqUnacked;
+    for (auto it = m_UnackedPayloads.begin(); it != m_UnackedPayloads.end(); ++it) {
+        HdlcFrame l_HdlcFrame;
+        l_HdlcFrame.SetAddress(0x30);
+        l_HdlcFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_I);
+        l_HdlcFrame.SetSSeq(l_SSeq);
+        l_HdlcFrame.SetRSeq(m_RSeqIncoming);
+        l_HdlcFrame.SetPayload(*it);
+        TransmitFrame(l_HdlcFrame);
+        ++m_Statistics.m_Retransmissions;
+        l_SSeq = ((l_SSeq + 1) & 0x07);
+    } // for
+    
+    if (!m_UnackedPayloads.empty()) {
+        m_UnackedFrames = 0;
+    } // if
+}
+
+void DeviceSimulator::StartRetransmissionTimer() {
+    auto self(shared_from_this());
+    m_bRetransmissionTimerRunning = true;
+    m_RetransmissionTimer.expires_from_now(boost::posix_time::milliseconds(1000));
+    m_RetransmissionTimer.async_wait([this, self](const boost::system::error_code& a_ErrorCode) {
+        if ((!a_ErrorCode) && (m_bStarted) && (m_bRetransmissionTimerRunning)) {
+            Retransmit();
+            StartRetransmissionTimer();
+        } // if
+    });
+}
+
+void DeviceSimulator::SendUplinkPayload(std::vector<unsigned char> a_Payload, bool a_bReliable) {
+    if (a_bReliable) {
+        if (m_UplinkQueue.size() >= max_uplink_queue) {
+            ++m_Statistics.m_UplinkDropped;
+            return;
+        } // if
+        
+        m_UplinkQueue.emplace_back(std::move(a_Payload));
+        SendIFrames();
+    } else {
+        HdlcFrame l_HdlcFrame;
+        l_HdlcFrame.SetAddress(0x30);
+        l_HdlcFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_U_UI);
+        l_HdlcFrame.SetPayload(a_Payload);
+        TransmitFrame(l_HdlcFrame);
+    } // else
+}
+
+void DeviceSimulator::StartUplinkTimer() {
+    // The deadline advances by a fixed interval, thus, the rate does not drift with the processing time
+    auto self(shared_from_this());
+    m_UplinkTimer.async_wait([this, self](const boost::system::error_code& a_ErrorCode) {
+        if ((a_ErrorCode) || (!m_bStarted)) {
+            return;
+        } // if
+        
+        // Sequence number and timestamp in network byte order, followed by a filler
+        uint64_t l_Timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::vector<unsigned char> l_Payload(std::max<size_t>(m_Settings.m_UplinkSize, 16), 0x00);
+        for (int l_Index = 0; l_Index < 8; ++l_Index) {
+            l_Payload[l_Index]     = ((m_UplinkSequence >> (56 - 8 * l_Index)) & 0xFF);
+            l_Payload[8 + l_Index] = ((l_Timestamp >> (56 - 8 * l_Index)) & 0xFF);
+        } // for
+        
+        for (size_t l_Index = 16; l_Index < l_Payload.size(); ++l_Index) {
+            l_Payload[l_Index] = (l_Index & 0xFF);
+        } // for
+        
+        ++m_UplinkSequence;
+        ++m_Statistics.m_UplinkPayloads;
+        SendUplinkPayload(std::move(l_Payload), m_Settings.m_bUplinkReliable);
+        m_UplinkTimer.expires_at(m_UplinkTimer.expires_at() + boost::posix_time::microseconds(1000000 / m_Settings.m_UplinkRate));
+        StartUplinkTimer();
+    });
+}
+
+void DeviceSimulator::TransmitFrame(const HdlcFrame& a_HdlcFrame) {
+    if (Chance(m_Settings.m_TxDropRate)) {
+        ++m_Statistics.m_InjectedTxDrops;
+        return;
+    } // if
+    
+    if (m_WriteQueue.size() >= max_write_queue) {
+        // The HDLCd does not read, behave like a serial line without flow control
+        ++m_Statistics.m_InjectedTxDrops;
+        return;
+    } // if
+    
+    std::vector<unsigned char> l_Buffer = FrameGenerator::EscapeFrame(FrameGenerator::SerializeFrame(a_HdlcFrame));
+    if (m_Settings.m_BitErrorRate > 0) {
+        for (auto it = l_Buffer.begin(); it != l_Buffer.end(); ++it) {
+            if (Chance(m_Settings.m_BitErrorRate)) {
+                *it ^= (1 << (m_RandomGenerator() % 8));
+                ++m_Statistics.m_InjectedBitErrors;
+            } // if
+        } // for
+    } // if
+    
+    ++m_Statistics.m_FramesTransmitted;
+    m_WriteQueue.emplace_back(std::move(l_Buffer));
+    if (!m_bWriting) {
+        DoWrite();
+    } // if
+}
+
+bool DeviceSimulator::Chance(double a_Probability) {
+    if (a_Probability <= 0) {
+        return false;
+    } // if
+    
+    return (std::uniform_real_distribution<double>(0.0, 1.0)(m_RandomGenerator) < a_Probability);
+}
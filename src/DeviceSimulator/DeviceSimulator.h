@@ -0,0 +1,173 @@
+/**
+ * \file DeviceSimulator.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEVICE_SIMULATOR_H
+#define DEVICE_SIMULATOR_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/asio.hpp>
+#include "FrameParser.h"
+
+// The settings of the simulated device
+typedef enum {
+    NAK_MODE_REJ    = 0, // Out-of-sequence I-frames are answered by a REJ
+    NAK_MODE_SREJ   = 1, // Out-of-sequence I-frames are answered by a SREJ
+    NAK_MODE_IGNORE = 2  // Out-of-sequence I-frames are ignored, the HDLCd has to retransmit on timeout
+} E_NAK_MODE;
+
+typedef struct {
+    std::string m_LinkPath;            //!< A symbolic link to the slave side of the pseudo terminal, or empty
+    unsigned int m_BaudRate;           //!< The baud rate of the device, or 0 to accept any baud rate
+    unsigned int m_Window;             //!< The send window for uplink I-frames, and the number of I-frames acked at once
+    unsigned int m_TurnaroundMicroseconds; //!< The delay until received I-frames are acked
+    E_NAK_MODE m_eNakMode;
+    double m_BitErrorRate;             //!< The probability of a bit flip per transmitted byte
+    double m_RxDropRate;               //!< The probability of dropping a received frame
+    double m_TxDropRate;               //!< The probability of dropping a frame to transmit
+    unsigned int m_UplinkRate;         //!< Uplink frames per second, 0 for none
+    size_t m_UplinkSize;               //!< The payload size of uplink frames, at least 16
+    bool m_bUplinkReliable;            //!< Uplink frames are I-frames instead of UI-frames
+    bool m_bEcho;                      //!< The payload of each received I-frame or UI-frame is sent back
+    bool m_bCommands;                  //!< Commands are read from stdin
+    unsigned int m_Seed;               //!< The seed of the random number generator for error injection
+} DeviceSimulatorSettings;
+
+/*! \class DeviceSimulator
+ *  \brief Class DeviceSimulator
+ * 
+ *  Plays the device side of the HDLC protocol as spoken by the HDLCd, via a pseudo terminal. The HDLCd opens the slave
+ *  side of the pseudo terminal as its serial port. Probes are answered, received I-frames are acked, and uplink traffic
+ *  is generated. Each uplink payload starts with a 64-bit sequence number and a 64-bit CLOCK_MONOTONIC timestamp in
+ *  nanoseconds, both in network byte order, thus, clients on the same host may measure the latency. For testing, bit
+ *  errors, frame drops, baud rate mismatches, and the flow control frames RNR, REJ, and SREJ can be injected. Commands
+ *  are read from stdin if enabled, one per line: rnr, rr, rej, srej, baud RATE, stats, quit.
+ */
+class DeviceSimulator: public std::enable_shared_from_this<DeviceSimulator> {
+public:
+    // CTOR and DTOR
+    DeviceSimulator(boost::asio::io_service& a_IOService, const DeviceSimulatorSettings& a_Settings);
+    ~DeviceSimulator();
+    
+    bool Start();
+    void Stop();
+    void PrintStatistics(std::ostream& a_OutputStream) const;
+    const std::string& GetSlavePath() const { return m_SlavePath; }
+    uint64_t GetUplinkPayloads() const { return m_Statistics.m_UplinkPayloads; }
+    
+    // Notification about each accepted payload of the HDLCd, e.g., to measure the latency
+    void SetOnPayloadCallback(std::function<void(const std::vector<unsigned char>& a_Payload, bool a_bReliable)> a_OnPayloadCallback) { m_OnPayloadCallback = a_OnPayloadCallback; }
+    
+private:
+    // Internal helpers: I/O
+    bool OpenPseudoTerminal();
+    void DoRead();
+    void DoWrite();
+    void DoReadCommand();
+    void ExecuteCommand(const std::string& a_Command);
+    bool IsBaudRateMatching() const;
+    
+    // Internal helpers: protocol
+    void InterpretFrame(const HdlcFrame& a_HdlcFrame);
+    void ProcessAck(unsigned char a_RSeq);
+    void ScheduleAck();
+    void SendAck();
+    void SendSFrame(HdlcFrame::E_HDLC_FRAMETYPE a_eHDLCFrameType, bool a_bPF);
+    void SendIFrames();
+    void Retransmit();
+    void StartRetransmissionTimer();
+    void SendUplinkPayload(std::vector<unsigned char> a_Payload, bool a_bReliable);
+    void StartUplinkTimer();
+    void TransmitFrame(const HdlcFrame& a_HdlcFrame);
+    bool Chance(double a_Probability);
+    
+    // Members
+    boost::asio::io_service& m_IOService;
+    DeviceSimulatorSettings m_Settings;
+    bool m_bStarted;
+    std::mt19937 m_RandomGenerator;
+    std::function<void(const std::vector<unsigned char>& a_Payload, bool a_bReliable)> m_OnPayloadCallback;
+    
+    // The pseudo terminal. The slave side is kept open, thus, the HDLCd may close and reopen it.
+    boost::asio::posix::stream_descriptor m_Master;
+    int m_SlaveFileDescriptor;
+    std::string m_SlavePath;
+    bool m_bLinked;
+    enum { max_length = 1024 };
+    unsigned char m_ReadBuffer[max_length];
+    FrameParser m_FrameParser;
+    std::vector<DeserializedFrame> m_DeserializedFrames;
+    
+    // Escaped frames waiting for transmission
+    enum { max_write_queue = 1024 };
+    std::deque<std::vector<unsigned char>> m_WriteQueue;
+    bool m_bWriting;
+    
+    // Commands via stdin
+    boost::asio::posix::stream_descriptor m_Stdin;
+    boost::asio::streambuf m_CommandBuffer;
+    
+    // Receiving side: I-frames of the HDLCd
+    unsigned char m_RSeqIncoming;      //!< The sequence number of the next expected I-frame
+    unsigned int m_UnackedFrames;      //!< The number of accepted I-frames not acked yet
+    bool m_bBusy;                      //!< RNR condition set by command: no I-frames are accepted
+    boost::asio::deadline_timer m_TurnaroundTimer;
+    bool m_bTurnaroundTimerRunning;
+    
+    // Sending side: uplink I-frames
+    enum { max_uplink_queue = 1024 };
+    unsigned char m_SSeqOutgoing;      //!< The sequence number of the next new I-frame
+    unsigned char m_SSeqUnacked;       //!< The sequence number of the oldest unacked I-frame
+    std::deque<std::vector<unsigned char>> m_UnackedPayloads;
+    std::deque<std::vector<unsigned char>> m_UplinkQueue;
+    bool m_bPeerBusy;                  //!< RNR condition set by the HDLCd
+    boost::asio::deadline_timer m_RetransmissionTimer;
+    bool m_bRetransmissionTimerRunning;
+    boost::asio::deadline_timer m_UplinkTimer;
+    uint64_t m_UplinkSequence;
+    
+    // Statistics
+    typedef struct {
+        uint64_t m_FramesReceived;
+        uint64_t m_FramesInvalid;
+        uint64_t m_FramesTransmitted;
+        uint64_t m_ProbesAnswered;
+        uint64_t m_IFramesAccepted;
+        uint64_t m_IFramesOutOfSequence;
+        uint64_t m_IFramesRefused;
+        uint64_t m_UIFramesReceived;
+        uint64_t m_UplinkPayloads;
+        uint64_t m_UplinkDropped;
+        uint64_t m_Retransmissions;
+        uint64_t m_InjectedBitErrors;
+        uint64_t m_InjectedRxDrops;
+        uint64_t m_InjectedTxDrops;
+        uint64_t m_BaudRateMismatches;
+    } Statistics;
+    Statistics m_Statistics;
+};
+
+#endif // DEVICE_SIMULATOR_H
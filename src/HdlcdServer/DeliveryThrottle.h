@@ -0,0 +1,139 @@
+/**
+ * \file      DeliveryThrottle.h
+ * \brief     This file contains the header declaration of class DeliveryThrottle
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELIVERY_THROTTLE_H
+#define DELIVERY_THROTTLE_H
+
+#include <cstddef>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+
+/*! \class DeliveryThrottle
+ *  \brief Class DeliveryThrottle
+ * 
+ *  This class implements the optional sampling and rate caps of a client session, as requested via the session options.
+ *  Monitoring clients use it to get a representative view of the data packets instead of all of them.
+ */
+class DeliveryThrottle {
+public:
+    /*! \brief The constructor of DeliveryThrottle objects
+     * 
+     *  On creation, all data packets are delivered
+     */
+    DeliveryThrottle(): m_SampleRate(1), m_SampleCounter(0), m_MaxPacketsPerSecond(0), m_MaxBytesPerSecond(0), m_WindowPackets(0), m_WindowBytes(0) {}
+    
+    /*! \brief Configure via the session option
+     * 
+     *  Configure via the value of the session option: sample rate (2 bytes), max packets per second (4 bytes), and
+     *  max bytes per second (4 bytes). A value of 0 disables the respective mechanism.
+     * 
+     *  \param  a_Value the value of the session option
+     *  \return bool indicates whether the value was valid
+     */
+    bool Configure(const std::vector<unsigned char> &a_Value) {
+        if (a_Value.size() != 10) {
+            return false;
+        } // if
+        
+        m_SampleRate = ((a_Value[0] << 8) | a_Value[1]);
+        if (m_SampleRate == 0) {
+            m_SampleRate = 1;
+        } // if
+        
+        m_MaxPacketsPerSecond = ((uint32_t(a_Value[2]) << 24) | (a_Value[3] << 16) | (a_Value[4] << 8) | a_Value[5]);
+        m_MaxBytesPerSecond   = ((uint32_t(a_Value[6]) << 24) | (a_Value[7] << 16) | (a_Value[8] << 8) | a_Value[9]);
+        m_WindowStart = std::chrono::steady_clock::now();
+        m_LastReport  = m_WindowStart;
+        return true;
+    }
+    
+    /*! \brief Check whether a data packet has to be delivered
+     * 
+     *  Check whether a data packet has to be delivered, or whether it is suppressed due to sampling or a rate cap
+     * 
+     *  \param  a_PacketSize the size of the data packet in bytes
+     *  \return bool indicates whether the data packet has to be delivered
+     */
+    bool Admit(size_t a_PacketSize) {
+        if (!IsActive()) {
+            return true;
+        } // if
+        
+        if ((m_SampleRate > 1) && (((++m_SampleCounter) % m_SampleRate) != 0)) {
+            return false;
+        } // if
+        
+        if ((m_MaxPacketsPerSecond) || (m_MaxBytesPerSecond)) {
+            // Fixed windows of one second
+            auto l_Now = std::chrono::steady_clock::now();
+            if ((l_Now - m_WindowStart) >= std::chrono::seconds(1)) {
+                m_WindowStart = l_Now;
+                m_WindowPackets = 0;
+                m_WindowBytes = 0;
+            } // if
+            
+            if (((m_MaxPacketsPerSecond) && ((m_WindowPackets + 1) > m_MaxPacketsPerSecond)) ||
+                ((m_MaxBytesPerSecond)   && ((m_WindowBytes + a_PacketSize) > m_MaxBytesPerSecond))) {
+                return false;
+            } // if
+            
+            ++m_WindowPackets;
+            m_WindowBytes += a_PacketSize;
+        } // if
+        
+        return true;
+    }
+    
+    /*! \brief Check whether suppressed data packets have to be reported
+     * 
+     *  Check whether suppressed data packets have to be reported to the client. This happens at most once per second.
+     * 
+     *  \return bool indicates whether a suppression indication has to be sent now
+     */
+    bool IsReportDue() {
+        auto l_Now = std::chrono::steady_clock::now();
+        if ((l_Now - m_LastReport) < std::chrono::seconds(1)) {
+            return false;
+        } // if
+        
+        m_LastReport = l_Now;
+        return true;
+    }
+    
+    // Query the configuration
+    bool IsActive() const { return ((m_SampleRate > 1) || (m_MaxPacketsPerSecond) || (m_MaxBytesPerSecond)); }
+
+private:
+    // Members
+    unsigned int m_SampleRate;      //!< One of m_SampleRate data packets is delivered
+    unsigned int m_SampleCounter;
+    uint32_t m_MaxPacketsPerSecond; //!< The maximum number of data packets per second, 0 for no limit
+    uint32_t m_MaxBytesPerSecond;   //!< The maximum number of bytes per second, 0 for no limit
+    std::chrono::steady_clock::time_point m_WindowStart;
+    std::chrono::steady_clock::time_point m_LastReport;
+    size_t m_WindowPackets;
+    size_t m_WindowBytes;
+};
+
+#endif // DELIVERY_THROTTLE_H
@@ -0,0 +1,148 @@
+/**
+ * \file      HdlcdPacketChannel.h
+ * \brief     This file contains the header declaration of class HdlcdPacketChannel
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HDLCD_PACKET_CHANNEL_H
+#define HDLCD_PACKET_CHANNEL_H
+
+#include <memory>
+#include <vector>
+#include <assert.h>
+#include "Frame.h"
+
+/*! \class HdlcdPacketChannel
+ *  \brief Class HdlcdPacketChannel
+ * 
+ *  Channel packets of the HDLCd access protocol (content 0x4*). In multiplexed sessions, each packet of a channel is
+ *  encapsulated into a channel packet carrying the identifier of the channel. See doc/protocol.txt for details.
+ */
+class HdlcdPacketChannel: public Frame {
+public:
+    /*! \brief Create a channel packet
+     * 
+     *  Create a channel packet encapsulating a packet of a channel
+     * 
+     *  \param  a_ChannelId the identifier of the channel
+     *  \param  a_Packet the encapsulated packet
+     *  \return HdlcdPacketChannel the channel packet
+     */
+    static HdlcdPacketChannel CreatePacket(unsigned char a_ChannelId, const Frame& a_Packet) {
+        return CreatePacket(a_ChannelId, a_Packet.Serialize());
+    }
+    
+    /*! \brief Create a channel packet
+     * 
+     *  Create a channel packet encapsulating an already serialized packet of a channel
+     * 
+     *  \param  a_ChannelId the identifier of the channel
+     *  \param  a_Packet the serialized encapsulated packet
+     *  \return HdlcdPacketChannel the channel packet
+     */
+    static HdlcdPacketChannel CreatePacket(unsigned char a_ChannelId, const std::vector<unsigned char>& a_Packet) {
+        HdlcdPacketChannel l_PacketChannel;
+        l_PacketChannel.m_ChannelId = a_ChannelId;
+        l_PacketChannel.m_Packet = a_Packet;
+        assert(l_PacketChannel.m_Packet.size() <= 0xFFFF);
+        return l_PacketChannel;
+    }
+    
+    /*! \brief Create an empty packet for deserialization
+     * 
+     *  Create an empty packet for deserialization
+     * 
+     *  \return std::shared_ptr<HdlcdPacketChannel> the empty channel packet
+     */
+    static std::shared_ptr<HdlcdPacketChannel> CreateDeserializedPacket() {
+        // Object creation via the private constructor
+        auto l_PacketChannel(std::shared_ptr<HdlcdPacketChannel>(new HdlcdPacketChannel));
+        l_PacketChannel->m_eDeserialize = DESERIALIZE_HEADER;
+        l_PacketChannel->m_BytesRemaining = 4;
+        return l_PacketChannel;
+    }
+    
+    // Getters
+    unsigned char GetChannelId() const { return m_ChannelId; }
+    const std::vector<unsigned char>& GetPacket() const { return m_Packet; }
+
+private:
+    // Private CTOR
+    HdlcdPacketChannel(): m_ChannelId(0), m_eDeserialize(DESERIALIZE_ERROR) {}
+
+    // Serializer
+    const std::vector<unsigned char> Serialize() const {
+        std::vector<unsigned char> l_Buffer;
+        l_Buffer.reserve(4 + m_Packet.size());
+        l_Buffer.emplace_back(0x40);
+        l_Buffer.emplace_back(m_ChannelId);
+        l_Buffer.emplace_back((m_Packet.size() >> 8) & 0xFF);
+        l_Buffer.emplace_back( m_Packet.size()       & 0xFF);
+        l_Buffer.insert(l_Buffer.end(), m_Packet.begin(), m_Packet.end());
+        return l_Buffer;
+    }
+    
+    // Deserializer
+    bool Deserialize() {
+        // All requested bytes are available
+        switch (m_eDeserialize) {
+        case DESERIALIZE_HEADER: {
+            // Deserialize the header: type byte, channel identifier, and length of the encapsulated packet
+            m_BytesRemaining = ((m_Buffer[2] << 8) | m_Buffer[3]);
+            if ((m_Buffer[0] != 0x40) || (m_BytesRemaining == 0)) {
+                m_eDeserialize = DESERIALIZE_ERROR;
+                return false;
+            } // if
+            
+            m_ChannelId = m_Buffer[1];
+            m_eDeserialize = DESERIALIZE_PACKET;
+            break;
+        }
+        case DESERIALIZE_PACKET: {
+            // The encapsulated packet is available
+            m_Packet.assign(m_Buffer.begin() + 4, m_Buffer.end());
+            m_eDeserialize = DESERIALIZE_FULL;
+            break;
+        }
+        case DESERIALIZE_ERROR:
+        case DESERIALIZE_FULL:
+        default:
+            assert(false);
+        } // switch
+        
+        // No error
+        return true;
+    }
+
+    // Members
+    unsigned char m_ChannelId;           //!< The identifier of the channel
+    std::vector<unsigned char> m_Packet; //!< The encapsulated packet, serialized
+    
+    // Internal deserializer state
+    typedef enum {
+        DESERIALIZE_ERROR  = 0,
+        DESERIALIZE_HEADER = 1,
+        DESERIALIZE_PACKET = 2,
+        DESERIALIZE_FULL   = 3
+    } E_DESERIALIZE;
+    E_DESERIALIZE m_eDeserialize; //!< The state of the deserializer
+};
+
+#endif // HDLCD_PACKET_CHANNEL_H
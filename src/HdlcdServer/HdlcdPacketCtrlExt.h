@@ -0,0 +1,233 @@
+/**
+ * \file      HdlcdPacketCtrlExt.h
+ * \brief     This file contains the header declaration of class HdlcdPacketCtrlExt
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HDLCD_PACKET_CTRL_EXT_H
+#define HDLCD_PACKET_CTRL_EXT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <assert.h>
+#include "Frame.h"
+
+/*! \class HdlcdPacketCtrlExt
+ *  \brief Class HdlcdPacketCtrlExt
+ * 
+ *  Extended control packets of the HDLCd access protocol (content 0x3*). In contrast to the fixed-size control packets
+ *  they carry a type-specific value of variable length. See doc/protocol.txt for details.
+ */
+class HdlcdPacketCtrlExt: public Frame {
+public:
+    /*! \enum E_CTRL_EXT_TYPE
+     *  \brief Enum E_CTRL_EXT_TYPE
+     * 
+     *  This enum names the types of extended control packets
+     */
+    typedef enum {
+        CTRL_EXT_TYPE_GAP             = 0x01, //!< Indication: data packets were dropped as the client did not read fast enough
+        CTRL_EXT_TYPE_SESSION_OPTIONS = 0x02, //!< Request: options of the session, sent once after the session header
+        CTRL_EXT_TYPE_SUPPRESSED      = 0x03, //!< Indication: data packets were suppressed due to sampling or a rate cap
+        CTRL_EXT_TYPE_CREDITS         = 0x04, //!< Indication: the client may send additional data packets
+        CTRL_EXT_TYPE_CONFIRMATION    = 0x05, //!< Indication: the fate of a data packet sent by the client is known
+        CTRL_EXT_TYPE_CHANNEL_OPEN    = 0x06, //!< Request: open a channel of a multiplexed session
+        CTRL_EXT_TYPE_CHANNEL_CLOSE   = 0x07, //!< Request / indication: close a channel of a multiplexed session
+        CTRL_EXT_TYPE_SHARED_MEMORY   = 0x08, //!< Indication: the name of the shared memory ring carrying the data packets
+        CTRL_EXT_TYPE_UNSET           = 0xFF
+    } E_CTRL_EXT_TYPE;
+    
+    /*! \brief Create a gap indication
+     * 
+     *  Create a gap indication, which replaces a number of dropped data packets in the stream of packets
+     * 
+     *  \param  a_DroppedPackets the number of data packets that were dropped
+     *  \return HdlcdPacketCtrlExt the extended control packet
+     */
+    static HdlcdPacketCtrlExt CreateGapIndication(uint32_t a_DroppedPackets) {
+        HdlcdPacketCtrlExt l_PacketCtrlExt;
+        l_PacketCtrlExt.m_eCtrlExtType = CTRL_EXT_TYPE_GAP;
+        l_PacketCtrlExt.AppendUInt32(a_DroppedPackets);
+        return l_PacketCtrlExt;
+    }
+    
+    /*! \brief Create a suppression indication
+     * 
+     *  Create a suppression indication, which reports the number of data packets suppressed since the last indication
+     * 
+     *  \param  a_SuppressedPackets the number of data packets that were suppressed
+     *  \return HdlcdPacketCtrlExt the extended control packet
+     */
+    static HdlcdPacketCtrlExt CreateSuppressionIndication(uint32_t a_SuppressedPackets) {
+        HdlcdPacketCtrlExt l_PacketCtrlExt;
+        l_PacketCtrlExt.m_eCtrlExtType = CTRL_EXT_TYPE_SUPPRESSED;
+        l_PacketCtrlExt.AppendUInt32(a_SuppressedPackets);
+        return l_PacketCtrlExt;
+    }
+    
+    /*! \brief Create a credit grant
+     * 
+     *  Create a credit grant, which allows the client to send a number of additional data packets
+     * 
+     *  \param  a_Credits the number of additional data packets the client may send
+     *  \return HdlcdPacketCtrlExt the extended control packet
+     */
+    static HdlcdPacketCtrlExt CreateCreditGrant(uint32_t a_Credits) {
+        HdlcdPacketCtrlExt l_PacketCtrlExt;
+        l_PacketCtrlExt.m_eCtrlExtType = CTRL_EXT_TYPE_CREDITS;
+        l_PacketCtrlExt.AppendUInt32(a_Credits);
+        return l_PacketCtrlExt;
+    }
+    
+    /*! \brief Create a confirmation
+     * 
+     *  Create a confirmation, which reports the fate of a data packet sent by the client
+     * 
+     *  \param  a_SequenceNbr the number of the data packet within the session, starting at 0
+     *  \param  a_Status the status: 0: acknowledged, 1: transmitted, 2: dropped
+     *  \return HdlcdPacketCtrlExt the extended control packet
+     */
+    static HdlcdPacketCtrlExt CreateConfirmation(uint32_t a_SequenceNbr, unsigned char a_Status) {
+        HdlcdPacketCtrlExt l_PacketCtrlExt;
+        l_PacketCtrlExt.m_eCtrlExtType = CTRL_EXT_TYPE_CONFIRMATION;
+        l_PacketCtrlExt.AppendUInt32(a_SequenceNbr);
+        l_PacketCtrlExt.m_Value.emplace_back(a_Status);
+        return l_PacketCtrlExt;
+    }
+    
+    /*! \brief Create a channel close indication
+     * 
+     *  Create a channel close indication, which reports that a channel of a multiplexed session was closed or rejected
+     * 
+     *  \param  a_ChannelId the identifier of the channel
+     *  \return HdlcdPacketCtrlExt the extended control packet
+     */
+    static HdlcdPacketCtrlExt CreateChannelClose(unsigned char a_ChannelId) {
+        HdlcdPacketCtrlExt l_PacketCtrlExt;
+        l_PacketCtrlExt.m_eCtrlExtType = CTRL_EXT_TYPE_CHANNEL_CLOSE;
+        l_PacketCtrlExt.m_Value.emplace_back(a_ChannelId);
+        return l_PacketCtrlExt;
+    }
+    
+    /*! \brief Create a shared memory ring announcement
+     * 
+     *  Create a shared memory ring announcement, which tells the client where to find its data packets
+     * 
+     *  \param  a_Name the name of the POSIX shared memory object
+     *  \return HdlcdPacketCtrlExt the extended control packet
+     */
+    static HdlcdPacketCtrlExt CreateSharedMemoryRingAnnouncement(const std::string& a_Name) {
+        HdlcdPacketCtrlExt l_PacketCtrlExt;
+        l_PacketCtrlExt.m_eCtrlExtType = CTRL_EXT_TYPE_SHARED_MEMORY;
+        l_PacketCtrlExt.m_Value.assign(a_Name.begin(), a_Name.end());
+        return l_PacketCtrlExt;
+    }
+    
+    /*! \brief Create an empty packet for deserialization
+     * 
+     *  Create an empty packet for deserialization
+     * 
+     *  \return std::shared_ptr<HdlcdPacketCtrlExt> the empty extended control packet
+     */
+    static std::shared_ptr<HdlcdPacketCtrlExt> CreateDeserializedPacket() {
+        // Object creation via the private constructor
+        auto l_PacketCtrlExt(std::shared_ptr<HdlcdPacketCtrlExt>(new HdlcdPacketCtrlExt));
+        l_PacketCtrlExt->m_eDeserialize = DESERIALIZE_HEADER;
+        l_PacketCtrlExt->m_BytesRemaining = 4;
+        return l_PacketCtrlExt;
+    }
+    
+    // Getters
+    E_CTRL_EXT_TYPE GetPacketType() const { return m_eCtrlExtType; }
+    const std::vector<unsigned char>& GetValue() const { return m_Value; }
+
+private:
+    // Private CTOR
+    HdlcdPacketCtrlExt(): m_eCtrlExtType(CTRL_EXT_TYPE_UNSET), m_eDeserialize(DESERIALIZE_ERROR) {}
+
+    // Internal helpers
+    void AppendUInt32(uint32_t a_Value) {
+        m_Value.emplace_back((a_Value >> 24) & 0xFF);
+        m_Value.emplace_back((a_Value >> 16) & 0xFF);
+        m_Value.emplace_back((a_Value >>  8) & 0xFF);
+        m_Value.emplace_back( a_Value        & 0xFF);
+    }
+
+    // Serializer
+    const std::vector<unsigned char> Serialize() const {
+        std::vector<unsigned char> l_Buffer;
+        l_Buffer.reserve(4 + m_Value.size());
+        l_Buffer.emplace_back(0x30);
+        l_Buffer.emplace_back(m_eCtrlExtType);
+        l_Buffer.emplace_back((m_Value.size() >> 8) & 0xFF);
+        l_Buffer.emplace_back( m_Value.size()       & 0xFF);
+        l_Buffer.insert(l_Buffer.end(), m_Value.begin(), m_Value.end());
+        return l_Buffer;
+    }
+    
+    // Deserializer
+    bool Deserialize() {
+        // All requested bytes are available
+        switch (m_eDeserialize) {
+        case DESERIALIZE_HEADER: {
+            // Deserialize the header: type byte, control type, and length of the value
+            if ((m_Buffer[0] & 0xF0) != 0x30) {
+                m_eDeserialize = DESERIALIZE_ERROR;
+                return false;
+            } // if
+            
+            m_eCtrlExtType = (E_CTRL_EXT_TYPE)m_Buffer[1];
+            m_BytesRemaining = ((m_Buffer[2] << 8) | m_Buffer[3]);
+            m_eDeserialize = (m_BytesRemaining ? DESERIALIZE_VALUE : DESERIALIZE_FULL);
+            break;
+        }
+        case DESERIALIZE_VALUE: {
+            // The value is available
+            m_Value.assign(m_Buffer.begin() + 4, m_Buffer.end());
+            m_eDeserialize = DESERIALIZE_FULL;
+            break;
+        }
+        case DESERIALIZE_ERROR:
+        case DESERIALIZE_FULL:
+        default:
+            assert(false);
+        } // switch
+        
+        // No error
+        return true;
+    }
+
+    // Members
+    E_CTRL_EXT_TYPE m_eCtrlExtType;     //!< The type of this extended control packet
+    std::vector<unsigned char> m_Value; //!< The type-specific value
+    
+    // Internal deserializer state
+    typedef enum {
+        DESERIALIZE_ERROR  = 0,
+        DESERIALIZE_HEADER = 1,
+        DESERIALIZE_VALUE  = 2,
+        DESERIALIZE_FULL   = 3
+    } E_DESERIALIZE;
+    E_DESERIALIZE m_eDeserialize; //!< The state of the deserializer
+};
+
+#endif // HDLCD_PACKET_CTRL_EXT_H
@@ -0,0 +1,216 @@
+/**
+ * \file      HdlcdPacketDataBatch.h
+ * \brief     This file contains the header declaration of class HdlcdPacketDataBatch
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HDLCD_PACKET_DATA_BATCH_H
+#define HDLCD_PACKET_DATA_BATCH_H
+
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <assert.h>
+#include "Frame.h"
+#include "HdlcdPacketData.h"
+
+/*! \class HdlcdPacketDataBatch
+ *  \brief Class HdlcdPacketDataBatch
+ * 
+ *  Batched data packets of the HDLCd access protocol (content 0x2*). A batch carries a list of payloads that share
+ *  the flags of the type byte, thus many small payloads cost a single packet header. See doc/protocol.txt for details.
+ */
+class HdlcdPacketDataBatch: public Frame {
+public:
+    /*! \brief Create an empty batch
+     * 
+     *  Create an empty batch of data packets, the payloads have to be added via AppendPacketData()
+     * 
+     *  \param  a_bReliable the reliable flag shared by all payloads
+     *  \param  a_bInvalid the invalid flag shared by all payloads
+     *  \param  a_bWasSent the was sent flag shared by all payloads
+     *  \return HdlcdPacketDataBatch the batch of data packets
+     */
+    static HdlcdPacketDataBatch CreatePacket(bool a_bReliable, bool a_bInvalid = false, bool a_bWasSent = false) {
+        HdlcdPacketDataBatch l_PacketDataBatch;
+        l_PacketDataBatch.m_bReliable = a_bReliable;
+        l_PacketDataBatch.m_bInvalid  = a_bInvalid;
+        l_PacketDataBatch.m_bWasSent  = a_bWasSent;
+        return l_PacketDataBatch;
+    }
+    
+    /*! \brief Create an empty packet for deserialization
+     * 
+     *  Create an empty packet for deserialization
+     * 
+     *  \return std::shared_ptr<HdlcdPacketDataBatch> the empty batch of data packets
+     */
+    static std::shared_ptr<HdlcdPacketDataBatch> CreateDeserializedPacket() {
+        // Object creation via the private constructor
+        auto l_PacketDataBatch(std::shared_ptr<HdlcdPacketDataBatch>(new HdlcdPacketDataBatch));
+        l_PacketDataBatch->m_eDeserialize = DESERIALIZE_HEADER;
+        l_PacketDataBatch->m_BytesRemaining = 3;
+        return l_PacketDataBatch;
+    }
+    
+    /*! \brief Add the payload of a data packet to the batch
+     * 
+     *  Add the payload of a data packet to the batch. Only a reference to the immutable data packet is kept, its payload
+     *  is copied just once while the batch is serialized. At most 65535 payloads of up to 65535 bytes each fit into one batch.
+     * 
+     *  \param  a_PacketData the data packet carrying the payload to be added
+     */
+    void AppendPacketData(std::shared_ptr<const HdlcdPacketData> a_PacketData) {
+        assert(m_PacketData.size() < 0xFFFF);
+        assert(a_PacketData->GetData().size() <= 0xFFFF);
+        m_PayloadBytes += a_PacketData->GetData().size();
+        m_PacketData.emplace_back(std::move(a_PacketData));
+    }
+    
+    // Getters
+    const std::vector<std::vector<unsigned char>>& GetPayloads() const { return m_Payloads; } // Of a received batch
+    size_t GetPayloadCount() const { return (m_Payloads.size() + m_PacketData.size()); }
+    size_t GetPayloadBytes() const { return m_PayloadBytes; }
+    bool GetReliable() const { return m_bReliable; }
+    bool GetInvalid()  const { return m_bInvalid;  }
+    bool GetWasSent()  const { return m_bWasSent;  }
+
+private:
+    // Private CTOR
+    HdlcdPacketDataBatch(): m_bReliable(false), m_bInvalid(false), m_bWasSent(false), m_PayloadBytes(0), m_PayloadCount(0), m_PayloadOffset(0), m_eDeserialize(DESERIALIZE_ERROR) {}
+
+    // Serializer
+    const std::vector<unsigned char> Serialize() const {
+        // A batch is either received or assembled from data packets, thus only one of both lists is populated
+        std::vector<unsigned char> l_Buffer;
+        l_Buffer.reserve(3 + (2 * GetPayloadCount()) + m_PayloadBytes);
+        l_Buffer.emplace_back(0x20 | (m_bReliable ? 0x04 : 0x00) | (m_bInvalid ? 0x02 : 0x00) | (m_bWasSent ? 0x01 : 0x00));
+        l_Buffer.emplace_back((GetPayloadCount() >> 8) & 0xFF);
+        l_Buffer.emplace_back( GetPayloadCount()       & 0xFF);
+        for (auto l_PayloadIt = m_Payloads.begin(); l_PayloadIt != m_Payloads.end(); ++l_PayloadIt) {
+            SerializePayload(l_Buffer, *l_PayloadIt);
+        } // for
+        
+        for (auto l_PacketDataIt = m_PacketData.begin(); l_PacketDataIt != m_PacketData.end(); ++l_PacketDataIt) {
+            SerializePayload(l_Buffer, (*l_PacketDataIt)->GetData());
+        } // for
+        
+        return l_Buffer;
+    }
+    
+    // Deserializer
+    bool Deserialize() {
+        // All requested bytes are available
+        switch (m_eDeserialize) {
+        case DESERIALIZE_HEADER: {
+            // Deserialize the header: type byte and the number of payloads. The reserved bit must not be set.
+            m_PayloadCount = ((m_Buffer[1] << 8) | m_Buffer[2]);
+            if (((m_Buffer[0] & 0xF8) != 0x20) || (m_PayloadCount == 0) || (m_PayloadCount > max_payloads)) {
+                m_eDeserialize = DESERIALIZE_ERROR;
+                return false;
+            } // if
+            
+            m_bReliable = (m_Buffer[0] & 0x04);
+            m_bInvalid  = (m_Buffer[0] & 0x02);
+            m_bWasSent  = (m_Buffer[0] & 0x01);
+            m_Payloads.reserve(m_PayloadCount);
+            m_eDeserialize = DESERIALIZE_SIZE;
+            m_BytesRemaining = 2;
+            break;
+        }
+        case DESERIALIZE_SIZE: {
+            // The size of the next payload is available. The whole batch is buffered, thus its size is limited.
+            m_BytesRemaining = ((m_Buffer[m_Buffer.size() - 2] << 8) | m_Buffer[m_Buffer.size() - 1]);
+            if ((m_PayloadBytes + m_BytesRemaining) > max_payload_bytes) {
+                m_eDeserialize = DESERIALIZE_ERROR;
+                return false;
+            } // if
+            
+            m_PayloadOffset = m_Buffer.size();
+            if (m_BytesRemaining) {
+                m_eDeserialize = DESERIALIZE_PAYLOAD;
+            } else {
+                // An empty payload
+                TakePayload(0);
+            } // else
+            
+            break;
+        }
+        case DESERIALIZE_PAYLOAD: {
+            // The next payload is available
+            TakePayload(m_Buffer.size() - m_PayloadOffset);
+            break;
+        }
+        case DESERIALIZE_ERROR:
+        case DESERIALIZE_FULL:
+        default:
+            assert(false);
+        } // switch
+        
+        // No error
+        return true;
+    }
+    
+    // Internal helpers
+    static void SerializePayload(std::vector<unsigned char> &a_Buffer, const std::vector<unsigned char> &a_Payload) {
+        a_Buffer.emplace_back((a_Payload.size() >> 8) & 0xFF);
+        a_Buffer.emplace_back( a_Payload.size()       & 0xFF);
+        a_Buffer.insert(a_Buffer.end(), a_Payload.begin(), a_Payload.end());
+    }
+    
+    void TakePayload(size_t a_PayloadSize) {
+        // Move the payload from the end of the receive buffer to the list of payloads
+        m_Payloads.emplace_back(m_Buffer.end() - a_PayloadSize, m_Buffer.end());
+        m_PayloadBytes += a_PayloadSize;
+        m_Buffer.resize(m_Buffer.size() - a_PayloadSize);
+        if (m_Payloads.size() == m_PayloadCount) {
+            m_eDeserialize = DESERIALIZE_FULL;
+        } else {
+            m_eDeserialize = DESERIALIZE_SIZE;
+            m_BytesRemaining = 2;
+        } // else
+    }
+
+    // Members
+    bool m_bReliable;
+    bool m_bInvalid;
+    bool m_bWasSent;
+    std::vector<std::vector<unsigned char>> m_Payloads; //!< The payloads of a received batch
+    std::vector<std::shared_ptr<const HdlcdPacketData>> m_PacketData; //!< The data packets of a batch to be sent, shared with other clients
+    size_t m_PayloadBytes;                              //!< The sum of the sizes of all payloads
+    
+    // Limits of a received batch, as it is buffered completely before it is processed
+    enum { max_payloads = 256 };                        //!< The maximum number of payloads
+    enum { max_payload_bytes = 262144 };                //!< The maximum sum of the sizes of all payloads, four payloads of the maximum size
+    
+    // Internal deserializer state
+    typedef enum {
+        DESERIALIZE_ERROR   = 0,
+        DESERIALIZE_HEADER  = 1,
+        DESERIALIZE_SIZE    = 2,
+        DESERIALIZE_PAYLOAD = 3,
+        DESERIALIZE_FULL    = 4
+    } E_DESERIALIZE;
+    size_t m_PayloadCount;        //!< The number of payloads announced by the header
+    size_t m_PayloadOffset;       //!< The offset of the current payload within the receive buffer
+    E_DESERIALIZE m_eDeserialize; //!< The state of the deserializer
+};
+
+#endif // HDLCD_PACKET_DATA_BATCH_H
@@ -25,13 +25,28 @@
 #include "SerialPortHandler.h"
 #include "HdlcdPacketData.h"
 #include "HdlcdPacketCtrl.h"
-#include "HdlcdPacketEndpoint.h"
+#include "HdlcdPacketDataBatch.h"
+#include "HdlcdServerPacketEndpoint.h"
+#include "HdlcdServerMultiplexer.h"
 #include "HdlcdSessionHeader.h"
+#include "HdlcdPacketCtrlExt.h"
+#include "SubscriptionFilter.h"
+#include "SharedMemoryRing.h"
 #include "FrameEndpoint.h"
 #include <utility>
 
-HdlcdServerHandler::HdlcdServerHandler(boost::asio::io_service& a_IOService, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection, boost::asio::ip::tcp::socket& a_TcpSocket): m_IOService(a_IOService), m_HdlcdServerHandlerCollection(a_HdlcdServerHandlerCollection) {
-    // Initialize members
+HdlcdServerHandler::HdlcdServerHandler(boost::asio::io_service& a_IOService, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection, boost::asio::ip::tcp::socket& a_TcpSocket, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth):
+    HdlcdServerHandler(a_IOService, a_HdlcdServerHandlerCollection, std::shared_ptr<HdlcdServerPacketEndpoint>(), a_SlowConsumerPolicy, a_PrefetchDepth) {
+    // Prepare frame endpoint
+    m_FrameEndpoint = std::make_shared<FrameEndpoint>(a_IOService, a_TcpSocket);
+    m_FrameEndpoint->RegisterFrameFactory(0x00, []()->std::shared_ptr<Frame>{ return HdlcdSessionHeader::CreateDeserializedFrame(); });
+    m_FrameEndpoint->SetOnFrameCallback([this](std::shared_ptr<Frame> a_Frame)->bool{ return OnFrame(a_Frame); });
+    m_FrameEndpoint->SetOnClosedCallback ([this](){ OnClosed(); });
+}
+
+HdlcdServerHandler::HdlcdServerHandler(boost::asio::io_service& a_IOService, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection, std::shared_ptr<HdlcdServerPacketEndpoint> a_PacketEndpoint, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth):
+    m_IOService(a_IOService), m_HdlcdServerHandlerCollection(a_HdlcdServerHandlerCollection), m_PacketEndpoint(a_PacketEndpoint), m_SlowConsumerPolicy(a_SlowConsumerPolicy) {
+    // Initialize members. A channel of a multiplexed session is served via the provided packet endpoint.
     m_Registered = false;
     m_bDeliverInitialState = true;
     m_eBufferType = BUFFER_TYPE_UNSET;
@@ -39,28 +54,107 @@ HdlcdServerHandler::HdlcdServerHandler(boost::asio::io_service& a_IOService, std
     m_bDeliverRcvd = false;
     m_bDeliverInvalidData = false;
     m_bSerialPortHandlerAwaitsPacket = false;
-    
-    // Prepare frame endpoint
-    m_FrameEndpoint = std::make_shared<FrameEndpoint>(a_IOService, a_TcpSocket);
-    m_FrameEndpoint->RegisterFrameFactory(0x00, []()->std::shared_ptr<Frame>{ return HdlcdSessionHeader::CreateDeserializedFrame(); });
-    m_FrameEndpoint->SetOnFrameCallback([this](std::shared_ptr<Frame> a_Frame)->bool{ return OnFrame(a_Frame); });
-    m_FrameEndpoint->SetOnClosedCallback ([this](){ OnClosed(); });
+    m_bReceiverStalled = false;
+    m_PrefetchDepth = (a_PrefetchDepth ? a_PrefetchDepth : 1);
+    m_IngestSequenceNbr = 0;
+    m_bCreditsEnabled = false;
+    m_bConfirmationsEnabled = false;
+    m_bBatchDelivery = false;
+    m_bSendScheduled = false;
+    m_bSharedMemoryRing = false;
+    m_CreditWindow = 0;
+    m_Credits = 0;
+    m_PendingCredits = 0;
+    m_SendQueueBytes = 0;
+    m_PacketsInFlight = 0;
+    m_DroppedPackets = 0;
+    m_PendingGapPackets = 0;
+    m_SampleCounter = 0;
+    m_bDisconnectPending = false;
+    m_bDeliveryThrottleConfigured = false;
+    m_SuppressedPackets = 0;
+    m_PendingSuppressedPackets = 0;
 }
 
-void HdlcdServerHandler::DeliverBufferToClient(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent) {
-    // Check whether this buffer is of interest to this specific client
-    bool l_bDeliver = (a_eBufferType == m_eBufferType);
-    if ((a_bWasSent && !m_bDeliverSent) || (!a_bWasSent && !m_bDeliverRcvd)) {
-        l_bDeliver = false;
+void HdlcdServerHandler::DeliverPacketToClient(std::shared_ptr<const HdlcdPacketData> a_PacketData) {
+    // The serial port handler only calls subscribed clients, see SerialPortHandler::RebuildSubscriptions().
+    // The packet is immutable and shared with all other subscribers, just queue a reference to it.
+    assert(a_PacketData);
+    assert(WantsBuffer(a_PacketData->GetWasSent(), a_PacketData->GetInvalid()));
+    if ((!m_PacketEndpoint) || (m_bDisconnectPending)) {
+        return;
+    } // if
+
+    // Apply sampling and rate caps, if requested by the client
+    size_t l_PacketSize = (a_PacketData->GetData().size() + 3);
+    if (!m_DeliveryThrottle.Admit(l_PacketSize)) {
+        ++m_SuppressedPackets;
+        ++m_PendingSuppressedPackets;
+        return;
     } // if
     
-    if ((m_bDeliverInvalidData == false) && (a_bInvalid)) {
-        l_bDeliver = false;
+    // Check whether the client reads fast enough to keep up with the data packets
+    if (m_SlowConsumerPolicy.ExceedsLimits(m_SendQueue.size(), m_SendQueueBytes, l_PacketSize)) {
+        switch (m_SlowConsumerPolicy.GetAction(m_eBufferType)) {
+        case SlowConsumerPolicy::ACTION_DROP_OLDEST: {
+            while (m_SlowConsumerPolicy.ExceedsLimits(m_SendQueue.size(), m_SendQueueBytes, l_PacketSize)) {
+                if (!DropOldestPacket()) {
+                    break;
+                } // if
+            } // while
+            
+            break;
+        }
+        case SlowConsumerPolicy::ACTION_DROP_NEWEST: {
+            // Drop this packet. The next packet that fits is preceded by a gap indication.
+            ++m_DroppedPackets;
+            ++m_PendingGapPackets;
+            return;
+        }
+        case SlowConsumerPolicy::ACTION_SAMPLE: {
+            // Keep only one of N packets, replacing the oldest queued packets
+            if (((++m_SampleCounter) % m_SlowConsumerPolicy.GetSampleRate()) != 0) {
+                ++m_DroppedPackets;
+                ++m_PendingGapPackets;
+                return;
+            } // if
+            
+            while (m_SlowConsumerPolicy.ExceedsLimits(m_SendQueue.size(), m_SendQueueBytes, l_PacketSize)) {
+                if (!DropOldestPacket()) {
+                    break;
+                } // if
+            } // while
+            
+            break;
+        }
+        case SlowConsumerPolicy::ACTION_DISCONNECT:
+        default: {
+            // Close the session later, as we are called while the serial port handler iterates over its subscribers
+            ++m_DroppedPackets;
+            m_bDisconnectPending = true;
+            std::cerr << "Disconnecting a client that does not read fast enough" << std::endl;
+            auto self(shared_from_this());
+            m_IOService.post([this, self]() { Stop(); });
+            return;
+        }
+        } // switch
     } // if
 
-    if (l_bDeliver) {
-        m_PacketEndpoint->Send(HdlcdPacketData::CreatePacket(a_Payload, a_bReliable, a_bInvalid, a_bWasSent));
+    EnqueuePacket(std::move(a_PacketData));
+    if (m_bBatchDelivery) {
+        ScheduleSend();
+    } else {
+        DoSend();
+    } // else
+}
+
+void HdlcdServerHandler::ReportGap(uint32_t a_DroppedPackets) {
+    // Data packets that were dropped before reaching this session. The next queued data packet is preceded by a gap indication.
+    if ((!m_PacketEndpoint) || (m_bDisconnectPending)) {
+        return;
     } // if
+    
+    m_PendingGapPackets += a_DroppedPackets;
 }
 
 void HdlcdServerHandler::UpdateSerialPortState(bool a_bAlive, size_t a_LockHolders) {
@@ -81,50 +175,106 @@ void HdlcdServerHandler::QueryForPayload(bool a_bQueryReliable, bool a_bQueryUnr
         return;
     } // if
 
-    // Deliver a pending incoming data packet, dependend on the state of packets accepted by the serial port handler.
-    // If no suitable packet is pending, set a flag that allows immediate delivery of the next packet.
-    if (m_PendingIncomingPacketData) {
-        bool l_bDeliver = (a_bQueryReliable   &&  m_PendingIncomingPacketData->GetReliable());
-        l_bDeliver     |= (a_bQueryUnreliable && !m_PendingIncomingPacketData->GetReliable());
-        if (l_bDeliver) {
-            m_SerialPortHandler->DeliverPayloadToHDLC(m_PendingIncomingPacketData->GetData(), m_PendingIncomingPacketData->GetReliable());
-            m_PendingIncomingPacketData.reset();
-            m_PacketEndpoint->TriggerNextDataPacket();
+    // Deliver the oldest pending incoming data packet of the requested kinds. If no suitable packet is pending,
+    // set a flag that allows immediate delivery of the next packet.
+    std::deque<IngestQueueEntry>* l_IngestQueue = NULL;
+    if ((a_bQueryReliable) && (m_IngestQueueReliable.empty() == false)) {
+        l_IngestQueue = &m_IngestQueueReliable;
+    } // if
+    
+    if ((a_bQueryUnreliable) && (m_IngestQueueUnreliable.empty() == false)) {
+        if ((!l_IngestQueue) || (m_IngestQueueUnreliable.front().m_SequenceNbr < l_IngestQueue->front().m_SequenceNbr)) {
+            l_IngestQueue = &m_IngestQueueUnreliable;
         } // if
+    } // if
+    
+    if (l_IngestQueue) {
+        auto l_PacketData = std::move(l_IngestQueue->front().m_PacketData);
+        uint64_t l_SequenceNbr = l_IngestQueue->front().m_SequenceNbr;
+        l_IngestQueue->pop_front();
+        DeliverIngestPacket(std::move(l_PacketData), l_SequenceNbr);
     } else {
         // No packet was pending, but we want to receive more!
         m_bSerialPortHandlerAwaitsPacket = true;
-        m_PacketEndpoint->TriggerNextDataPacket();
     } // else
+    
+    // Resume the receiver if there is room for more data packets
+    if ((m_bReceiverStalled) && (m_PacketEndpoint) && ((m_IngestQueueReliable.size() + m_IngestQueueUnreliable.size()) < m_PrefetchDepth)) {
+        m_bReceiverStalled = false;
+        m_PacketEndpoint->TriggerNextDataPacket();
+    } // if
 }
 
 void HdlcdServerHandler::Start(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection) {
-    assert(m_Registered == false);
-    assert(a_SerialPortHandlerCollection);
-    m_SerialPortHandlerCollection = a_SerialPortHandlerCollection;
-    if (auto lock = m_HdlcdServerHandlerCollection.lock()) {
-        m_Registered = true;
-        m_bSerialPortHandlerAwaitsPacket = true;
-        lock->RegisterHdlcdServerHandler(shared_from_this());
-    } else {
-        assert(false);
-    } // else
+    assert(m_FrameEndpoint);
+    if (Register(a_SerialPortHandlerCollection)) {
+        // Start waiting for the session header
+        m_FrameEndpoint->Start();
+    } // if
+}
 
-    // Start waiting for the session header
-    m_FrameEndpoint->Start();
+void HdlcdServerHandler::Start(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, std::shared_ptr<HdlcdSessionHeader> a_HdlcdSessionHeader) {
+    // The session header was already received to select the event loop of the serial port
+    assert(m_FrameEndpoint);
+    assert(a_HdlcdSessionHeader);
+    if (Register(a_SerialPortHandlerCollection)) {
+        OnFrame(a_HdlcdSessionHeader);
+        if (m_Registered) {
+            // Start receiving the session options, or the packets of the session
+            m_FrameEndpoint->Start();
+        } // if
+    } // if
+}
+
+void HdlcdServerHandler::StartChannel(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, unsigned char a_SAP, const std::string& a_SerialPortName, const std::vector<unsigned char>& a_SessionOptions) {
+    // The session header and the session options of a channel are provided by the channel open request
+    assert(!m_FrameEndpoint);
+    assert(m_PacketEndpoint);
+    if (!Register(a_SerialPortHandlerCollection)) {
+        return;
+    } // if
+    
+    if ((!ApplyServiceAccessPointSpecifier(a_SAP)) || (!ParseSessionOptions(a_SessionOptions))) {
+        std::cerr << "Channel with invalid session type or session options rejected" << std::endl;
+        Stop();
+        return;
+    } // if
+    
+    m_SerialPortName = a_SerialPortName;
+    StartSession();
 }
 
 void HdlcdServerHandler::Stop() {
     // Keep this object alive
     auto self(shared_from_this());
-    m_SerialPortHandler.reset();
+    if (m_SerialPortHandler) {
+        // The serial port handler holds a strong reference to us
+        m_SerialPortHandler->RemoveHdlcdServerHandler(self);
+        m_SerialPortHandler.reset();
+    } // if
     if (m_Registered) {
         m_Registered = false;
         m_bSerialPortHandlerAwaitsPacket = false;
+        m_IngestQueueReliable.clear();
+        m_IngestQueueUnreliable.clear();
+        m_SendQueue.clear();
+        m_SendQueueBytes = 0;
+        if (m_DroppedPackets) {
+            std::cerr << "Client session closed, " << m_DroppedPackets << " data packets were dropped as the client did not read fast enough" << std::endl;
+        } // if
+        if (m_SuppressedPackets) {
+            std::cerr << "Client session closed, " << m_SuppressedPackets << " data packets were suppressed due to sampling or rate caps" << std::endl;
+        } // if
+        if (m_HdlcdServerMultiplexer) {
+            // Stop all channels first, the TCP socket is closed afterwards
+            m_HdlcdServerMultiplexer->Stop();
+            m_HdlcdServerMultiplexer.reset();
+        } // if
+        
         if (m_PacketEndpoint) {
-            assert(!m_FrameEndpoint);
             m_PacketEndpoint->Close();
             m_PacketEndpoint.reset();
+            m_FrameEndpoint.reset();
         } else {    
             m_FrameEndpoint->Shutdown();
             m_FrameEndpoint->Close();
@@ -143,94 +293,298 @@ bool HdlcdServerHandler::OnFrame(const std::shared_ptr<Frame> a_Frame) {
     assert(m_FrameEndpoint);
     assert(!m_PacketEndpoint);
 
+    // Parse the session options, if announced by the session header
+    if (m_HdlcdSessionHeader) {
+        auto l_PacketCtrlExt = std::dynamic_pointer_cast<HdlcdPacketCtrlExt>(a_Frame);
+        if ((!l_PacketCtrlExt) || (l_PacketCtrlExt->GetPacketType() != HdlcdPacketCtrlExt::CTRL_EXT_TYPE_SESSION_OPTIONS)) {
+            std::cerr << "Session options expected after the session header" << std::endl;
+            Stop();
+            return false;
+        } // if
+        
+        if (!ParseSessionOptions(l_PacketCtrlExt->GetValue())) {
+            std::cerr << "Invalid session options rejected" << std::endl;
+            Stop();
+            return false;
+        } // if
+        
+        StartSession();
+        return false;
+    } // if
+
     // Parse the session header
     auto l_HdlcdSessionHeader = std::dynamic_pointer_cast<HdlcdSessionHeader>(a_Frame);
     if (l_HdlcdSessionHeader) {
         // The session header is now available. Check service access point specifier: type of data
         uint8_t l_SAP = l_HdlcdSessionHeader->GetServiceAccessPointSpecifier();
-        switch (l_SAP & 0xF0) {
-        case 0x00: {
-            m_eBufferType = BUFFER_TYPE_PAYLOAD;
+        if (l_SAP == 0x60) {
+            // A multiplexed session: the serial port string is ignored, the channels are opened later
+            m_HdlcdServerMultiplexer = std::make_shared<HdlcdServerMultiplexer>(m_IOService, m_FrameEndpoint, m_HdlcdServerHandlerCollection, m_SerialPortHandlerCollection, m_SlowConsumerPolicy, m_PrefetchDepth);
+            m_HdlcdServerMultiplexer->Start();
+            return false;
+        } // if
+        
+        if (!ApplyServiceAccessPointSpecifier(l_SAP)) {
+            std::cerr << "Unknown session type rejected: " << (int)(l_SAP & 0xF0) << std::endl;
+            Stop();
+            return false;
+        } // if
+        
+        // Check service access point specifier: session options follow?
+        m_HdlcdSessionHeader = l_HdlcdSessionHeader;
+        m_SerialPortName = l_HdlcdSessionHeader->GetSerialPortName();
+        if (l_SAP & 0x08) {
+            // Continue receiving. The next frame must be an extended control packet carrying the session options.
+            m_FrameEndpoint->RegisterFrameFactory(0x30, []()->std::shared_ptr<Frame>{ return HdlcdPacketCtrlExt::CreateDeserializedPacket(); });
+            return true;
+        } // if
+        
+        StartSession();
+    } else {
+        // Instead of a session header we received junk! This is impossible.
+        assert(false);
+        Stop();
+    } // else
+    
+    // In each case: stall the receiver! The HdlcdServerPacketEndpoint continues...
+    return false;
+}
+
+bool HdlcdServerHandler::Register(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection) {
+    assert(m_Registered == false);
+    assert(a_SerialPortHandlerCollection);
+    m_SerialPortHandlerCollection = a_SerialPortHandlerCollection;
+    if (auto lock = m_HdlcdServerHandlerCollection.lock()) {
+        m_Registered = true;
+        m_bSerialPortHandlerAwaitsPacket = true;
+        lock->RegisterHdlcdServerHandler(shared_from_this());
+        return true;
+    } else {
+        assert(false);
+        return false;
+    } // else
+}
+
+bool HdlcdServerHandler::ApplyServiceAccessPointSpecifier(unsigned char a_SAP) {
+    // Check service access point specifier: type of data
+    switch (a_SAP & 0xF0) {
+    case 0x00: {
+        m_eBufferType = BUFFER_TYPE_PAYLOAD;
+        break;
+    }
+    case 0x10: {
+        m_eBufferType = BUFFER_TYPE_PORT_STATUS;
+        break;
+    }
+    case 0x20: {
+        m_eBufferType = BUFFER_TYPE_PAYLOAD;
+        break;
+    }
+    case 0x30: {
+        m_eBufferType = BUFFER_TYPE_RAW;
+        break;
+    }
+    case 0x40: {
+        m_eBufferType = BUFFER_TYPE_DISSECTED;
+        break;
+    }
+    case 0x50: {
+        m_eBufferType = BUFFER_TYPE_STRUCTURED;
+        break;
+    }
+    default:
+        // Unknown session type. Multiplexed sessions cannot be nested.
+        return false;
+    } // switch
+    
+    // Check service access point specifier: invalids, deliver sent, and deliver rcvd
+    m_bDeliverInvalidData = (a_SAP & 0x04); 
+    m_bDeliverSent        = (a_SAP & 0x02);
+    m_bDeliverRcvd        = (a_SAP & 0x01);
+    return true;
+}
+
+bool HdlcdServerHandler::ParseSessionOptions(const std::vector<unsigned char> &a_SessionOptions) {
+    // A sequence of options, each consisting of the option type (1 byte), the length (2 bytes), and the value
+    size_t l_Offset = 0;
+    while (l_Offset < a_SessionOptions.size()) {
+        if ((l_Offset + 3) > a_SessionOptions.size()) {
+            return false;
+        } // if
+        
+        unsigned char l_Option = a_SessionOptions[l_Offset];
+        size_t l_Length = ((a_SessionOptions[l_Offset + 1] << 8) | a_SessionOptions[l_Offset + 2]);
+        if ((l_Offset + 3 + l_Length) > a_SessionOptions.size()) {
+            return false;
+        } // if
+        
+        std::vector<unsigned char> l_Value((a_SessionOptions.begin() + l_Offset + 3), (a_SessionOptions.begin() + l_Offset + 3 + l_Length));
+        l_Offset += (3 + l_Length);
+        switch (l_Option) {
+        case 0x01: {
+            // Subscription filter. Not applicable to port status sessions.
+            if ((m_SubscriptionFilter) || (m_eBufferType == BUFFER_TYPE_PORT_STATUS)) {
+                return false;
+            } // if
+            
+            auto l_SubscriptionFilter = std::make_shared<SubscriptionFilter>();
+            if (!l_SubscriptionFilter->Compile(l_Value)) {
+                return false;
+            } // if
+            
+            m_SubscriptionFilter = l_SubscriptionFilter;
             break;
         }
-        case 0x10: {
-            m_eBufferType = BUFFER_TYPE_PORT_STATUS;
+        case 0x02: {
+            // Sampling and rate caps. Not applicable to port status sessions, as they only receive state changes.
+            if ((m_bDeliveryThrottleConfigured) || (m_eBufferType == BUFFER_TYPE_PORT_STATUS)) {
+                return false;
+            } // if
+            
+            if (!m_DeliveryThrottle.Configure(l_Value)) {
+                return false;
+            } // if
+            
+            m_bDeliveryThrottleConfigured = true;
             break;
         }
-        case 0x20: {
-            m_eBufferType = BUFFER_TYPE_PAYLOAD;
+        case 0x03: {
+            // Credit-based flow control: the desired window (2 bytes), limited by the prefetch depth. 0 selects the prefetch depth.
+            if ((m_bCreditsEnabled) || (m_eBufferType != BUFFER_TYPE_PAYLOAD) || (l_Value.size() != 2)) {
+                return false;
+            } // if
+            
+            size_t l_CreditWindow = ((l_Value[0] << 8) | l_Value[1]);
+            m_bCreditsEnabled = true;
+            m_CreditWindow = (((l_CreditWindow == 0) || (l_CreditWindow > m_PrefetchDepth)) ? m_PrefetchDepth : l_CreditWindow);
             break;
         }
-        case 0x30: {
-            m_eBufferType = BUFFER_TYPE_RAW;
+        case 0x04: {
+            // Confirmations of transmitted data packets, without a value
+            if ((m_bConfirmationsEnabled) || (m_eBufferType != BUFFER_TYPE_PAYLOAD) || (l_Value.empty() == false)) {
+                return false;
+            } // if
+            
+            m_bConfirmationsEnabled = true;
             break;
         }
-        case 0x40: {
-            m_eBufferType = BUFFER_TYPE_DISSECTED;
+        case 0x05: {
+            // Batched delivery of data packets, without a value. Not applicable to port status sessions.
+            if ((m_bBatchDelivery) || (m_eBufferType == BUFFER_TYPE_PORT_STATUS) || (l_Value.empty() == false)) {
+                return false;
+            } // if
+            
+            m_bBatchDelivery = true;
+            break;
+        }
+        case 0x06: {
+            // Delivery via a shared memory ring, without a value. Not applicable to port status sessions.
+            if ((m_bSharedMemoryRing) || (m_eBufferType == BUFFER_TYPE_PORT_STATUS) || (l_Value.empty() == false) || (!SharedMemoryRing::IsSupported())) {
+                return false;
+            } // if
+            
+            m_bSharedMemoryRing = true;
             break;
         }
         default:
-            // Unknown session type
-            std::cerr << "Unknown session type rejected: " << (int)(l_SAP & 0xF0) << std::endl;
-            Stop();
+            // Unknown option
             return false;
         } // switch
-        
-        // Check service access point specifier: reserved bit
-        if (l_SAP & 0x08) {
-            // The reserved bit was set... aborting
-            std::cerr << "Invalid reserved bit within SAP specifier of session header: " << (int)l_SAP << std::endl;
-            Stop();
-            return false;
+    } // while
+    
+    // The shared memory ring is shared by all of its readers, per-client delivery options cannot be applied
+    if ((m_bSharedMemoryRing) && ((m_SubscriptionFilter) || (m_DeliveryThrottle.IsActive()) || (m_bBatchDelivery))) {
+        return false;
+    } // if
+    
+    return true;
+}
+
+void HdlcdServerHandler::StartSession() {
+    // Start the PacketEndpoint. It takes full control over the TCP socket. Channels already have their packet endpoint.
+    if (!m_PacketEndpoint) {
+        m_PacketEndpoint = std::make_shared<HdlcdServerPacketEndpoint>(m_FrameEndpoint);
+    } // if
+    
+    m_PacketEndpoint->SetOnDataCallback([this](std::shared_ptr<const HdlcdPacketData> a_PacketData){ return OnDataReceived(a_PacketData); });
+    m_PacketEndpoint->SetOnCtrlCallback([this](const HdlcdPacketCtrl& a_PacketCtrl){ OnCtrlReceived(a_PacketCtrl); });
+    m_PacketEndpoint->SetOnClosedCallback([this](){ OnClosed(); });
+    auto l_SerialPortHandlerStopper = m_SerialPortHandlerCollection->GetSerialPortHandler(m_SerialPortName, shared_from_this(), m_IOService);
+    if (l_SerialPortHandlerStopper) {
+        m_SerialPortHandlerStopper = l_SerialPortHandlerStopper;
+        m_SerialPortHandler = (*m_SerialPortHandlerStopper.get());
+        m_LockGuard.Init(m_SerialPortHandler);
+        if (m_bSharedMemoryRing) {
+            // Tell the client where to find the data packets
+            auto l_SharedMemoryRingName = m_SerialPortHandler->GetSharedMemoryRingName(m_eBufferType);
+            if (l_SharedMemoryRingName.empty()) {
+                std::cerr << "No shared memory ring available, closing the session" << std::endl;
+                Stop();
+                return;
+            } // if
+            
+            m_PacketEndpoint->Send(HdlcdPacketCtrlExt::CreateSharedMemoryRingAnnouncement(l_SharedMemoryRingName));
         } // if
         
-        // Check service access point specifier: invalids, deliver sent, and deliver rcvd
-        m_bDeliverInvalidData = (l_SAP & 0x04); 
-        m_bDeliverSent        = (l_SAP & 0x02);
-        m_bDeliverRcvd        = (l_SAP & 0x01);
-        
-        // Start the PacketEndpoint. It takes full control over the TCP socket.
-        m_PacketEndpoint = std::make_shared<HdlcdPacketEndpoint>(m_IOService, m_FrameEndpoint);
-        m_PacketEndpoint->SetOnDataCallback([this](std::shared_ptr<const HdlcdPacketData> a_PacketData){ return OnDataReceived(a_PacketData); });
-        m_PacketEndpoint->SetOnCtrlCallback([this](const HdlcdPacketCtrl& a_PacketCtrl){ OnCtrlReceived(a_PacketCtrl); });
-        m_PacketEndpoint->SetOnClosedCallback([this](){ OnClosed(); });
-        m_FrameEndpoint.reset();
-        auto l_SerialPortHandlerStopper = m_SerialPortHandlerCollection->GetSerialPortHandler(l_HdlcdSessionHeader->GetSerialPortName(), shared_from_this());
-        if (l_SerialPortHandlerStopper) {
-            m_SerialPortHandlerStopper = l_SerialPortHandlerStopper;
-            m_SerialPortHandler = (*m_SerialPortHandlerStopper.get());
-            m_LockGuard.Init(m_SerialPortHandler);
-            m_SerialPortHandler->PropagateSerialPortState(); // Sends initial port status message
-            m_PacketEndpoint->Start();
-        } else {
-            // This object is dead now! -> Close() was already called by the SerialPortHandler
-        } // else
+        m_SerialPortHandler->PropagateSerialPortState(); // Sends initial port status message
+        m_PacketEndpoint->Start();
+        if (m_bCreditsEnabled) {
+            // The initial credits fill the whole window
+            m_PendingCredits = m_CreditWindow;
+            GrantCredits(true);
+        } // if
     } else {
-        // Instead of a session header we received junk! This is impossible.
-        assert(false);
+        // Either the serial port was rejected, or it could not be opened and the SerialPortHandler already stopped us
         Stop();
     } // else
-    
-    // In each case: stall the receiver! The HdlcdPacketEndpoint continues...
-    return false;
 }
 
 bool HdlcdServerHandler::OnDataReceived(std::shared_ptr<const HdlcdPacketData> a_PacketData) {
     // Checks
     assert(a_PacketData);
-    assert(!m_PendingIncomingPacketData);
+    if (!m_Registered) {
+        return false;
+    } // if
+    
+    if (m_bCreditsEnabled) {
+        if (m_Credits == 0) {
+            // The client sent more data packets than granted
+            std::cerr << "Client sent a data packet without credits, closing the session" << std::endl;
+            auto self(shared_from_this());
+            m_IOService.post([this, self]() { Stop(); });
+            return false;
+        } // if
+        
+        --m_Credits;
+    } // if
     
-    // Store the incoming packet, but try to deliver it now
-    m_PendingIncomingPacketData = a_PacketData;
-    if (m_bSerialPortHandlerAwaitsPacket) {
+    // Each data packet of the client is numbered, this number identifies it within confirmations
+    uint64_t l_SequenceNbr = m_IngestSequenceNbr++;
+    if ((m_bSerialPortHandlerAwaitsPacket) && (m_IngestQueueReliable.empty()) && (m_IngestQueueUnreliable.empty())) {
         // One packet can be delivered, regardless of its reliablility status and the kind of packets that are accepted.
         m_bSerialPortHandlerAwaitsPacket = false;
-        m_SerialPortHandler->DeliverPayloadToHDLC(m_PendingIncomingPacketData->GetData(), m_PendingIncomingPacketData->GetReliable());
-        m_PendingIncomingPacketData.reset();
-        return true; // continue receiving, we stall with the next data packet
+        DeliverIngestPacket(std::move(a_PacketData), l_SequenceNbr);
+        return true; // continue receiving
+    } // if
+    
+    // Queue the packet until the serial port handler asks for it
+    IngestQueueEntry l_IngestQueueEntry;
+    l_IngestQueueEntry.m_SequenceNbr = l_SequenceNbr;
+    bool l_bReliable = a_PacketData->GetReliable();
+    l_IngestQueueEntry.m_PacketData = std::move(a_PacketData);
+    if (l_bReliable) {
+        m_IngestQueueReliable.emplace_back(std::move(l_IngestQueueEntry));
+    } else {
+        m_IngestQueueUnreliable.emplace_back(std::move(l_IngestQueueEntry));
+    } // else
+    
+    // Continue receiving while the prefetch depth is not reached. Otherwise, stall the receiver now!
+    // With credits, the client cannot exceed the prefetch depth, and control packets must always be read.
+    if ((m_bCreditsEnabled) || ((m_IngestQueueReliable.size() + m_IngestQueueUnreliable.size()) < m_PrefetchDepth)) {
+        return true;
     } // if
     
-    // Stall the receiver now!
+    m_bReceiverStalled = true;
     return false;
 }
 
@@ -265,3 +619,168 @@ void HdlcdServerHandler::OnCtrlReceived(const HdlcdPacketCtrl& a_PacketCtrl) {
 void HdlcdServerHandler::OnClosed() {
     Stop();
 }
+
+void HdlcdServerHandler::ScheduleSend() {
+    // Defer sending to coalesce all data packets that arrive within this turn of the event loop
+    if (m_bSendScheduled) {
+        return;
+    } // if
+    
+    m_bSendScheduled = true;
+    auto self(shared_from_this());
+    m_IOService.post([this, self]() {
+        m_bSendScheduled = false;
+        DoSend();
+    });
+}
+
+void HdlcdServerHandler::DoSend() {
+    // Hand over only a few packets to the packet endpoint, as it serializes each of them into a private buffer.
+    // All other packets remain in the send queue as references to the shared packet objects.
+    auto l_bJoinsBatch = [](const HdlcdPacketData& a_PacketData, const SendQueueEntry& a_SendQueueEntry) {
+        // Only data packets with identical flags can be part of the same batch
+        return ((a_SendQueueEntry.m_eSendQueueEntry == SEND_QUEUE_ENTRY_DATA) &&
+                (a_SendQueueEntry.m_PacketData->GetReliable() == a_PacketData.GetReliable()) &&
+                (a_SendQueueEntry.m_PacketData->GetInvalid()  == a_PacketData.GetInvalid()) &&
+                (a_SendQueueEntry.m_PacketData->GetWasSent()  == a_PacketData.GetWasSent()));
+    };
+    
+    while ((m_PacketEndpoint) && (m_PacketsInFlight < max_packets_in_flight) && (m_SendQueue.empty() == false)) {
+        SendQueueEntry l_SendQueueEntry = std::move(m_SendQueue.front());
+        m_SendQueue.pop_front();
+        if (l_SendQueueEntry.m_eSendQueueEntry == SEND_QUEUE_ENTRY_GAP) {
+            m_PacketEndpoint->Send(HdlcdPacketCtrlExt::CreateGapIndication(l_SendQueueEntry.m_Packets));
+            continue;
+        } else if (l_SendQueueEntry.m_eSendQueueEntry == SEND_QUEUE_ENTRY_SUPPRESSED) {
+            m_PacketEndpoint->Send(HdlcdPacketCtrlExt::CreateSuppressionIndication(l_SendQueueEntry.m_Packets));
+            continue;
+        } // else if
+        
+        auto self(shared_from_this());
+        auto l_OnSendDone = [this, self]() {
+            assert(m_PacketsInFlight);
+            --m_PacketsInFlight;
+            DoSend();
+        };
+        
+        const HdlcdPacketData& l_PacketData = *l_SendQueueEntry.m_PacketData;
+        m_SendQueueBytes -= (l_PacketData.GetData().size() + 3);
+        ++m_PacketsInFlight;
+        if ((m_bBatchDelivery) && (m_SendQueue.empty() == false) && (l_bJoinsBatch(l_PacketData, m_SendQueue.front()))) {
+            // Coalesce the subsequent data packets into one batch
+            auto l_PacketDataBatch = HdlcdPacketDataBatch::CreatePacket(l_PacketData.GetReliable(), l_PacketData.GetInvalid(), l_PacketData.GetWasSent());
+            l_PacketDataBatch.AppendPacketData(l_SendQueueEntry.m_PacketData);
+            while ((m_SendQueue.empty() == false) && (l_bJoinsBatch(l_PacketData, m_SendQueue.front())) &&
+                   (l_PacketDataBatch.GetPayloadCount() < max_batch_payloads) && (l_PacketDataBatch.GetPayloadBytes() < max_batch_bytes)) {
+                m_SendQueueBytes -= (m_SendQueue.front().m_PacketData->GetData().size() + 3);
+                l_PacketDataBatch.AppendPacketData(std::move(m_SendQueue.front().m_PacketData));
+                m_SendQueue.pop_front();
+            } // while
+            
+            m_PacketEndpoint->Send(l_PacketDataBatch, l_OnSendDone);
+        } else {
+            m_PacketEndpoint->Send(l_PacketData, l_OnSendDone);
+        } // else
+    } // while
+}
+
+void HdlcdServerHandler::EnqueuePacket(std::shared_ptr<const HdlcdPacketData> a_PacketData) {
+    if (m_PendingGapPackets) {
+        // Report previously dropped packets at their position within the stream of data packets
+        SendQueueEntry l_GapIndication;
+        l_GapIndication.m_eSendQueueEntry = SEND_QUEUE_ENTRY_GAP;
+        l_GapIndication.m_Packets = m_PendingGapPackets;
+        m_SendQueue.emplace_back(std::move(l_GapIndication));
+        m_PendingGapPackets = 0;
+    } // if
+    
+    if ((m_PendingSuppressedPackets) && (m_DeliveryThrottle.IsReportDue())) {
+        // Report suppressed packets, but at most once per second
+        SendQueueEntry l_SuppressionIndication;
+        l_SuppressionIndication.m_eSendQueueEntry = SEND_QUEUE_ENTRY_SUPPRESSED;
+        l_SuppressionIndication.m_Packets = m_PendingSuppressedPackets;
+        m_SendQueue.emplace_back(std::move(l_SuppressionIndication));
+        m_PendingSuppressedPackets = 0;
+    } // if
+    
+    SendQueueEntry l_SendQueueEntry;
+    l_SendQueueEntry.m_eSendQueueEntry = SEND_QUEUE_ENTRY_DATA;
+    m_SendQueueBytes += (a_PacketData->GetData().size() + 3);
+    l_SendQueueEntry.m_PacketData = std::move(a_PacketData);
+    l_SendQueueEntry.m_Packets = 0;
+    m_SendQueue.emplace_back(std::move(l_SendQueueEntry));
+}
+
+void HdlcdServerHandler::DeliverIngestPacket(std::shared_ptr<const HdlcdPacketData> a_PacketData, uint64_t a_SequenceNbr) {
+    PayloadConfirmationCallback l_OnConfirmation;
+    if (m_bConfirmationsEnabled) {
+        // The protocol state may outlive this session, thus only a weak reference is kept
+        std::weak_ptr<HdlcdServerHandler> l_HdlcdServerHandler(shared_from_this());
+        uint32_t l_SequenceNbr = (uint32_t)a_SequenceNbr;
+        l_OnConfirmation = [l_HdlcdServerHandler, l_SequenceNbr](E_PAYLOAD_CONFIRMATION a_ePayloadConfirmation) {
+            if (auto lock = l_HdlcdServerHandler.lock()) {
+                lock->ConfirmPayload(l_SequenceNbr, a_ePayloadConfirmation);
+            } // if
+        };
+    } // if
+    
+    // May cause cyclic calls of QueryForPayload()
+    m_SerialPortHandler->DeliverPayloadToHDLC(a_PacketData->GetData(), a_PacketData->GetReliable(), std::move(l_OnConfirmation));
+    if (m_bCreditsEnabled) {
+        // Return the credit to the client, either in batches or immediately if the client ran out of credits
+        ++m_PendingCredits;
+        GrantCredits(m_Credits == 0);
+    } // if
+}
+
+void HdlcdServerHandler::ConfirmPayload(uint32_t a_SequenceNbr, E_PAYLOAD_CONFIRMATION a_ePayloadConfirmation) {
+    if ((m_Registered) && (m_PacketEndpoint)) {
+        m_PacketEndpoint->Send(HdlcdPacketCtrlExt::CreateConfirmation(a_SequenceNbr, a_ePayloadConfirmation));
+    } // if
+}
+
+void HdlcdServerHandler::GrantCredits(bool a_bForce) {
+    // Without a_bForce, credits are returned in batches of half the window to reduce the number of grants
+    if ((m_PendingCredits == 0) || (!m_PacketEndpoint)) {
+        return;
+    } // if
+    
+    if ((a_bForce) || ((m_PendingCredits * 2) >= m_CreditWindow)) {
+        m_Credits += m_PendingCredits;
+        m_PacketEndpoint->Send(HdlcdPacketCtrlExt::CreateCreditGrant(m_PendingCredits));
+        m_PendingCredits = 0;
+    } // if
+}
+
+bool HdlcdServerHandler::DropOldestPacket() {
+    // Replace the oldest queued data packet and all indications ahead of it by a single gap indication at the head of the queue.
+    // Returns false if no data packet was queued.
+    uint32_t l_GapPackets = 0;
+    while ((m_SendQueue.empty() == false) && (m_SendQueue.front().m_eSendQueueEntry != SEND_QUEUE_ENTRY_DATA)) {
+        if (m_SendQueue.front().m_eSendQueueEntry == SEND_QUEUE_ENTRY_GAP) {
+            l_GapPackets += m_SendQueue.front().m_Packets;
+        } else {
+            // Do not lose the count, report it with the next suppression indication
+            m_PendingSuppressedPackets += m_SendQueue.front().m_Packets;
+        } // else
+        
+        m_SendQueue.pop_front();
+    } // while
+    
+    bool l_bDropped = (m_SendQueue.empty() == false);
+    if (l_bDropped) {
+        m_SendQueueBytes -= (m_SendQueue.front().m_PacketData->GetData().size() + 3);
+        m_SendQueue.pop_front();
+        ++m_DroppedPackets;
+        ++l_GapPackets;
+    } // if
+    
+    if (l_GapPackets) {
+        SendQueueEntry l_GapIndication;
+        l_GapIndication.m_eSendQueueEntry = SEND_QUEUE_ENTRY_GAP;
+        l_GapIndication.m_Packets = l_GapPackets;
+        m_SendQueue.emplace_front(std::move(l_GapIndication));
+    } // if
+    
+    return l_bDropped;
+}
@@ -31,10 +31,16 @@
 #include "AliveGuard.h"
 #include "LockGuard.h"
 #include "BufferType.h"
+#include "SlowConsumerPolicy.h"
+#include "DeliveryThrottle.h"
+#include "PayloadConfirmation.h"
 class Frame;
 class HdlcdPacketData;
+class HdlcdSessionHeader;
+class SubscriptionFilter;
 class HdlcdPacketCtrl;
-class HdlcdPacketEndpoint;
+class HdlcdServerPacketEndpoint;
+class HdlcdServerMultiplexer;
 class FrameEndpoint;
 class HdlcdServerHandlerCollection;
 class SerialPortHandler;
@@ -42,37 +48,120 @@ class SerialPortHandlerCollection;
 
 class HdlcdServerHandler: public std::enable_shared_from_this<HdlcdServerHandler> {
 public:
-    HdlcdServerHandler(boost::asio::io_service& a_IOService, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection, boost::asio::ip::tcp::socket& a_TcpSocket);
+    HdlcdServerHandler(boost::asio::io_service& a_IOService, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection, boost::asio::ip::tcp::socket& a_TcpSocket, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth);
+    HdlcdServerHandler(boost::asio::io_service& a_IOService, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection, std::shared_ptr<HdlcdServerPacketEndpoint> a_PacketEndpoint, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth);
     
     E_BUFFER_TYPE GetBufferType() const { return m_eBufferType; }
-    void DeliverBufferToClient(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent);
+    bool WantsBuffer(bool a_bWasSent, bool a_bInvalid) const { return ((a_bWasSent ? m_bDeliverSent : m_bDeliverRcvd) && (m_bDeliverInvalidData || !a_bInvalid)); }
+    std::shared_ptr<const SubscriptionFilter> GetSubscriptionFilter() const { return m_SubscriptionFilter; }
+    bool UsesSharedMemoryRing() const { return m_bSharedMemoryRing; }
+    void DeliverPacketToClient(std::shared_ptr<const HdlcdPacketData> a_PacketData);
+    void ReportGap(uint32_t a_DroppedPackets);
     void UpdateSerialPortState(bool a_bAlive, size_t a_LockHolders);
     void QueryForPayload(bool a_bQueryReliable, bool a_bQueryUnreliable);
     
     void Start(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection);
+    void Start(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, std::shared_ptr<HdlcdSessionHeader> a_HdlcdSessionHeader);
+    void StartChannel(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, unsigned char a_SAP, const std::string& a_SerialPortName, const std::vector<unsigned char>& a_SessionOptions);
     void Stop();
     
+    // Statistics regarding slow consumers and throttled delivery
+    size_t GetDroppedPackets() const { return m_DroppedPackets; }
+    size_t GetSuppressedPackets() const { return m_SuppressedPackets; }
+    
 private:
     // Callbacks
-    bool OnFrame(const std::shared_ptr<Frame> a_Frame); // To parse the session header
+    bool OnFrame(const std::shared_ptr<Frame> a_Frame); // To parse the session header and the session options
     bool OnDataReceived(std::shared_ptr<const HdlcdPacketData> a_PacketData);
     void OnCtrlReceived(const HdlcdPacketCtrl& a_PacketCtrl);
     void OnClosed();
+    
+    // Internal helpers
+    bool Register(std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection);
+    bool ApplyServiceAccessPointSpecifier(unsigned char a_SAP);
+    bool ParseSessionOptions(const std::vector<unsigned char> &a_SessionOptions);
+    void StartSession();
+    void ScheduleSend();
+    void DoSend();
+    void EnqueuePacket(std::shared_ptr<const HdlcdPacketData> a_PacketData);
+    void DeliverIngestPacket(std::shared_ptr<const HdlcdPacketData> a_PacketData, uint64_t a_SequenceNbr);
+    void ConfirmPayload(uint32_t a_SequenceNbr, E_PAYLOAD_CONFIRMATION a_ePayloadConfirmation);
+    void GrantCredits(bool a_bForce);
+    bool DropOldestPacket();
 
     // Members
     boost::asio::io_service& m_IOService;
     std::weak_ptr<HdlcdServerHandlerCollection> m_HdlcdServerHandlerCollection;
     std::shared_ptr<FrameEndpoint> m_FrameEndpoint;
-    std::shared_ptr<HdlcdPacketEndpoint> m_PacketEndpoint;
+    std::shared_ptr<HdlcdServerPacketEndpoint> m_PacketEndpoint;
     
     bool m_Registered;
     std::shared_ptr<SerialPortHandlerCollection> m_SerialPortHandlerCollection;
     std::shared_ptr<std::shared_ptr<SerialPortHandler>> m_SerialPortHandlerStopper;
     std::shared_ptr<SerialPortHandler> m_SerialPortHandler;
     
-    // Pending incoming data packets
+    // Outgoing data packets. These are shared by all clients that receive the same frame.
+    // An entry without a data packet is an indication, reporting a number of dropped or suppressed data packets.
+    typedef enum {
+        SEND_QUEUE_ENTRY_DATA       = 0,
+        SEND_QUEUE_ENTRY_GAP        = 1,
+        SEND_QUEUE_ENTRY_SUPPRESSED = 2
+    } E_SEND_QUEUE_ENTRY;
+    typedef struct {
+        E_SEND_QUEUE_ENTRY m_eSendQueueEntry;
+        std::shared_ptr<const HdlcdPacketData> m_PacketData;
+        uint32_t m_Packets; // Number of dropped or suppressed data packets
+    } SendQueueEntry;
+    enum { max_packets_in_flight = 8 }; // The maximum number of data packets handed over to the packet endpoint
+    enum { max_batch_payloads = 256 };  // The maximum number of data packets coalesced into one batch
+    enum { max_batch_bytes = 16384 };   // A batch is closed if its payloads reach this size
+    std::deque<SendQueueEntry> m_SendQueue;
+    size_t m_SendQueueBytes;
+    size_t m_PacketsInFlight;
+    
+    // Handling of slow consumers
+    SlowConsumerPolicy m_SlowConsumerPolicy;
+    size_t m_DroppedPackets;       // Total number of data packets dropped for this client
+    uint32_t m_PendingGapPackets;  // Number of dropped data packets not yet reported via a gap indication
+    unsigned int m_SampleCounter;
+    bool m_bDisconnectPending;
+    
+    // Sampling and rate caps, requested via the session options
+    DeliveryThrottle m_DeliveryThrottle;
+    bool m_bDeliveryThrottleConfigured;   // The session option was present, even if it does not limit anything
+    size_t m_SuppressedPackets;           // Total number of data packets suppressed for this client
+    uint32_t m_PendingSuppressedPackets;  // Number of suppressed data packets not yet reported via a suppression indication
+    
+    // Pending incoming data packets. Up to m_PrefetchDepth data packets are read ahead, thus the serial port handler
+    // can pull the next one without waiting for the TCP socket. Reliable and unreliable ones are queued separately.
+    typedef struct {
+        std::shared_ptr<const HdlcdPacketData> m_PacketData;
+        uint64_t m_SequenceNbr; // The order of arrival, also used to identify data packets within confirmations
+    } IngestQueueEntry;
     bool m_bSerialPortHandlerAwaitsPacket;
-    std::shared_ptr<const HdlcdPacketData> m_PendingIncomingPacketData;
+    bool m_bReceiverStalled;
+    size_t m_PrefetchDepth;
+    uint64_t m_IngestSequenceNbr;
+    std::deque<IngestQueueEntry> m_IngestQueueReliable;
+    std::deque<IngestQueueEntry> m_IngestQueueUnreliable;
+    
+    // Credit-based flow control, requested via the session options. The client may only send as many data packets as
+    // granted, thus the receiver never stalls and control packets are always read.
+    bool m_bCreditsEnabled;
+    size_t m_CreditWindow;      // The number of data packets the client may have in flight
+    size_t m_Credits;           // The number of data packets the client may still send
+    size_t m_PendingCredits;    // Consumed data packets not yet returned to the client
+    
+    // Confirmations of transmitted data packets, requested via the session options
+    bool m_bConfirmationsEnabled;
+    
+    // Batched delivery, requested via the session options. All data packets that arrive within one turn of the
+    // event loop are coalesced into batches, each written to the TCP socket at once.
+    bool m_bBatchDelivery;
+    bool m_bSendScheduled;
+    
+    // Delivery of data packets via the shared memory ring of the serial port, requested via the session options
+    bool m_bSharedMemoryRing;
 
     // Track the status of the serial port, communicate changes
     bool m_bDeliverInitialState;
@@ -80,10 +169,18 @@ private:
     LockGuard  m_LockGuard;
 
     // SAP specification
+    std::shared_ptr<HdlcdSessionHeader> m_HdlcdSessionHeader;
+    std::string m_SerialPortName;
     E_BUFFER_TYPE m_eBufferType;
     bool m_bDeliverSent;
     bool m_bDeliverRcvd;
     bool m_bDeliverInvalidData;
+    
+    // Session options
+    std::shared_ptr<const SubscriptionFilter> m_SubscriptionFilter;
+    
+    // Multiplexed sessions: the channels are served by dedicated objects, this one only owns the TCP socket
+    std::shared_ptr<HdlcdServerMultiplexer> m_HdlcdServerMultiplexer;
 };
 
 #endif // HDLCD_SERVER_HANDLER_H
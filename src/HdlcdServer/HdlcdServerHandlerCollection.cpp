@@ -21,13 +21,59 @@
 
 #include "HdlcdServerHandlerCollection.h"
 #include "HdlcdServerHandler.h"
+#include "SerialPortHandlerCollection.h"
+#include "HdlcdSessionHeader.h"
+#include <iostream>
 #include <assert.h>
+#include <stdexcept>
+#if !defined(BOOST_ASIO_WINDOWS)
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 using boost::asio::ip::tcp;
 
-HdlcdServerHandlerCollection::HdlcdServerHandlerCollection(boost::asio::io_service& a_IOService, std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, uint16_t a_TcpPortNbr):
-    m_IOService(a_IOService), m_SerialPortHandlerCollection(a_SerialPortHandlerCollection), m_TcpAcceptor(a_IOService, tcp::endpoint(tcp::v4(), a_TcpPortNbr)), m_TcpSocket(a_IOService) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+// Removes the socket file of a previous run, binding fails otherwise. Never removes other files, or the socket of a
+// running daemon.
+static void RemoveStaleUnixSocket(boost::asio::io_service& a_IOService, const std::string& a_UnixSocketPath) {
+    struct stat l_Stat;
+    if (::lstat(a_UnixSocketPath.c_str(), &l_Stat) != 0) {
+        // Does not exist
+        return;
+    } // if
+    
+    if (!S_ISSOCK(l_Stat.st_mode)) {
+        throw std::runtime_error("the unix domain socket path " + a_UnixSocketPath + " exists and is not a socket");
+    } // if
+    
+    boost::system::error_code l_ErrorCode;
+    boost::asio::local::stream_protocol::socket l_Socket(a_IOService);
+    l_Socket.connect(boost::asio::local::stream_protocol::endpoint(a_UnixSocketPath), l_ErrorCode);
+    if (!l_ErrorCode) {
+        throw std::runtime_error("the unix domain socket " + a_UnixSocketPath + " is in use by another process");
+    } // if
+    
+    ::unlink(a_UnixSocketPath.c_str());
+}
+#endif
+
+HdlcdServerHandlerCollection::HdlcdServerHandlerCollection(boost::asio::io_service& a_IOService, std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, uint16_t a_TcpPortNbr, const std::string& a_UnixSocketPath, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth):
+    m_IOService(a_IOService), m_SerialPortHandlerCollection(a_SerialPortHandlerCollection), m_SlowConsumerPolicy(a_SlowConsumerPolicy), m_PrefetchDepth(a_PrefetchDepth), m_TcpAcceptor(a_IOService, tcp::endpoint(tcp::v4(), a_TcpPortNbr)), m_TcpSocket(a_IOService)
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    , m_UnixSocketPath(a_UnixSocketPath), m_UnixSocket(a_IOService)
+#endif
+    {
     // Checks
     assert(m_SerialPortHandlerCollection);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    if (!m_UnixSocketPath.empty()) {
+        RemoveStaleUnixSocket(a_IOService, m_UnixSocketPath);
+        m_UnixAcceptor.reset(new boost::asio::local::stream_protocol::acceptor(a_IOService, boost::asio::local::stream_protocol::endpoint(m_UnixSocketPath)));
+        DoAcceptUnix();
+    } // if
+#else
+    assert(a_UnixSocketPath.empty());
+#endif
     
     // Trigger activity
     DoAccept();
@@ -36,10 +82,30 @@ HdlcdServerHandlerCollection::HdlcdServerHandlerCollection(boost::asio::io_servi
 void HdlcdServerHandlerCollection::Shutdown() {
     // Stop accepting subsequent TCP connections
     m_TcpAcceptor.close();
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    if (m_UnixAcceptor) {
+        m_UnixAcceptor->close();
+        m_UnixAcceptor.reset();
+        struct stat l_Stat;
+        if ((::lstat(m_UnixSocketPath.c_str(), &l_Stat) == 0) && (S_ISSOCK(l_Stat.st_mode))) {
+            ::unlink(m_UnixSocketPath.c_str());
+        } // if
+    } // if
+#endif
 
-    // Release all client handler objects. They deregister themselves.
-    while (!m_HdlcdServerHandlerList.empty()) {
-        (*m_HdlcdServerHandlerList.begin())->Stop();
+    // Release all client handler objects. They deregister themselves. All event loops are stopped already.
+    while (true) {
+        std::shared_ptr<HdlcdServerHandler> l_HdlcdServerHandler;
+        {
+            std::lock_guard<std::mutex> l_Lock(m_Mutex);
+            if (m_HdlcdServerHandlerList.empty()) {
+                break;
+            } // if
+            
+            l_HdlcdServerHandler = m_HdlcdServerHandlerList.front();
+        }
+        
+        l_HdlcdServerHandler->Stop();
     } // while
     
     // Drop all shared pointers
@@ -48,22 +114,147 @@ void HdlcdServerHandlerCollection::Shutdown() {
 }
 
 void HdlcdServerHandlerCollection::RegisterHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
     m_HdlcdServerHandlerList.emplace_back(std::move(a_HdlcdServerHandler));
 }
 
 void HdlcdServerHandlerCollection::DeregisterHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
     m_HdlcdServerHandlerList.remove(a_HdlcdServerHandler);
 }
 
 void HdlcdServerHandlerCollection::DoAccept() {
     m_TcpAcceptor.async_accept(m_TcpSocket, [this](boost::system::error_code a_ErrorCode) {
         if (!a_ErrorCode) {
-            // Create a HDLCd server handler object and start it. It registers itself to the HDLCd server handler collection
-            auto l_HdlcdServerHandler = std::make_shared<HdlcdServerHandler>(m_IOService, shared_from_this(), m_TcpSocket);
-            l_HdlcdServerHandler->Start(m_SerialPortHandlerCollection);
+            StartHdlcdServerHandler(m_TcpSocket);
         } // if
 
         // Wait for subsequent TCP connections
         DoAccept();
     }); // async_accept
 }
+
+void HdlcdServerHandlerCollection::StartHdlcdServerHandler(boost::asio::ip::tcp::socket& a_TcpSocket) {
+#if !defined(BOOST_ASIO_WINDOWS)
+    if (m_SerialPortHandlerCollection->GetIOServiceCount() > 1) {
+        // The session is served by the event loop of its serial port, which is known after the session header was
+        // received. The session header is handed over to the HDLCd server handler.
+        ReadSessionHeader(std::make_shared<PendingSession>(m_IOService, a_TcpSocket));
+        return;
+    } // if
+#endif
+    
+    StartHdlcdServerHandler(m_IOService, a_TcpSocket);
+}
+
+void HdlcdServerHandlerCollection::StartHdlcdServerHandler(boost::asio::io_service& a_IOService, boost::asio::ip::tcp::socket& a_TcpSocket, std::shared_ptr<HdlcdSessionHeader> a_HdlcdSessionHeader) {
+    // Create a HDLCd server handler object and start it. It registers itself to the HDLCd server handler collection
+    auto l_HdlcdServerHandler = std::make_shared<HdlcdServerHandler>(a_IOService, shared_from_this(), a_TcpSocket, m_SlowConsumerPolicy, m_PrefetchDepth);
+    if (a_HdlcdSessionHeader) {
+        l_HdlcdServerHandler->Start(m_SerialPortHandlerCollection, a_HdlcdSessionHeader);
+    } else {
+        l_HdlcdServerHandler->Start(m_SerialPortHandlerCollection);
+    } // else
+}
+
+#if !defined(BOOST_ASIO_WINDOWS)
+void HdlcdServerHandlerCollection::ReadSessionHeader(std::shared_ptr<PendingSession> a_PendingSession) {
+    // One deadline for the complete session header. Closing the TCP socket aborts the pending read operation.
+    auto self(shared_from_this());
+    a_PendingSession->m_Timer.expires_from_now(boost::posix_time::seconds((long)session_header_timeout_s));
+    a_PendingSession->m_Timer.async_wait([a_PendingSession](const boost::system::error_code& a_ErrorCode) {
+        if ((!a_ErrorCode) && (a_PendingSession->m_TcpSocket.is_open())) {
+            std::cerr << "Client did not send a complete session header, closing the session" << std::endl;
+            boost::system::error_code l_ErrorCode;
+            a_PendingSession->m_TcpSocket.close(l_ErrorCode);
+        } // if
+    }); // async_wait
+    
+    // Version, SAP, and the length of the serial port string first, then the serial port string
+    boost::asio::async_read(a_PendingSession->m_TcpSocket, boost::asio::buffer(a_PendingSession->m_Buffer, 3),
+                            [this, self, a_PendingSession](boost::system::error_code a_ErrorCode, std::size_t) {
+        if ((a_ErrorCode) || (a_PendingSession->m_Buffer[0] != 0x00)) {
+            // The client vanished or does not speak the HDLCd access protocol. The TCP socket is closed with the pending session.
+            a_PendingSession->m_Timer.cancel();
+            return;
+        } // if
+        
+        boost::asio::async_read(a_PendingSession->m_TcpSocket, boost::asio::buffer(a_PendingSession->m_Buffer + 3, a_PendingSession->m_Buffer[2]),
+                                [this, self, a_PendingSession](boost::system::error_code a_ErrorCode, std::size_t) {
+            a_PendingSession->m_Timer.cancel();
+            if (!a_ErrorCode) {
+                OnSessionHeader(a_PendingSession);
+            } // if
+        }); // async_read
+    }); // async_read
+}
+
+void HdlcdServerHandlerCollection::OnSessionHeader(std::shared_ptr<PendingSession> a_PendingSession) {
+    // Multiplexed sessions are not bound to a single serial port, they serve each channel via its own event loop
+    const unsigned char* l_Buffer = a_PendingSession->m_Buffer;
+    std::string l_SerialPortName(l_Buffer + 3, l_Buffer + 3 + l_Buffer[2]);
+    auto l_HdlcdSessionHeader = std::make_shared<HdlcdSessionHeader>(HdlcdSessionHeader::Create(l_Buffer[1], l_SerialPortName));
+    auto& l_IOService = ((l_Buffer[1] == 0x60) ? m_SerialPortHandlerCollection->GetNextIOService() : m_SerialPortHandlerCollection->GetIOService(l_SerialPortName));
+    if (&l_IOService == &m_IOService) {
+        StartHdlcdServerHandler(m_IOService, a_PendingSession->m_TcpSocket, l_HdlcdSessionHeader);
+    } else {
+        HandOverHdlcdServerHandler(l_IOService, a_PendingSession->m_TcpSocket, l_HdlcdSessionHeader);
+    } // else
+}
+
+void HdlcdServerHandlerCollection::HandOverHdlcdServerHandler(boost::asio::io_service& a_IOService, boost::asio::ip::tcp::socket& a_TcpSocket, std::shared_ptr<HdlcdSessionHeader> a_HdlcdSessionHeader) {
+    // A socket object is bound to the event loop it was created with. Thus, the file descriptor is handed over
+    // to a new socket object of the target event loop.
+    int l_FileDescriptor = ::dup(a_TcpSocket.native_handle());
+    a_TcpSocket.close();
+    if (l_FileDescriptor < 0) {
+        std::cerr << "Failed to hand over a client to another event loop" << std::endl;
+        return;
+    } // if
+    
+    auto self(shared_from_this());
+    a_IOService.post([this, self, &a_IOService, l_FileDescriptor, a_HdlcdSessionHeader]() {
+        boost::system::error_code l_ErrorCode;
+        tcp::socket l_TcpSocket(a_IOService);
+        l_TcpSocket.assign(tcp::v4(), l_FileDescriptor, l_ErrorCode);
+        if (l_ErrorCode) {
+            ::close(l_FileDescriptor);
+            std::cerr << "Failed to hand over a client to another event loop: " << l_ErrorCode.message() << std::endl;
+        } else {
+            StartHdlcdServerHandler(a_IOService, l_TcpSocket, a_HdlcdSessionHeader);
+        } // else
+    });
+}
+#endif
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+void HdlcdServerHandlerCollection::DoAcceptUnix() {
+    m_UnixAcceptor->async_accept(m_UnixSocket, [this](boost::system::error_code a_ErrorCode) {
+        if (a_ErrorCode == boost::asio::error::operation_aborted) {
+            // The acceptor was closed
+            return;
+        } // if
+        
+        if (!a_ErrorCode) {
+            // The frame endpoint only accepts TCP socket objects. As it solely uses stream operations that are the same
+            // for unix domain sockets, the file descriptor is handed over to a TCP socket object.
+            boost::system::error_code l_ErrorCode;
+            tcp::socket l_TcpSocket(m_IOService);
+            int l_FileDescriptor = ::dup(m_UnixSocket.native_handle());
+            m_UnixSocket.close();
+            if (l_FileDescriptor >= 0) {
+                l_TcpSocket.assign(tcp::v4(), l_FileDescriptor, l_ErrorCode);
+                if (l_ErrorCode) {
+                    ::close(l_FileDescriptor);
+                    std::cerr << "Failed to accept a client on the unix domain socket: " << l_ErrorCode.message() << std::endl;
+                } else {
+                    StartHdlcdServerHandler(l_TcpSocket);
+                } // else
+            } // if
+        } // if
+
+        // Wait for subsequent connections of local clients
+        DoAcceptUnix();
+    }); // async_accept
+}
+#endif
@@ -24,14 +24,18 @@
 
 #include <memory>
 #include <list>
+#include <string>
+#include <mutex>
 #include <boost/asio.hpp>
+#include "SlowConsumerPolicy.h"
 class SerialPortHandlerCollection;
 class HdlcdServerHandler;
+class HdlcdSessionHeader;
 
 class HdlcdServerHandlerCollection: public std::enable_shared_from_this<HdlcdServerHandlerCollection> {
 public:
     // CTOR and resetter
-    HdlcdServerHandlerCollection(boost::asio::io_service& a_IOService, std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, uint16_t a_TcpPortNbr);
+    HdlcdServerHandlerCollection(boost::asio::io_service& a_IOService, std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, uint16_t a_TcpPortNbr, const std::string& a_UnixSocketPath, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth);
     void Shutdown();
     
     // Self-registering and -deregistering of HDLCd server handler objects
@@ -39,17 +43,46 @@ public:
     void DeregisterHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler);
 
 private:
+    // Sessions whose session header is received to select the event loop of their serial port
+    struct PendingSession {
+        PendingSession(boost::asio::io_service& a_IOService, boost::asio::ip::tcp::socket& a_TcpSocket): m_TcpSocket(std::move(a_TcpSocket)), m_Timer(a_IOService) {}
+        boost::asio::ip::tcp::socket m_TcpSocket;
+        boost::asio::deadline_timer m_Timer; //!< To close the session if the session header is not complete in time
+        unsigned char m_Buffer[3 + 255];     //!< The session header: version, SAP, length, and the serial port string
+    };
+    enum { session_header_timeout_s = 10 }; // Give up if the session header is not complete after this time
+    
     // Internal helpers
     void DoAccept();
+    void StartHdlcdServerHandler(boost::asio::ip::tcp::socket& a_TcpSocket);
+    void StartHdlcdServerHandler(boost::asio::io_service& a_IOService, boost::asio::ip::tcp::socket& a_TcpSocket, std::shared_ptr<HdlcdSessionHeader> a_HdlcdSessionHeader = nullptr);
+#if !defined(BOOST_ASIO_WINDOWS)
+    void ReadSessionHeader(std::shared_ptr<PendingSession> a_PendingSession);
+    void OnSessionHeader(std::shared_ptr<PendingSession> a_PendingSession);
+    void HandOverHdlcdServerHandler(boost::asio::io_service& a_IOService, boost::asio::ip::tcp::socket& a_TcpSocket, std::shared_ptr<HdlcdSessionHeader> a_HdlcdSessionHeader);
+#endif
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    void DoAcceptUnix();
+#endif
 
     // Members
     boost::asio::io_service& m_IOService;
     std::shared_ptr<SerialPortHandlerCollection> m_SerialPortHandlerCollection;
+    std::mutex m_Mutex; //!< The client handlers register and deregister themselves via all event loops
     std::list<std::shared_ptr<HdlcdServerHandler>> m_HdlcdServerHandlerList;
+    SlowConsumerPolicy m_SlowConsumerPolicy; //!< Limits of the send queues of each client
+    size_t m_PrefetchDepth; //!< The number of incoming data packets read ahead for each client
     
     // Accept incoming TCP connections
     boost::asio::ip::tcp::tcp::acceptor m_TcpAcceptor; //!< The TCP listener
     boost::asio::ip::tcp::tcp::socket   m_TcpSocket; //!< One incoming TCP socket
+    
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    // Accept incoming connections of local clients via a unix domain socket, optional
+    std::string m_UnixSocketPath; //!< The path of the unix domain socket, empty if not used
+    std::unique_ptr<boost::asio::local::stream_protocol::acceptor> m_UnixAcceptor; //!< The unix domain socket listener
+    boost::asio::local::stream_protocol::socket m_UnixSocket; //!< One incoming unix domain socket
+#endif
 };
 
 #endif // HDLCD_SERVER_HANDLER_COLLECTION_H
@@ -0,0 +1,291 @@
+/**
+ * \file      HdlcdServerMultiplexer.cpp
+ * \brief     This file contains the implementation of class HdlcdServerMultiplexer
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HdlcdServerMultiplexer.h"
+#include "HdlcdServerHandler.h"
+#include "HdlcdServerPacketEndpoint.h"
+#include "SerialPortHandlerCollection.h"
+#include "HdlcdPacketChannel.h"
+#include "HdlcdPacketCtrlExt.h"
+#include "HdlcdPacketData.h"
+#include "HdlcdPacketDataBatch.h"
+#include "HdlcdPacketCtrl.h"
+#include "FrameEndpoint.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <assert.h>
+
+HdlcdServerMultiplexer::HdlcdServerMultiplexer(boost::asio::io_service& a_IOService, std::shared_ptr<FrameEndpoint> a_FrameEndpoint, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection,
+                                               std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth):
+    m_IOService(a_IOService), m_FrameEndpoint(a_FrameEndpoint), m_HdlcdServerHandlerCollection(a_HdlcdServerHandlerCollection), m_SerialPortHandlerCollection(a_SerialPortHandlerCollection),
+    m_SlowConsumerPolicy(a_SlowConsumerPolicy), m_PrefetchDepth(a_PrefetchDepth) {
+    // Checks
+    assert(m_FrameEndpoint);
+    assert(m_SerialPortHandlerCollection);
+    m_bStopped = false;
+    m_bStalled = false;
+    m_StalledChannelId = 0;
+}
+
+void HdlcdServerMultiplexer::Start() {
+    // Only extended control packets and channel packets are exchanged on the TCP socket
+    m_FrameEndpoint->RegisterFrameFactory(0x30, []()->std::shared_ptr<Frame>{ return HdlcdPacketCtrlExt::CreateDeserializedPacket(); });
+    m_FrameEndpoint->RegisterFrameFactory(0x40, []()->std::shared_ptr<Frame>{ return HdlcdPacketChannel::CreateDeserializedPacket(); });
+    m_FrameEndpoint->SetOnFrameCallback([this](std::shared_ptr<Frame> a_Frame)->bool{ return OnFrame(a_Frame); });
+    m_FrameEndpoint->TriggerNextFrame();
+}
+
+void HdlcdServerMultiplexer::Stop() {
+    // Stop all channels. The TCP socket is closed by the owner of the frame endpoint.
+    if (m_bStopped) {
+        return;
+    } // if
+    
+    m_bStopped = true;
+    auto l_Channels = std::move(m_Channels);
+    m_Channels.clear();
+    for (auto l_ChannelIt = l_Channels.begin(); l_ChannelIt != l_Channels.end(); ++l_ChannelIt) {
+        auto l_HdlcdServerHandler = l_ChannelIt->second.m_HdlcdServerHandler;
+        if (l_ChannelIt->second.m_IOService) {
+            l_ChannelIt->second.m_IOService->post([l_HdlcdServerHandler]() { l_HdlcdServerHandler->Stop(); });
+        } else {
+            l_HdlcdServerHandler->Stop();
+        } // else
+    } // for
+    
+    m_SerialPortHandlerCollection.reset();
+}
+
+bool HdlcdServerMultiplexer::SendChannelPacket(unsigned char a_ChannelId, const Frame& a_Packet, std::function<void()> a_OnSendDoneCallback) {
+    if (m_bStopped) {
+        return false;
+    } // if
+    
+    return m_FrameEndpoint->SendFrame(HdlcdPacketChannel::CreatePacket(a_ChannelId, a_Packet), a_OnSendDoneCallback);
+}
+
+bool HdlcdServerMultiplexer::SendChannelPacket(unsigned char a_ChannelId, const std::vector<unsigned char>& a_Packet, std::function<void()> a_OnSendDoneCallback) {
+    // Packets of channels served by other event loops are serialized there
+    if (m_bStopped) {
+        return false;
+    } // if
+    
+    return m_FrameEndpoint->SendFrame(HdlcdPacketChannel::CreatePacket(a_ChannelId, a_Packet), a_OnSendDoneCallback);
+}
+
+void HdlcdServerMultiplexer::ResumeChannel(unsigned char a_ChannelId) {
+    // Only the channel that stalled the TCP socket may resume it
+    if ((m_bStalled) && (m_StalledChannelId == a_ChannelId)) {
+        m_bStalled = false;
+        m_FrameEndpoint->TriggerNextFrame();
+    } // if
+}
+
+void HdlcdServerMultiplexer::AcknowledgeChannelPackets(unsigned char a_ChannelId, size_t a_Packets) {
+    // Called by the packet endpoint of a channel served by another event loop, once it handed over forwarded packets
+    auto l_ChannelIt = m_Channels.find(a_ChannelId);
+    if (l_ChannelIt == m_Channels.end()) {
+        return;
+    } // if
+    
+    // The channel identifier may have been reused meanwhile, then late acknowledgements of the closed channel arrive
+    l_ChannelIt->second.m_PacketsInFlight -= std::min(l_ChannelIt->second.m_PacketsInFlight, a_Packets);
+    if (l_ChannelIt->second.m_PacketsInFlight < max_packets_in_flight) {
+        ResumeChannel(a_ChannelId);
+    } // if
+}
+
+void HdlcdServerMultiplexer::CloseChannel(unsigned char a_ChannelId) {
+    // Called by the packet endpoint of a channel that is closed
+    if (m_bStopped) {
+        return;
+    } // if
+    
+    m_Channels.erase(a_ChannelId);
+    ResumeChannel(a_ChannelId);
+    m_FrameEndpoint->SendFrame(HdlcdPacketCtrlExt::CreateChannelClose(a_ChannelId));
+}
+
+bool HdlcdServerMultiplexer::OnFrame(std::shared_ptr<Frame> a_Frame) {
+    // Checks
+    assert(a_Frame);
+    if (m_bStopped) {
+        return false;
+    } // if
+    
+    if (auto l_PacketChannel = std::dynamic_pointer_cast<HdlcdPacketChannel>(a_Frame)) {
+        // Packets of unknown channels are dropped, e.g., if they were sent before a channel close was received
+        auto l_ChannelIt = m_Channels.find(l_PacketChannel->GetChannelId());
+        if (l_ChannelIt == m_Channels.end()) {
+            return true;
+        } // if
+        
+        auto l_Packet = DeserializePacket(l_PacketChannel->GetPacket());
+        if (!l_Packet) {
+            std::cerr << "Invalid packet received on channel " << (int)l_PacketChannel->GetChannelId() << std::endl;
+            return true;
+        } // if
+        
+        // Keep the packet endpoint alive, the channel may be closed while the packet is processed
+        auto l_PacketEndpoint = l_ChannelIt->second.m_PacketEndpoint;
+        if (l_ChannelIt->second.m_IOService) {
+            // The channel is served by another event loop. Forward the packet, and continue with the next one. The TCP
+            // socket is only stalled if the packet endpoint does not acknowledge the forwarded packets anymore, i.e., if
+            // the channel does not accept further data packets.
+            auto l_HdlcdServerHandler = l_ChannelIt->second.m_HdlcdServerHandler;
+            l_ChannelIt->second.m_IOService->post([l_HdlcdServerHandler, l_PacketEndpoint, l_Packet]() {
+                l_PacketEndpoint->OnForwardedFrame(l_Packet);
+            });
+            
+            if ((++(l_ChannelIt->second.m_PacketsInFlight)) >= max_packets_in_flight) {
+                m_bStalled = true;
+                m_StalledChannelId = l_PacketChannel->GetChannelId();
+                return false;
+            } // if
+            
+            return true;
+        } // if
+        
+        if ((!l_PacketEndpoint->OnFrame(l_Packet)) && (m_Channels.find(l_PacketChannel->GetChannelId()) != m_Channels.end())) {
+            // Stall the TCP socket until this channel accepts further data packets
+            m_bStalled = true;
+            m_StalledChannelId = l_PacketChannel->GetChannelId();
+            return false;
+        } // if
+        
+        return true;
+    } // if
+    
+    if (auto l_PacketCtrlExt = std::dynamic_pointer_cast<HdlcdPacketCtrlExt>(a_Frame)) {
+        switch (l_PacketCtrlExt->GetPacketType()) {
+        case HdlcdPacketCtrlExt::CTRL_EXT_TYPE_CHANNEL_OPEN: {
+            OpenChannel(l_PacketCtrlExt->GetValue());
+            break;
+        }
+        case HdlcdPacketCtrlExt::CTRL_EXT_TYPE_CHANNEL_CLOSE: {
+            // The channel is closed and the closure is confirmed via its packet endpoint
+            if (l_PacketCtrlExt->GetValue().size() == 1) {
+                auto l_ChannelIt = m_Channels.find(l_PacketCtrlExt->GetValue()[0]);
+                if (l_ChannelIt != m_Channels.end()) {
+                    auto l_HdlcdServerHandler = l_ChannelIt->second.m_HdlcdServerHandler;
+                    if (l_ChannelIt->second.m_IOService) {
+                        l_ChannelIt->second.m_IOService->post([l_HdlcdServerHandler]() { l_HdlcdServerHandler->Stop(); });
+                    } else {
+                        l_HdlcdServerHandler->Stop();
+                    } // else
+                } // if
+            } // if
+            
+            break;
+        }
+        default:
+            // Skip extended control packets of other types
+            break;
+        } // switch
+    } // if
+    
+    return true;
+}
+
+void HdlcdServerMultiplexer::OpenChannel(const std::vector<unsigned char>& a_Value) {
+    // The channel identifier (1 byte), the SAP (1 byte), the length of the serial port string (1 byte), the serial port
+    // string, followed by the session options, if any
+    if ((a_Value.size() < 3) || (a_Value.size() < (3 + (size_t)a_Value[2]))) {
+        std::cerr << "Malformed channel open request ignored" << std::endl;
+        return;
+    } // if
+    
+    unsigned char l_ChannelId = a_Value[0];
+    if (m_Channels.find(l_ChannelId) != m_Channels.end()) {
+        std::cerr << "Channel open request for channel " << (int)l_ChannelId << " ignored, it is already open" << std::endl;
+        return;
+    } // if
+    
+    unsigned char l_SAP = a_Value[1];
+    std::string l_SerialPortName(a_Value.begin() + 3, a_Value.begin() + 3 + a_Value[2]);
+    std::vector<unsigned char> l_SessionOptions(a_Value.begin() + 3 + a_Value[2], a_Value.end());
+    
+    // Create the channel on the event loop of its serial port. If it is rejected, it is closed immediately, confirmed by
+    // a channel close indication.
+    auto& l_IOService = m_SerialPortHandlerCollection->GetIOService(l_SerialPortName);
+    Channel l_Channel;
+    l_Channel.m_IOService = ((&l_IOService != &m_IOService) ? &l_IOService : NULL);
+    l_Channel.m_PacketsInFlight = 0;
+    l_Channel.m_PacketEndpoint = std::make_shared<HdlcdServerPacketEndpoint>(shared_from_this(), l_ChannelId, m_IOService, l_IOService);
+    l_Channel.m_HdlcdServerHandler = std::make_shared<HdlcdServerHandler>(l_IOService, m_HdlcdServerHandlerCollection, l_Channel.m_PacketEndpoint, m_SlowConsumerPolicy, m_PrefetchDepth);
+    auto l_HdlcdServerHandler = l_Channel.m_HdlcdServerHandler;
+    bool l_bRemoteChannel = (l_Channel.m_IOService != NULL);
+    m_Channels[l_ChannelId] = std::move(l_Channel);
+    if (l_bRemoteChannel) {
+        auto l_SerialPortHandlerCollection = m_SerialPortHandlerCollection;
+        l_IOService.post([l_HdlcdServerHandler, l_SerialPortHandlerCollection, l_SAP, l_SerialPortName, l_SessionOptions]() {
+            l_HdlcdServerHandler->StartChannel(l_SerialPortHandlerCollection, l_SAP, l_SerialPortName, l_SessionOptions);
+        });
+    } else {
+        l_HdlcdServerHandler->StartChannel(m_SerialPortHandlerCollection, l_SAP, l_SerialPortName, l_SessionOptions);
+    } // else
+}
+
+std::shared_ptr<Frame> HdlcdServerMultiplexer::DeserializePacket(const std::vector<unsigned char>& a_Packet) const {
+    // Packets of a channel: data packets, control packets, batched data packets, and extended control packets
+    std::shared_ptr<Frame> l_Packet;
+    switch (a_Packet[0] & 0xF0) {
+    case 0x00: {
+        l_Packet = HdlcdPacketData::CreateDeserializedPacket();
+        break;
+    }
+    case 0x10: {
+        l_Packet = HdlcdPacketCtrl::CreateDeserializedPacket();
+        break;
+    }
+    case 0x20: {
+        l_Packet = HdlcdPacketDataBatch::CreateDeserializedPacket();
+        break;
+    }
+    case 0x30: {
+        l_Packet = HdlcdPacketCtrlExt::CreateDeserializedPacket();
+        break;
+    }
+    default:
+        return nullptr;
+    } // switch
+    
+    // The encapsulated packet must be complete without any trailing bytes
+    size_t l_Offset = 0;
+    while ((l_Packet->BytesNeeded()) && (l_Offset < a_Packet.size())) {
+        size_t l_Bytes = l_Packet->AddReceivedBytes(&a_Packet[l_Offset], (a_Packet.size() - l_Offset));
+        if (l_Bytes == 0) {
+            return nullptr;
+        } // if
+        
+        l_Offset += l_Bytes;
+    } // while
+    
+    if ((l_Packet->BytesNeeded()) || (l_Offset != a_Packet.size())) {
+        return nullptr;
+    } // if
+    
+    return l_Packet;
+}
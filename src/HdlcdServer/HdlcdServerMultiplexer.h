@@ -0,0 +1,94 @@
+/**
+ * \file      HdlcdServerMultiplexer.h
+ * \brief     This file contains the header declaration of class HdlcdServerMultiplexer
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HDLCD_SERVER_MULTIPLEXER_H
+#define HDLCD_SERVER_MULTIPLEXER_H
+
+#include <memory>
+#include <map>
+#include <vector>
+#include <functional>
+#include <boost/asio.hpp>
+#include "SlowConsumerPolicy.h"
+class Frame;
+class FrameEndpoint;
+class HdlcdServerHandler;
+class HdlcdServerHandlerCollection;
+class HdlcdServerPacketEndpoint;
+class SerialPortHandlerCollection;
+
+/*! \class HdlcdServerMultiplexer
+ *  \brief Class HdlcdServerMultiplexer
+ * 
+ *  Serves a multiplexed session (session type 0x6*): a single TCP socket carries many channels, each being a session of
+ *  its own with an own serial port and service access point specifier. Each channel is represented by a dedicated
+ *  HdlcdServerHandler object whose packet endpoint sends and receives channel packets via this multiplexer.
+ */
+class HdlcdServerMultiplexer: public std::enable_shared_from_this<HdlcdServerMultiplexer> {
+public:
+    HdlcdServerMultiplexer(boost::asio::io_service& a_IOService, std::shared_ptr<FrameEndpoint> a_FrameEndpoint, std::weak_ptr<HdlcdServerHandlerCollection> a_HdlcdServerHandlerCollection,
+                           std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, const SlowConsumerPolicy& a_SlowConsumerPolicy, size_t a_PrefetchDepth);
+    
+    void Start();
+    void Stop();
+    
+    // Called by the packet endpoints of the channels
+    bool SendChannelPacket(unsigned char a_ChannelId, const Frame& a_Packet, std::function<void()> a_OnSendDoneCallback);
+    bool SendChannelPacket(unsigned char a_ChannelId, const std::vector<unsigned char>& a_Packet, std::function<void()> a_OnSendDoneCallback);
+    void ResumeChannel(unsigned char a_ChannelId);
+    void AcknowledgeChannelPackets(unsigned char a_ChannelId, size_t a_Packets);
+    void CloseChannel(unsigned char a_ChannelId);
+    
+private:
+    // Internal helpers
+    bool OnFrame(std::shared_ptr<Frame> a_Frame);
+    void OpenChannel(const std::vector<unsigned char>& a_Value);
+    std::shared_ptr<Frame> DeserializePacket(const std::vector<unsigned char>& a_Packet) const;
+    
+    // Members
+    boost::asio::io_service& m_IOService;
+    std::shared_ptr<FrameEndpoint> m_FrameEndpoint;
+    std::weak_ptr<HdlcdServerHandlerCollection> m_HdlcdServerHandlerCollection;
+    std::shared_ptr<SerialPortHandlerCollection> m_SerialPortHandlerCollection;
+    SlowConsumerPolicy m_SlowConsumerPolicy;
+    size_t m_PrefetchDepth;
+    bool m_bStopped;
+    
+    // The open channels. Each channel is served by the event loop of its serial port, which may differ from the one
+    // of the multiplexer. In this case, all calls between the multiplexer and the channel are posted.
+    typedef struct {
+        std::shared_ptr<HdlcdServerHandler> m_HdlcdServerHandler;
+        std::shared_ptr<HdlcdServerPacketEndpoint> m_PacketEndpoint;
+        boost::asio::io_service* m_IOService; // The event loop of the channel, NULL if it is the one of the multiplexer
+        size_t m_PacketsInFlight;             // The packets forwarded to another event loop, but not acknowledged yet
+    } Channel;
+    std::map<unsigned char, Channel> m_Channels;
+    
+    // The TCP socket is stalled as long as one channel does not accept further data packets. Packets of channels served
+    // by other event loops are forwarded without waiting, until too many of them are unacknowledged.
+    enum { max_packets_in_flight = 32 };
+    bool m_bStalled;
+    unsigned char m_StalledChannelId;
+};
+
+#endif // HDLCD_SERVER_MULTIPLEXER_H
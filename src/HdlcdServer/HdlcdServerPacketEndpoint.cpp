@@ -0,0 +1,207 @@
+/**
+ * \file      HdlcdServerPacketEndpoint.cpp
+ * \brief     This file contains the implementation of class HdlcdServerPacketEndpoint
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HdlcdServerPacketEndpoint.h"
+#include "HdlcdServerMultiplexer.h"
+#include "FrameEndpoint.h"
+#include "HdlcdPacketData.h"
+#include "HdlcdPacketDataBatch.h"
+#include "HdlcdPacketCtrl.h"
+#include "HdlcdPacketCtrlExt.h"
+#include <assert.h>
+
+HdlcdServerPacketEndpoint::HdlcdServerPacketEndpoint(std::shared_ptr<FrameEndpoint> a_FrameEndpoint): m_FrameEndpoint(a_FrameEndpoint) {
+    // Checks
+    assert(m_FrameEndpoint);
+    m_ChannelId = 0;
+    m_MultiplexerIOService = NULL;
+    m_IOService = NULL;
+    m_PendingPayloadIndex = 0;
+    m_bStalled = false;
+    
+    // All kinds of packets of the access protocol that a client may send after the session header
+    m_FrameEndpoint->RegisterFrameFactory(0x00, []()->std::shared_ptr<Frame>{ return HdlcdPacketData::CreateDeserializedPacket(); });
+    m_FrameEndpoint->RegisterFrameFactory(0x10, []()->std::shared_ptr<Frame>{ return HdlcdPacketCtrl::CreateDeserializedPacket(); });
+    m_FrameEndpoint->RegisterFrameFactory(0x20, []()->std::shared_ptr<Frame>{ return HdlcdPacketDataBatch::CreateDeserializedPacket(); });
+    m_FrameEndpoint->RegisterFrameFactory(0x30, []()->std::shared_ptr<Frame>{ return HdlcdPacketCtrlExt::CreateDeserializedPacket(); });
+    m_FrameEndpoint->SetOnFrameCallback([this](std::shared_ptr<Frame> a_Frame)->bool{ return OnFrame(a_Frame); });
+}
+
+HdlcdServerPacketEndpoint::HdlcdServerPacketEndpoint(std::weak_ptr<HdlcdServerMultiplexer> a_HdlcdServerMultiplexer, unsigned char a_ChannelId, boost::asio::io_service& a_MultiplexerIOService, boost::asio::io_service& a_IOService):
+    m_HdlcdServerMultiplexer(a_HdlcdServerMultiplexer), m_ChannelId(a_ChannelId) {
+    // The multiplexer receives the channel packets and calls OnFrame() with the encapsulated packets
+    m_MultiplexerIOService = ((&a_MultiplexerIOService != &a_IOService) ? &a_MultiplexerIOService : NULL);
+    m_IOService = &a_IOService;
+    m_PendingPayloadIndex = 0;
+    m_bStalled = false;
+}
+
+void HdlcdServerPacketEndpoint::SetOnClosedCallback(std::function<void()> a_OnClosedCallback) {
+    // The channels of a multiplexed session are closed by the multiplexer
+    if (m_FrameEndpoint) {
+        m_FrameEndpoint->SetOnClosedCallback(a_OnClosedCallback);
+    } // if
+}
+
+void HdlcdServerPacketEndpoint::Start() {
+    // The frame endpoint was stalled after the session header. The multiplexer is always receiving.
+    if (m_FrameEndpoint) {
+        m_FrameEndpoint->TriggerNextFrame();
+    } // if
+}
+
+void HdlcdServerPacketEndpoint::Close() {
+    // Drop the remaining payloads of a pending batch, and all forwarded packets
+    m_PendingBatch.reset();
+    m_ForwardedFrames.clear();
+    if (m_FrameEndpoint) {
+        m_FrameEndpoint->Shutdown();
+        m_FrameEndpoint->Close();
+    } else if (m_MultiplexerIOService) {
+        auto l_HdlcdServerMultiplexer = m_HdlcdServerMultiplexer;
+        auto l_ChannelId = m_ChannelId;
+        m_MultiplexerIOService->post([l_HdlcdServerMultiplexer, l_ChannelId]() {
+            if (auto lock = l_HdlcdServerMultiplexer.lock()) {
+                lock->CloseChannel(l_ChannelId);
+            } // if
+        });
+    } else if (auto lock = m_HdlcdServerMultiplexer.lock()) {
+        lock->CloseChannel(m_ChannelId);
+    } // else if
+}
+
+bool HdlcdServerPacketEndpoint::Send(const Frame& a_Frame, std::function<void()> a_OnSendDoneCallback) {
+    if (m_FrameEndpoint) {
+        return m_FrameEndpoint->SendFrame(a_Frame, a_OnSendDoneCallback);
+    } else if (m_MultiplexerIOService) {
+        // Serialize the packet here, and return the callback to the event loop of this channel
+        auto l_HdlcdServerMultiplexer = m_HdlcdServerMultiplexer;
+        auto l_ChannelId = m_ChannelId;
+        auto l_Packet = a_Frame.Serialize();
+        std::function<void()> l_OnSendDoneCallback;
+        if (a_OnSendDoneCallback) {
+            auto l_IOService = m_IOService;
+            l_OnSendDoneCallback = [l_IOService, a_OnSendDoneCallback]() { l_IOService->post(a_OnSendDoneCallback); };
+        } // if
+        
+        m_MultiplexerIOService->post([l_HdlcdServerMultiplexer, l_ChannelId, l_Packet, l_OnSendDoneCallback]() {
+            if (auto lock = l_HdlcdServerMultiplexer.lock()) {
+                lock->SendChannelPacket(l_ChannelId, l_Packet, l_OnSendDoneCallback);
+            } // if
+        });
+        
+        return true;
+    } else if (auto lock = m_HdlcdServerMultiplexer.lock()) {
+        return lock->SendChannelPacket(m_ChannelId, a_Frame, a_OnSendDoneCallback);
+    } // else if
+    
+    return false;
+}
+
+void HdlcdServerPacketEndpoint::TriggerNextDataPacket() {
+    // Continue with the remaining payloads of a batch first
+    if (DeliverPendingPayloads()) {
+        if (m_FrameEndpoint) {
+            m_FrameEndpoint->TriggerNextFrame();
+        } else if (m_MultiplexerIOService) {
+            // The multiplexer is not stalled by this channel, continue with the packets that were forwarded meanwhile
+            m_bStalled = false;
+            DeliverForwardedFrames();
+        } else if (auto lock = m_HdlcdServerMultiplexer.lock()) {
+            lock->ResumeChannel(m_ChannelId);
+        } // else if
+    } // if
+}
+
+bool HdlcdServerPacketEndpoint::OnFrame(std::shared_ptr<Frame> a_Frame) {
+    // Checks
+    assert(a_Frame);
+    assert(!m_PendingBatch);
+    if (auto l_PacketData = std::dynamic_pointer_cast<HdlcdPacketData>(a_Frame)) {
+        return m_OnDataCallback(l_PacketData);
+    } // if
+    
+    if (auto l_PacketDataBatch = std::dynamic_pointer_cast<HdlcdPacketDataBatch>(a_Frame)) {
+        m_PendingBatch = l_PacketDataBatch;
+        m_PendingPayloadIndex = 0;
+        return DeliverPendingPayloads();
+    } // if
+    
+    if (auto l_PacketCtrl = std::dynamic_pointer_cast<HdlcdPacketCtrl>(a_Frame)) {
+        m_OnCtrlCallback(*l_PacketCtrl);
+        return true;
+    } // if
+    
+    // Extended control packets are not expected after the session options. Skip them.
+    return true;
+}
+
+void HdlcdServerPacketEndpoint::OnForwardedFrame(std::shared_ptr<Frame> a_Frame) {
+    // Packets forwarded meanwhile are kept until the receiver accepts further data packets
+    m_ForwardedFrames.emplace_back(std::move(a_Frame));
+    if (!m_bStalled) {
+        DeliverForwardedFrames();
+    } // if
+}
+
+void HdlcdServerPacketEndpoint::DeliverForwardedFrames() {
+    // Hand over the forwarded packets until the receiver is stalled. The multiplexer forwards further packets of this
+    // channel as long as not too many of them are unacknowledged.
+    assert(m_MultiplexerIOService);
+    size_t l_DeliveredFrames = 0;
+    while ((!m_bStalled) && (!m_ForwardedFrames.empty())) {
+        auto l_Frame = std::move(m_ForwardedFrames.front());
+        m_ForwardedFrames.pop_front();
+        ++l_DeliveredFrames;
+        if (!OnFrame(l_Frame)) {
+            m_bStalled = true;
+        } // if
+    } // while
+    
+    if (l_DeliveredFrames) {
+        auto l_HdlcdServerMultiplexer = m_HdlcdServerMultiplexer;
+        auto l_ChannelId = m_ChannelId;
+        m_MultiplexerIOService->post([l_HdlcdServerMultiplexer, l_ChannelId, l_DeliveredFrames]() {
+            if (auto lock = l_HdlcdServerMultiplexer.lock()) {
+                lock->AcknowledgeChannelPackets(l_ChannelId, l_DeliveredFrames);
+            } // if
+        });
+    } // if
+}
+
+bool HdlcdServerPacketEndpoint::DeliverPendingPayloads() {
+    // Hand over the payloads one by one, until the receiver is stalled. Returns true if the batch was consumed.
+    while (m_PendingBatch) {
+        const auto& l_Payloads = m_PendingBatch->GetPayloads();
+        auto l_PacketData = std::make_shared<HdlcdPacketData>(HdlcdPacketData::CreatePacket(l_Payloads[m_PendingPayloadIndex], m_PendingBatch->GetReliable()));
+        if (++m_PendingPayloadIndex == l_Payloads.size()) {
+            m_PendingBatch.reset();
+        } // if
+        
+        if (!m_OnDataCallback(l_PacketData)) {
+            return false;
+        } // if
+    } // while
+    
+    return true;
+}
@@ -0,0 +1,93 @@
+/**
+ * \file      HdlcdServerPacketEndpoint.h
+ * \brief     This file contains the header declaration of class HdlcdServerPacketEndpoint
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HDLCD_SERVER_PACKET_ENDPOINT_H
+#define HDLCD_SERVER_PACKET_ENDPOINT_H
+
+#include <memory>
+#include <deque>
+#include <functional>
+#include <boost/asio.hpp>
+class Frame;
+class FrameEndpoint;
+class HdlcdPacketData;
+class HdlcdPacketDataBatch;
+class HdlcdPacketCtrl;
+class HdlcdServerMultiplexer;
+
+/*! \class HdlcdServerPacketEndpoint
+ *  \brief Class HdlcdServerPacketEndpoint
+ * 
+ *  The daemon-side counterpart of the HdlcdPacketEndpoint. In addition to data packets and control packets, it accepts
+ *  batched data packets (content 0x2*) and hands their payloads over one by one as if they were single data packets.
+ *  If the receiver is stalled while a batch is processed, the remaining payloads are kept until it is triggered again.
+ *  The endpoint either exclusively uses a frame endpoint, or it represents one channel of a multiplexed session.
+ *  A channel may be served by another event loop than its multiplexer, then all calls to the multiplexer are posted.
+ *  The multiplexer forwards the packets of such a channel without waiting for them being processed. They are kept
+ *  by the channel while its receiver is stalled, and acknowledged to the multiplexer once they were handed over.
+ */
+class HdlcdServerPacketEndpoint {
+public:
+    HdlcdServerPacketEndpoint(std::shared_ptr<FrameEndpoint> a_FrameEndpoint);
+    HdlcdServerPacketEndpoint(std::weak_ptr<HdlcdServerMultiplexer> a_HdlcdServerMultiplexer, unsigned char a_ChannelId, boost::asio::io_service& a_MultiplexerIOService, boost::asio::io_service& a_IOService);
+    
+    // Callbacks
+    void SetOnDataCallback(std::function<bool(std::shared_ptr<const HdlcdPacketData>)> a_OnDataCallback) { m_OnDataCallback = a_OnDataCallback; }
+    void SetOnCtrlCallback(std::function<void(const HdlcdPacketCtrl&)> a_OnCtrlCallback) { m_OnCtrlCallback = a_OnCtrlCallback; }
+    void SetOnClosedCallback(std::function<void()> a_OnClosedCallback);
+    
+    void Start();
+    void Close();
+    bool Send(const Frame& a_Frame, std::function<void()> a_OnSendDoneCallback = nullptr);
+    void TriggerNextDataPacket();
+    
+    // Called by the frame endpoint or by the multiplexer
+    bool OnFrame(std::shared_ptr<Frame> a_Frame);
+    
+    // Called by the multiplexer if this channel is served by another event loop
+    void OnForwardedFrame(std::shared_ptr<Frame> a_Frame);
+    
+private:
+    // Internal helpers
+    bool DeliverPendingPayloads();
+    void DeliverForwardedFrames();
+    
+    // Members
+    std::shared_ptr<FrameEndpoint> m_FrameEndpoint;
+    std::weak_ptr<HdlcdServerMultiplexer> m_HdlcdServerMultiplexer;
+    unsigned char m_ChannelId;
+    boost::asio::io_service* m_MultiplexerIOService; //!< The event loop of the multiplexer, NULL if it is the same as of this channel
+    boost::asio::io_service* m_IOService;            //!< The event loop of this channel
+    std::function<bool(std::shared_ptr<const HdlcdPacketData>)> m_OnDataCallback;
+    std::function<void(const HdlcdPacketCtrl&)> m_OnCtrlCallback;
+    
+    // The batch of data packets whose payloads are currently handed over
+    std::shared_ptr<const HdlcdPacketDataBatch> m_PendingBatch;
+    size_t m_PendingPayloadIndex;
+    
+    // The packets forwarded by a multiplexer of another event loop that were not handed over yet
+    std::deque<std::shared_ptr<Frame>> m_ForwardedFrames;
+    bool m_bStalled;
+};
+
+#endif // HDLCD_SERVER_PACKET_ENDPOINT_H
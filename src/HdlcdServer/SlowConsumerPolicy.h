@@ -0,0 +1,139 @@
+/**
+ * \file      SlowConsumerPolicy.h
+ * \brief     This file contains the header declaration of class SlowConsumerPolicy
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SLOW_CONSUMER_POLICY_H
+#define SLOW_CONSUMER_POLICY_H
+
+#include <cstddef>
+#include <string>
+#include "BufferType.h"
+
+/*! \class SlowConsumerPolicy
+ *  \brief Class SlowConsumerPolicy
+ * 
+ *  This class specifies how many data packets may be queued for each client, and what happens if a client does not read fast enough.
+ *  Payload sessions have an own action, as their clients usually forward each payload and must not lose any of them unnoticed.
+ */
+class SlowConsumerPolicy {
+public:
+    /*! \enum E_ACTION
+     *  \brief Enum E_ACTION
+     * 
+     *  This enum names the actions that are taken if a data packet does not fit into the send queue of a client
+     */
+    typedef enum {
+        ACTION_DROP_OLDEST = 0, //!< Drop the oldest queued data packets to make room for the new one. All drops are reported via gap indications.
+        ACTION_DROP_NEWEST = 1, //!< Drop the new data packet
+        ACTION_SAMPLE      = 2, //!< Keep only one of N new data packets, dropping the oldest queued ones to make room
+        ACTION_DISCONNECT  = 3  //!< Close the session of the client
+    } E_ACTION;
+
+    /*! \brief The constructor of SlowConsumerPolicy objects
+     * 
+     *  On creation, the send queues are unlimited
+     */
+    SlowConsumerPolicy(): m_eAction(ACTION_DROP_OLDEST), m_ePayloadAction(ACTION_DISCONNECT), m_MaxQueuedPackets(0), m_MaxQueuedBytes(0), m_SampleRate(10) {}
+    
+    /*! \brief Select the action by its name
+     * 
+     *  Select the action for all sessions except payload sessions by its name as provided via the command line
+     * 
+     *  \param  a_Action the name of the action: "drop-oldest", "drop-newest", "sample", or "disconnect"
+     *  \return bool indicates whether the name was valid
+     */
+    bool SetAction(const std::string &a_Action) { return ParseAction(a_Action, m_eAction); }
+    
+    /*! \brief Select the action for payload sessions by its name
+     * 
+     *  Select the action for payload sessions by its name as provided via the command line
+     * 
+     *  \param  a_Action the name of the action: "drop-oldest", "drop-newest", "sample", or "disconnect"
+     *  \return bool indicates whether the name was valid
+     */
+    bool SetPayloadAction(const std::string &a_Action) { return ParseAction(a_Action, m_ePayloadAction); }
+    
+    /*! \brief Specify the limits of each send queue
+     * 
+     *  Specify the limits of each send queue. A value of 0 disables the respective limit.
+     * 
+     *  \param a_MaxQueuedPackets the maximum number of queued data packets
+     *  \param a_MaxQueuedBytes the maximum number of bytes of all queued data packets
+     */
+    void SetLimits(size_t a_MaxQueuedPackets, size_t a_MaxQueuedBytes) {
+        m_MaxQueuedPackets = a_MaxQueuedPackets;
+        m_MaxQueuedBytes   = a_MaxQueuedBytes;
+    }
+    
+    /*! \brief Specify the sample rate
+     * 
+     *  Specify the sample rate that is applied if the action ACTION_SAMPLE is selected
+     * 
+     *  \param a_SampleRate one of a_SampleRate data packets is kept if the send queue is full
+     */
+    void SetSampleRate(unsigned int a_SampleRate) { m_SampleRate = (a_SampleRate ? a_SampleRate : 1); }
+
+    /*! \brief Check whether a subsequent data packet fits into a send queue
+     * 
+     *  Check whether a subsequent data packet fits into a send queue
+     * 
+     *  \param  a_QueuedPackets the number of data packets that are already queued
+     *  \param  a_QueuedBytes the number of bytes that are already queued
+     *  \param  a_PacketSize the size of the subsequent data packet in bytes
+     *  \return bool indicates whether the subsequent data packet would exceed a limit
+     */
+    bool ExceedsLimits(size_t a_QueuedPackets, size_t a_QueuedBytes, size_t a_PacketSize) const {
+        return (((m_MaxQueuedPackets) && ((a_QueuedPackets + 1) > m_MaxQueuedPackets)) ||
+                ((m_MaxQueuedBytes)   && ((a_QueuedBytes + a_PacketSize) > m_MaxQueuedBytes)));
+    }
+    
+    // Query the configuration
+    E_ACTION GetAction(E_BUFFER_TYPE a_eBufferType) const { return ((a_eBufferType == BUFFER_TYPE_PAYLOAD) ? m_ePayloadAction : m_eAction); }
+    unsigned int GetSampleRate() const { return m_SampleRate; }
+
+private:
+    // Internal helpers
+    static bool ParseAction(const std::string &a_Action, E_ACTION &a_eAction) {
+        if (a_Action == "drop-oldest") {
+            a_eAction = ACTION_DROP_OLDEST;
+        } else if (a_Action == "drop-newest") {
+            a_eAction = ACTION_DROP_NEWEST;
+        } else if (a_Action == "sample") {
+            a_eAction = ACTION_SAMPLE;
+        } else if (a_Action == "disconnect") {
+            a_eAction = ACTION_DISCONNECT;
+        } else {
+            return false;
+        } // else
+        
+        return true;
+    }
+    
+    // Members
+    E_ACTION m_eAction;        //!< The action to be taken if a send queue is full
+    E_ACTION m_ePayloadAction; //!< The action to be taken if the send queue of a payload session is full
+    size_t m_MaxQueuedPackets; //!< The maximum number of queued data packets per client, 0 for no limit
+    size_t m_MaxQueuedBytes;   //!< The maximum number of queued bytes per client, 0 for no limit
+    unsigned int m_SampleRate; //!< One of m_SampleRate data packets is kept if the action ACTION_SAMPLE is selected
+};
+
+#endif // SLOW_CONSUMER_POLICY_H
@@ -0,0 +1,178 @@
+/**
+ * \file      SubscriptionFilter.cpp
+ * \brief     This file contains the implementation of class SubscriptionFilter
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SubscriptionFilter.h"
+#include <string.h>
+#include "HdlcFrame.h"
+
+/*! \brief The constructor of SubscriptionFilter objects
+ * 
+ *  On creation, the filter accepts all frames
+ */
+SubscriptionFilter::SubscriptionFilter() {
+    m_FrameTypes = 0xFFFFFFFF;
+    ::memset(m_Addresses, 0xFF, sizeof(m_Addresses));
+    m_Reliability = 0x03;
+    m_MinPayloadLength = 0;
+    m_MaxPayloadLength = 0xFFFF;
+}
+
+/*! \brief Compile a filter expression
+ * 
+ *  Compile a filter expression. It is a sequence of clauses, each consisting of a clause type, a length byte, and the value.
+ *  Clauses of the same type may be repeated, all of them must match.
+ * 
+ *  \param  a_Expression the filter expression
+ *  \return bool indicates whether the expression was valid
+ */
+bool SubscriptionFilter::Compile(const std::vector<unsigned char> &a_Expression) {
+    m_Expression = a_Expression;
+    size_t l_Offset = 0;
+    while (l_Offset < a_Expression.size()) {
+        if ((l_Offset + 2) > a_Expression.size()) {
+            return false;
+        } // if
+        
+        unsigned char l_Clause = a_Expression[l_Offset];
+        size_t l_Length = a_Expression[l_Offset + 1];
+        const unsigned char* l_Value = (a_Expression.data() + l_Offset + 2);
+        l_Offset += (2 + l_Length);
+        if (l_Offset > a_Expression.size()) {
+            return false;
+        } // if
+        
+        switch (l_Clause) {
+        case CLAUSE_FRAME_TYPES: {
+            if (l_Length != 4) {
+                return false;
+            } // if
+            
+            m_FrameTypes &= ((uint32_t(l_Value[0]) << 24) | (l_Value[1] << 16) | (l_Value[2] << 8) | l_Value[3]);
+            break;
+        }
+        case CLAUSE_ADDRESSES: {
+            uint64_t l_Addresses[4] = { 0, 0, 0, 0 };
+            for (size_t l_Index = 0; l_Index < l_Length; ++l_Index) {
+                l_Addresses[l_Value[l_Index] >> 6] |= (uint64_t(1) << (l_Value[l_Index] & 0x3F));
+            } // for
+            
+            for (size_t l_Index = 0; l_Index < 4; ++l_Index) {
+                m_Addresses[l_Index] &= l_Addresses[l_Index];
+            } // for
+            
+            break;
+        }
+        case CLAUSE_RELIABLE: {
+            if ((l_Length != 1) || (l_Value[0] > 1)) {
+                return false;
+            } // if
+            
+            m_Reliability &= (l_Value[0] ? 0x02 : 0x01);
+            break;
+        }
+        case CLAUSE_PAYLOAD_LENGTH: {
+            if (l_Length != 4) {
+                return false;
+            } // if
+            
+            size_t l_MinPayloadLength = ((l_Value[0] << 8) | l_Value[1]);
+            size_t l_MaxPayloadLength = ((l_Value[2] << 8) | l_Value[3]);
+            if (l_MinPayloadLength > m_MinPayloadLength) {
+                m_MinPayloadLength = l_MinPayloadLength;
+            } // if
+            
+            if (l_MaxPayloadLength < m_MaxPayloadLength) {
+                m_MaxPayloadLength = l_MaxPayloadLength;
+            } // if
+            
+            break;
+        }
+        case CLAUSE_PAYLOAD_BYTES: {
+            // Offset (2 bytes), followed by the pattern and the mask of identical size
+            if ((l_Length < 4) || (l_Length & 0x01)) {
+                return false;
+            } // if
+            
+            Pattern l_Pattern;
+            l_Pattern.m_Offset = ((l_Value[0] << 8) | l_Value[1]);
+            l_Pattern.m_Length = ((l_Length - 2) / 2);
+            l_Pattern.m_Index  = m_PatternValues.size();
+            m_Patterns.emplace_back(l_Pattern);
+            m_PatternValues.insert(m_PatternValues.end(), (l_Value + 2), (l_Value + 2 + l_Pattern.m_Length));
+            m_PatternMasks.insert (m_PatternMasks.end(),  (l_Value + 2 + l_Pattern.m_Length), (l_Value + l_Length));
+            for (size_t l_Index = 0; l_Index < l_Pattern.m_Length; ++l_Index) {
+                m_PatternValues[l_Pattern.m_Index + l_Index] &= m_PatternMasks[l_Pattern.m_Index + l_Index];
+            } // for
+            
+            break;
+        }
+        default:
+            // Unknown clause
+            return false;
+        } // switch
+    } // while
+    
+    return true;
+}
+
+/*! \brief Evaluate the filter
+ * 
+ *  Evaluate the filter for one HDLC frame
+ * 
+ *  \param  a_HdlcFrame the HDLC frame
+ *  \param  a_bReliable indicates whether the frame was transmitted reliably
+ *  \return bool indicates whether the frame has to be delivered
+ */
+bool SubscriptionFilter::Matches(const HdlcFrame& a_HdlcFrame, bool a_bReliable) const {
+    if ((m_FrameTypes & (uint32_t(1) << a_HdlcFrame.GetHDLCFrameType())) == 0) {
+        return false;
+    } // if
+    
+    unsigned char l_Address = a_HdlcFrame.GetAddress();
+    if ((m_Addresses[l_Address >> 6] & (uint64_t(1) << (l_Address & 0x3F))) == 0) {
+        return false;
+    } // if
+    
+    if ((m_Reliability & (a_bReliable ? 0x02 : 0x01)) == 0) {
+        return false;
+    } // if
+    
+    const std::vector<unsigned char>& l_Payload = a_HdlcFrame.GetPayload();
+    if ((l_Payload.size() < m_MinPayloadLength) || (l_Payload.size() > m_MaxPayloadLength)) {
+        return false;
+    } // if
+    
+    for (auto it = m_Patterns.begin(); it != m_Patterns.end(); ++it) {
+        if ((it->m_Offset + it->m_Length) > l_Payload.size()) {
+            return false;
+        } // if
+        
+        for (size_t l_Index = 0; l_Index < it->m_Length; ++l_Index) {
+            if ((l_Payload[it->m_Offset + l_Index] & m_PatternMasks[it->m_Index + l_Index]) != m_PatternValues[it->m_Index + l_Index]) {
+                return false;
+            } // if
+        } // for
+    } // for
+    
+    return true;
+}
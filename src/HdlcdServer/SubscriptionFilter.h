@@ -0,0 +1,87 @@
+/**
+ * \file      SubscriptionFilter.h
+ * \brief     This file contains the header declaration of class SubscriptionFilter
+ * \author    Florian Evers, florian-evers@gmx.de
+ * \copyright GNU Public License version 3.
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUBSCRIPTION_FILTER_H
+#define SUBSCRIPTION_FILTER_H
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+class HdlcFrame;
+
+/*! \class SubscriptionFilter
+ *  \brief Class SubscriptionFilter
+ * 
+ *  This class holds an optional filter of a client session. It is compiled once from the filter expression provided via the
+ *  session options, see doc/protocol.txt. All clauses of the expression must match to deliver a frame to the client.
+ *  Clients with identical filter expressions form a filter group that shares the result of each evaluation.
+ */
+class SubscriptionFilter {
+public:
+    /*! \enum E_CLAUSE
+     *  \brief Enum E_CLAUSE
+     * 
+     *  This enum names the clauses of a filter expression
+     */
+    typedef enum {
+        CLAUSE_FRAME_TYPES    = 0x01, //!< A bitmask of accepted frame types
+        CLAUSE_ADDRESSES      = 0x02, //!< A list of accepted HDLC addresses
+        CLAUSE_RELIABLE       = 0x03, //!< Accept only frames that were transmitted reliably or unreliably
+        CLAUSE_PAYLOAD_LENGTH = 0x04, //!< The accepted range of the payload length
+        CLAUSE_PAYLOAD_BYTES  = 0x05  //!< A masked byte pattern at a fixed offset of the payload
+    } E_CLAUSE;
+    
+    SubscriptionFilter();
+    bool Compile(const std::vector<unsigned char> &a_Expression);
+    bool Matches(const HdlcFrame& a_HdlcFrame, bool a_bReliable) const;
+    
+    /*! \brief Check whether two filters belong to the same filter group
+     * 
+     *  Check whether two filters belong to the same filter group, i.e., whether they were compiled from the same expression
+     * 
+     *  \param  a_Other the other filter
+     *  \return bool indicates whether both filters are equal
+     */
+    bool IsEqual(const SubscriptionFilter& a_Other) const { return (m_Expression == a_Other.m_Expression); }
+
+private:
+    // Members
+    std::vector<unsigned char> m_Expression; //!< The filter expression as provided by the client
+    uint32_t m_FrameTypes;                   //!< Bit n is set if frames of type n are accepted, see HdlcFrame::E_HDLC_FRAMETYPE
+    uint64_t m_Addresses[4];                 //!< Bitmap of the accepted HDLC addresses
+    unsigned char m_Reliability;             //!< Bit 0: unreliable frames are accepted, bit 1: reliable frames are accepted
+    size_t m_MinPayloadLength;
+    size_t m_MaxPayloadLength;
+    
+    // Byte patterns. Values and masks of all patterns are stored en bloc.
+    typedef struct {
+        size_t m_Offset;   //!< The offset within the payload
+        size_t m_Length;   //!< The length of the pattern
+        size_t m_Index;    //!< The index of the pattern within m_PatternValues and m_PatternMasks
+    } Pattern;
+    std::vector<Pattern> m_Patterns;
+    std::vector<unsigned char> m_PatternValues;
+    std::vector<unsigned char> m_PatternMasks;
+};
+
+#endif // SUBSCRIPTION_FILTER_H
@@ -42,9 +42,10 @@ typedef enum {
     BUFFER_TYPE_DISSECTED            =    1,
     BUFFER_TYPE_PAYLOAD              =    2,
     BUFFER_TYPE_PORT_STATUS          =    3,
+    BUFFER_TYPE_STRUCTURED           =    4,
     
     // Bookkeeping
-    BUFFER_TYPE_ARITHMETIC_ENDMARKER =    4,
+    BUFFER_TYPE_ARITHMETIC_ENDMARKER =    5,
     BUFFER_TYPE_UNSET                = 0xFF
 } E_BUFFER_TYPE;
 
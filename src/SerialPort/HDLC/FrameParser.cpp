@@ -35,30 +35,36 @@
  */
 
 #include "FrameParser.h"
-#include "ProtocolState.h"
+#include <assert.h>
+#include <string.h>
 #include "FCS16.h"
 
-FrameParser::FrameParser(ProtocolState& a_ProtocolState): m_ProtocolState(a_ProtocolState) {
+FrameParser::FrameParser() {
     Reset();
 }
 
 void FrameParser::Reset() {
-    // Prepare assembly buffer
+    ResetBuffer();
+    m_bStartTokenSeen = false;
+}
+
+void FrameParser::ResetBuffer() {
+    // Prepare assembly buffer. Its capacity is kept, thus, no allocation is required for subsequent frames.
     m_Buffer.clear();
-    m_Buffer.reserve(max_length);
+    m_Buffer.reserve(2 * max_length);
     m_Buffer.emplace_back(0x7E);
-    m_bStartTokenSeen = false;
 }
 
-void FrameParser::AddReceivedRawBytes(const unsigned char* a_Buffer, size_t a_Bytes) {
+void FrameParser::AddReceivedRawBytes(const unsigned char* a_Buffer, size_t a_Bytes, std::vector<DeserializedFrame> &a_DeserializedFrames) {
+    // All complete frames are appended to the provided container, allowing the caller to process them as a batch
     while (a_Bytes) {
-        size_t l_ConsumedBytes = AddChunk(a_Buffer, a_Bytes);
+        size_t l_ConsumedBytes = AddChunk(a_Buffer, a_Bytes, a_DeserializedFrames);
         a_Buffer += l_ConsumedBytes;
         a_Bytes  -= l_ConsumedBytes;
     } // while
 }
 
-size_t FrameParser::AddChunk(const unsigned char* a_Buffer, size_t a_Bytes) {
+size_t FrameParser::AddChunk(const unsigned char* a_Buffer, size_t a_Bytes, std::vector<DeserializedFrame> &a_DeserializedFrames) {
     if (m_bStartTokenSeen == false) {
         // No start token seen yet. Check if there is the start token available in the input buffer.
         const void* l_pStartTokenPtr = memchr((const void*)a_Buffer, 0x7E, a_Bytes);
@@ -85,13 +91,13 @@ size_t FrameParser::AddChunk(const unsigned char* a_Buffer, size_t a_Bytes) {
             if ((m_Buffer.size() + l_NbrOfBytes) <= (2 * max_length)) {
                 // We did not exceed the maximum frame size yet. Copy all bytes including the end token.
                 m_Buffer.insert(m_Buffer.end(), a_Buffer, a_Buffer + l_NbrOfBytes);
-                if (RemoveEscapeCharacters()) {
+                if (RemoveEscapeCharacters(a_DeserializedFrames)) {
                     // The complete frame was valid and was consumed.
                     m_bStartTokenSeen = false;
                 } // if
             } // else
 
-            m_Buffer.resize(1); // Already contains start token 0x7E
+            ResetBuffer(); // Contains start token 0x7E
             return (l_NbrOfBytes);
         } else {
             // No end token found. Copy all bytes if we do not exceed the maximum frame size.
@@ -109,7 +115,7 @@ size_t FrameParser::AddChunk(const unsigned char* a_Buffer, size_t a_Bytes) {
     } // else
 }
 
-bool FrameParser::RemoveEscapeCharacters() {
+bool FrameParser::RemoveEscapeCharacters(std::vector<DeserializedFrame> &a_DeserializedFrames) {
     // Checks
     assert(m_Buffer.front() == 0x7E);
     assert(m_Buffer.back()  == 0x7E);
@@ -126,30 +132,28 @@ bool FrameParser::RemoveEscapeCharacters() {
     if (m_Buffer[m_Buffer.size() - 2] == 0x7D) {
         l_bMessageInvalid = true;
     } else {
-        // Remove escape sequences
-        std::vector<unsigned char> l_UnescapedBuffer;
-        l_UnescapedBuffer.reserve(m_Buffer.size());
-        for (auto it = m_Buffer.begin(); it != m_Buffer.end(); ++it) {
-            if (*it == 0x7D) {
+        // Remove escape sequences in place, the unescaped frame is never longer than the escaped one
+        size_t l_WriteIndex = 0;
+        for (size_t l_ReadIndex = 0; l_ReadIndex < m_Buffer.size(); ++l_ReadIndex, ++l_WriteIndex) {
+            unsigned char l_Byte = m_Buffer[l_ReadIndex];
+            if (l_Byte == 0x7D) {
                 // This was the escape character
-                ++it;
-                if (*it == 0x5E) {
-                    l_UnescapedBuffer.emplace_back(0x7E);
-                } else if (*it == 0x5D) {
-                    l_UnescapedBuffer.emplace_back(0x7D);
+                l_Byte = m_Buffer[++l_ReadIndex];
+                if (l_Byte == 0x5E) {
+                    l_Byte = 0x7E;
+                } else if (l_Byte == 0x5D) {
+                    l_Byte = 0x7D;
                 } else {
                     // Invalid character. Go ahead with an invalid frame.
                     l_bMessageInvalid = true;
-                    l_UnescapedBuffer.emplace_back(*it);
                 } // else
-            } else {
-                // Normal non-escaped character, or one of the frame delimiters
-                l_UnescapedBuffer.emplace_back(*it);
-            } // else
-        } // while
+            } // if
+            
+            // Normal non-escaped character, or one of the frame delimiters
+            m_Buffer[l_WriteIndex] = l_Byte;
+        } // for
         
-        // Go ahead with the unescaped buffer
-        m_Buffer = std::move(l_UnescapedBuffer);
+        m_Buffer.resize(l_WriteIndex);
     } // if
     
     // We now have the unescaped frame at hand.
@@ -163,11 +167,16 @@ bool FrameParser::RemoveEscapeCharacters() {
         l_bMessageInvalid = (pppfcs16(PPPINITFCS16, (m_Buffer.data() + 1), (m_Buffer.size() - 2)) != PPPGOODFCS16);
     } // if
 
-    m_ProtocolState.InterpretDeserializedFrame(m_Buffer, DeserializeFrame(m_Buffer), l_bMessageInvalid);
+    // Collect the frame. Only the unescaped frame is copied, the assembly buffer keeps its capacity.
+    a_DeserializedFrames.emplace_back();
+    DeserializedFrame& l_DeserializedFrame = a_DeserializedFrames.back();
+    l_DeserializedFrame.m_HdlcFrame = DeserializeFrame(m_Buffer);
+    l_DeserializedFrame.m_bMessageInvalid = l_bMessageInvalid;
+    l_DeserializedFrame.m_UnescapedBuffer.assign(m_Buffer.begin(), m_Buffer.end());
     return (l_bMessageInvalid == false);
 }
 
-HdlcFrame FrameParser::DeserializeFrame(const std::vector<unsigned char> &a_UnescapedBuffer) const {
+HdlcFrame FrameParser::DeserializeFrame(const std::vector<unsigned char> &a_UnescapedBuffer) {
     // Parse byte buffer to get the HDLC frame
     HdlcFrame l_HdlcFrame;
     l_HdlcFrame.SetAddress(a_UnescapedBuffer[1]);
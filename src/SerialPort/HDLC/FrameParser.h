@@ -39,23 +39,28 @@
 
 #include <vector>
 #include "HdlcFrame.h"
-class ProtocolState;
+
+// One complete frame found by the parser, ready for interpretation
+struct DeserializedFrame {
+    std::vector<unsigned char> m_UnescapedBuffer; // The unescaped frame including both delimiters
+    HdlcFrame m_HdlcFrame;
+    bool m_bMessageInvalid;
+};
 
 class FrameParser {
 public:
-    FrameParser(ProtocolState& a_ProtocolState);
+    FrameParser();
     void Reset();
-    void AddReceivedRawBytes(const unsigned char* a_Buffer, size_t a_Bytes);
+    void AddReceivedRawBytes(const unsigned char* a_Buffer, size_t a_Bytes, std::vector<DeserializedFrame> &a_DeserializedFrames);
+    static HdlcFrame DeserializeFrame(const std::vector<unsigned char> &a_UnescapedBuffer);
     
 private:
     // Interal helpers
-    size_t AddChunk(const unsigned char* a_Buffer, size_t a_Bytes);
-    bool RemoveEscapeCharacters();
-    HdlcFrame DeserializeFrame(const std::vector<unsigned char> &a_UnescapedBuffer) const;
+    size_t AddChunk(const unsigned char* a_Buffer, size_t a_Bytes, std::vector<DeserializedFrame> &a_DeserializedFrames);
+    bool RemoveEscapeCharacters(std::vector<DeserializedFrame> &a_DeserializedFrames);
+    void ResetBuffer();
     
     // Members
-    ProtocolState& m_ProtocolState;
-
     enum { max_length = 1024 };
     std::vector<unsigned char> m_Buffer;
     bool m_bStartTokenSeen;
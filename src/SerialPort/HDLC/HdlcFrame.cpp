@@ -35,111 +35,135 @@
  */
 
 #include "HdlcFrame.h"
-#include <sstream>
-#include <iomanip> 
+#include <algorithm>
+
+namespace {
+    // Names of all frame types, indexed by E_HDLC_FRAMETYPE
+    const char* const g_FrameTypeNames[] = {
+        "",          // HDLC_FRAMETYPE_UNSET
+        "",          // HDLC_FRAMETYPE_I
+        "RR",        // HDLC_FRAMETYPE_S_RR
+        "RNR",       // HDLC_FRAMETYPE_S_RNR
+        "REJ",       // HDLC_FRAMETYPE_S_REJ
+        "SREJ",      // HDLC_FRAMETYPE_S_SREJ
+        "UI",        // HDLC_FRAMETYPE_U_UI
+        "SIM",       // HDLC_FRAMETYPE_U_SIM
+        "SARM",      // HDLC_FRAMETYPE_U_SARM
+        "UP",        // HDLC_FRAMETYPE_U_UP
+        "SABM",      // HDLC_FRAMETYPE_U_SABM
+        "DISC",      // HDLC_FRAMETYPE_U_DISC
+        "UA",        // HDLC_FRAMETYPE_U_UA
+        "SNRM",      // HDLC_FRAMETYPE_U_SNRM
+        "FRMR/CMDR", // HDLC_FRAMETYPE_U_CMDR
+        "TEST",      // HDLC_FRAMETYPE_U_TEST
+        "XID",       // HDLC_FRAMETYPE_U_XID
+    };
+    
+    const char g_HexDigits[] = "0123456789abcdef";
+    
+    void AppendString(std::vector<unsigned char> &a_Output, const char* a_String) {
+        while (*a_String) {
+            a_Output.push_back(*a_String++);
+        } // while
+    }
+    
+    void AppendDecimal(std::vector<unsigned char> &a_Output, size_t a_Value) {
+        unsigned char l_Digits[20];
+        size_t l_NbrDigits = 0;
+        do {
+            l_Digits[l_NbrDigits++] = ('0' + (a_Value % 10));
+            a_Value /= 10;
+        } while (a_Value);
+        
+        while (l_NbrDigits) {
+            a_Output.push_back(l_Digits[--l_NbrDigits]);
+        } // while
+    }
+    
+    void AppendHex(std::vector<unsigned char> &a_Output, unsigned char a_Value) {
+        // Without leading zero, as printed by std::hex
+        if (a_Value >= 0x10) {
+            a_Output.push_back(g_HexDigits[a_Value >> 4]);
+        } // if
+        
+        a_Output.push_back(g_HexDigits[a_Value & 0x0F]);
+    }
+} // namespace
 
 const std::vector<unsigned char> HdlcFrame::Dissect() const {
-    bool l_bHasPayload = false;
-    std::stringstream l_Output;
+    std::vector<unsigned char> l_DissectedFrame;
+    Dissect(l_DissectedFrame, true);
+    return l_DissectedFrame;
+}
+
+void HdlcFrame::Dissect(std::vector<unsigned char> &a_Output, bool a_bWithPayloadHexDump) const {
+    a_Output.clear();
+    if (!(IsIFrame() || IsSFrame() || IsUFrame())) {
+        AppendString(a_Output, "Unparseable HDLC frame");
+        return;
+    } // if
+    
+    AppendString(a_Output, "HDLC frame, Addr=0x");
+    AppendHex(a_Output, GetAddress());
     if (IsIFrame()) {
-        l_bHasPayload = true;
-        l_Output << "HDLC frame, Addr=0x" << std::hex << (int)GetAddress() << std::dec << ", ";
-        l_Output << "I-Frame, PF=" << IsPF() << ", SSeq=" << (int)GetSSeq() << ", RSeq=" << (int)GetRSeq();
+        AppendString(a_Output, ", I-Frame, PF=");
+        a_Output.push_back(IsPF() ? '1' : '0');
+        AppendString(a_Output, ", SSeq=");
+        AppendDecimal(a_Output, GetSSeq());
+        AppendString(a_Output, ", RSeq=");
+        AppendDecimal(a_Output, GetRSeq());
     } else if (IsSFrame()) {
-        l_Output << "HDLC frame, Addr=0x" << std::hex << (int)GetAddress() << std::dec << ", S-Frame: ";
-        switch (GetHDLCFrameType()) {
-            case HdlcFrame::HDLC_FRAMETYPE_S_RR: {
-                l_Output << "RR";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_S_RNR: {
-                l_Output << "RNR";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_S_REJ: {
-                l_Output << "REJ";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_S_SREJ: {
-                l_Output << "SREJ";
-                break;
-            }
-            default: {
-                break;
-            }
-        } // switch
-
-        l_Output << ", PF=" << IsPF() << ", RSeq=" << (int)GetRSeq();
-    } else if (IsUFrame()) {
-        l_Output << "HDLC frame, Addr=0x" << std::hex << (int)GetAddress() << std::dec << ", U-Frame: ";
-        switch (GetHDLCFrameType()) {
-            case HdlcFrame::HDLC_FRAMETYPE_U_UI: {
-                l_bHasPayload = true;
-                l_Output << "UI";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_SIM: {
-                l_Output << "SIM";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_SARM: {
-                l_Output << "SARM";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_UP: {
-                l_Output << "UP";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_SABM: {
-                l_Output << "SABM";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_DISC: {
-                l_Output << "DISC";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_UA: {
-                l_Output << "UA";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_SNRM: {
-                l_Output << "SNRM";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_CMDR: {
-                l_bHasPayload = true;
-                l_Output << "FRMR/CMDR";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_TEST: {
-                l_bHasPayload = true;
-                l_Output << "TEST";
-                break;
-            }
-            case HdlcFrame::HDLC_FRAMETYPE_U_XID: {
-                l_bHasPayload = true;
-                l_Output << "XID";
-                break;
-            }
-            default: {
-                break;
-            }
-        } // switch
-        
-        l_Output << ", PF=" << IsPF();
+        AppendString(a_Output, ", S-Frame: ");
+        AppendString(a_Output, g_FrameTypeNames[m_eHDLCFrameType]);
+        AppendString(a_Output, ", PF=");
+        a_Output.push_back(IsPF() ? '1' : '0');
+        AppendString(a_Output, ", RSeq=");
+        AppendDecimal(a_Output, GetRSeq());
     } else {
-        l_Output << "Unparseable HDLC frame";
+        AppendString(a_Output, ", U-Frame: ");
+        AppendString(a_Output, g_FrameTypeNames[m_eHDLCFrameType]);
+        AppendString(a_Output, ", PF=");
+        a_Output.push_back(IsPF() ? '1' : '0');
     } // else
     
+    bool l_bHasPayload = ((m_eHDLCFrameType == HDLC_FRAMETYPE_I)      || (m_eHDLCFrameType == HDLC_FRAMETYPE_U_UI) ||
+                          (m_eHDLCFrameType == HDLC_FRAMETYPE_U_CMDR) || (m_eHDLCFrameType == HDLC_FRAMETYPE_U_TEST) ||
+                          (m_eHDLCFrameType == HDLC_FRAMETYPE_U_XID));
     if (l_bHasPayload) {
-        l_Output << ", with " << m_Payload.size() << " bytes payload:";
-        for (auto it = m_Payload.begin(); it != m_Payload.end(); ++it) {
-            l_Output << " " << std::hex << std::setw(2) << std::setfill('0') << int(*it);
-        } // for
+        AppendString(a_Output, ", with ");
+        AppendDecimal(a_Output, m_Payload.size());
+        AppendString(a_Output, " bytes payload");
+        if (a_bWithPayloadHexDump) {
+            a_Output.push_back(':');
+            a_Output.reserve(a_Output.size() + (3 * m_Payload.size()));
+            for (auto it = m_Payload.begin(); it != m_Payload.end(); ++it) {
+                a_Output.push_back(' ');
+                a_Output.push_back(g_HexDigits[*it >> 4]);
+                a_Output.push_back(g_HexDigits[*it & 0x0F]);
+            } // for
+        } // if
     } // if
+}
 
-    std::vector<unsigned char> l_DissectedFrame;
-    std::string l_String(l_Output.str());
-    l_DissectedFrame.insert(l_DissectedFrame.begin(), l_String.data(), (l_String.data() + l_String.size()));
-    return l_DissectedFrame;
+void HdlcFrame::CreateStructuredRecord(std::vector<unsigned char> &a_Output, bool a_bInvalid, bool a_bWasSent, uint64_t a_Timestamp) const {
+    // Fixed-layout record, see doc/protocol.txt. All multi-byte fields are in network byte order.
+    size_t l_SliceSize = std::min(m_Payload.size(), (size_t)max_structured_payload_slice);
+    a_Output.clear();
+    a_Output.reserve(18 + l_SliceSize);
+    a_Output.push_back(0x01); // Version of the record
+    a_Output.push_back((a_bWasSent ? 0x01 : 0x00) | (a_bInvalid ? 0x02 : 0x00) | (IsPF() ? 0x04 : 0x00));
+    a_Output.push_back(m_eHDLCFrameType);
+    a_Output.push_back(m_Address);
+    a_Output.push_back(m_SSeq);
+    a_Output.push_back(m_RSeq);
+    for (int l_Shift = 56; l_Shift >= 0; l_Shift -= 8) {
+        a_Output.push_back((a_Timestamp >> l_Shift) & 0xFF);
+    } // for
+    
+    size_t l_PayloadSize = std::min(m_Payload.size(), (size_t)0xFFFF);
+    a_Output.push_back((l_PayloadSize >> 8) & 0xFF);
+    a_Output.push_back(l_PayloadSize & 0xFF);
+    a_Output.push_back((l_SliceSize >> 8) & 0xFF);
+    a_Output.push_back(l_SliceSize & 0xFF);
+    a_Output.insert(a_Output.end(), m_Payload.begin(), (m_Payload.begin() + l_SliceSize));
 }
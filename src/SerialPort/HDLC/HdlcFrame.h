@@ -39,6 +39,8 @@
 
 #include <string>
 #include <vector>
+#include <utility>
+#include <stdint.h>
 
 class HdlcFrame {
 public:
@@ -83,10 +85,14 @@ public:
     unsigned char GetSSeq() const { return m_SSeq; }
     
     void SetPayload(const std::vector<unsigned char> &a_Payload) { m_Payload = a_Payload; }
+    void SetPayload(std::vector<unsigned char> &&a_Payload) { m_Payload = std::move(a_Payload); }
     const std::vector<unsigned char>& GetPayload() const { return m_Payload; }
     bool HasPayload() const { return (m_Payload.empty() == false); }
     
     const std::vector<unsigned char> Dissect() const;
+    void Dissect(std::vector<unsigned char> &a_Output, bool a_bWithPayloadHexDump) const; // Reuses the memory of a_Output
+    void CreateStructuredRecord(std::vector<unsigned char> &a_Output, bool a_bInvalid, bool a_bWasSent, uint64_t a_Timestamp) const; // Reuses the memory of a_Output
+    enum { max_structured_payload_slice = 64 };
     
 private:
     // Members
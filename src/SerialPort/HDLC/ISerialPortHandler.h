@@ -38,7 +38,9 @@
 #define ISERIAL_PORT_HANDLER_H
 
 #include <vector>
+#include <stdint.h>
 #include "BufferType.h"
+class HdlcFrame;
 
 class ISerialPortHandler {
 public:
@@ -47,7 +49,9 @@ public:
 
     // Methods called by the HDLC ProtocolState object
     virtual bool RequiresBufferType(E_BUFFER_TYPE a_eBufferType) const = 0;
-    virtual void DeliverBufferToClients(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent) = 0;
+    virtual bool RequiresHdlcFrame(E_BUFFER_TYPE a_eBufferType) const = 0; // The HDLC frame must be provided on delivery, e.g., for filters
+    virtual void DeliverBufferToClients(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent, const HdlcFrame* a_HdlcFrame) = 0;
+    virtual void DeliverGapToClients(E_BUFFER_TYPE a_eBufferType, uint32_t a_DroppedFrames) = 0; // Frames that were never delivered
     virtual void ChangeBaudRate() = 0;
     virtual void PropagateSerialPortState() = 0;
     virtual void TransmitHDLCFrame(const std::vector<unsigned char> &a_Payload) = 0;
@@ -0,0 +1,50 @@
+/**
+ * \file PayloadConfirmation.h
+ * \brief 
+ *
+ * Copyright (c) 2016, Florian Evers, florian-evers@gmx.de
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer. 
+ * 
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.  
+ *     
+ *     (3)The name of the author may not be used to
+ *     endorse or promote products derived from this software without
+ *     specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PAYLOAD_CONFIRMATION_H
+#define PAYLOAD_CONFIRMATION_H
+
+#include <functional>
+
+typedef enum {
+    PAYLOAD_CONFIRMATION_ACKNOWLEDGED = 0, // Reliable payload: the I-frame was acknowledged by the device
+    PAYLOAD_CONFIRMATION_TRANSMITTED  = 1, // Unreliable payload: the UI-frame was handed over to the serial port
+    PAYLOAD_CONFIRMATION_DROPPED      = 2  // The payload was dropped, e.g., as the serial port was closed
+} E_PAYLOAD_CONFIRMATION;
+
+typedef std::function<void(E_PAYLOAD_CONFIRMATION)> PayloadConfirmationCallback;
+
+#endif // PAYLOAD_CONFIRMATION_H
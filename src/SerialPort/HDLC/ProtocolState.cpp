@@ -39,7 +39,10 @@
 #include "FrameGenerator.h"
 #include "ISerialPortHandler.h"
 
-ProtocolState::ProtocolState(std::shared_ptr<ISerialPortHandler> a_SerialPortHandler, boost::asio::io_service& a_IOService): m_SerialPortHandler(a_SerialPortHandler), m_FrameParser(*this), m_Timer(a_IOService) {
+ProtocolState::ProtocolState(std::shared_ptr<ISerialPortHandler> a_SerialPortHandler, boost::asio::io_service& a_IOService): m_SerialPortHandler(a_SerialPortHandler), m_Timer(a_IOService) {
+    // Initialize the mirror for sniffers
+    m_SnifferMirror = std::make_shared<SnifferMirror>(a_SerialPortHandler, a_IOService);
+    
     // Initialize alive state helper
     m_AliveState = std::make_shared<AliveState>(a_IOService);
     m_AliveState->SetSendProbeCallback([this]() {
@@ -89,8 +92,9 @@ void ProtocolState::Start() {
 
 void ProtocolState::Stop() {
     if (m_bStarted) {
-        // Stop the state machine
+        // Stop the state machine. The sequence numbers are reset, thus pending payloads are never transmitted.
         Reset();
+        DropWaitQueues();
         m_SerialPortHandler->PropagateSerialPortState();
     } // if
 }
@@ -99,18 +103,26 @@ void ProtocolState::Shutdown() {
     if (m_bStarted) {
         // Stop the state machine, but do not emit any subsequent events
         Reset();
-        m_SerialPortHandler.reset();
     } // if
+    
+    // Pending payloads will never be transmitted. Release the serial port handler in any case, even if the state machine
+    // was already stopped, as the serial port handler holds a reference to this object and to the sniffer mirror.
+    DropWaitQueues();
+    m_SnifferMirror->Shutdown();
+    m_SerialPortHandler.reset();
 }
 
-void ProtocolState::SendPayload(const std::vector<unsigned char> &a_Payload, bool a_bReliable) {
+void ProtocolState::SendPayload(const std::vector<unsigned char> &a_Payload, bool a_bReliable, PayloadConfirmationCallback a_OnConfirmation) {
     // Queue payload for later framing
+    WaitQueueEntry l_WaitQueueEntry;
+    l_WaitQueueEntry.m_Payload = a_Payload;
+    l_WaitQueueEntry.m_OnConfirmation = std::move(a_OnConfirmation);
     if (a_bReliable) {
         // TODO: assure that the size does not grow without limits!
-        m_WaitQueueReliable.emplace_back(std::move(a_Payload));
+        m_WaitQueueReliable.emplace_back(std::move(l_WaitQueueEntry));
     } else {
         // TODO: assure that the size does not grow without limits!
-        m_WaitQueueUnreliable.emplace_back(std::move(a_Payload));
+        m_WaitQueueUnreliable.emplace_back(std::move(l_WaitQueueEntry));
     } // else
 
     bool l_bSendReliableFrames = m_bStarted;
@@ -140,39 +152,59 @@ void ProtocolState::AddReceivedRawBytes(const unsigned char* a_Buffer, size_t a_
         return;
     } // if
 
-    m_FrameParser.AddReceivedRawBytes(a_Buffer, a_Bytes);
+    // Collect all frames contained in this chunk of bytes and process them as a batch
+    m_DeserializedFrames.clear();
+    m_FrameParser.AddReceivedRawBytes(a_Buffer, a_Bytes, m_DeserializedFrames);
+    if (m_DeserializedFrames.empty() == false) {
+        InterpretDeserializedFrames(m_DeserializedFrames);
+    } // if
 }
 
-void ProtocolState::InterpretDeserializedFrame(const std::vector<unsigned char> &a_Payload, const HdlcFrame& a_HdlcFrame, bool a_bMessageInvalid) {
-    // Checks
+void ProtocolState::InterpretDeserializedFrames(const std::vector<DeserializedFrame> &a_DeserializedFrames) {
+    // Update the protocol state frame by frame, but defer all actions that are required only once per batch
+    bool l_bAliveStateChanged = false;
+    for (auto it = a_DeserializedFrames.begin(); it != a_DeserializedFrames.end(); ++it) {
+        if (!m_bStarted) {
+            // Stopped or shutdown while processing the batch
+            return;
+        } // if
+
+        l_bAliveStateChanged |= InterpretDeserializedFrame(it->m_UnescapedBuffer, it->m_HdlcFrame, it->m_bMessageInvalid);
+    } // for
+    
     if (!m_bStarted) {
         return;
     } // if
 
-    // Deliver raw frame to clients that have interest
-    if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_RAW)) {
-        m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_RAW, a_Payload, false, a_bMessageInvalid, false); // not escaped
+    if (l_bAliveStateChanged) {
+        m_SerialPortHandler->PropagateSerialPortState();
     } // if
-    
-    if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_DISSECTED)) {
-        m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_DISSECTED, a_HdlcFrame.Dissect(), false, a_bMessageInvalid, false);
+
+    if (m_bAwaitsNextHDLCFrame) {
+        // Check if we have to send something now. A single RR acknowledges all I-frames of this batch.
+        OpportunityForTransmission();
+    } // if
+}
+
+bool ProtocolState::InterpretDeserializedFrame(const std::vector<unsigned char> &a_Payload, const HdlcFrame& a_HdlcFrame, bool a_bMessageInvalid) {
+    // Mirror the raw frame to clients that have interest. They are served later.
+    if (m_SnifferMirror->IsRequired()) {
+        m_SnifferMirror->AddFrame(a_Payload, false, a_bMessageInvalid, false); // not escaped
     } // if
     
     // Stop here if the frame was considered broken
     if (a_bMessageInvalid) {
-        return;
+        return false;
     } // if
     
-    // A valid frame was received
-    if (m_AliveState->OnFrameReceived()) {
-        m_SerialPortHandler->PropagateSerialPortState();
-    } // if
+    // A valid frame was received. A change of the alive state is reported to the caller.
+    bool l_bAliveStateChanged = m_AliveState->OnFrameReceived();
     
     // Go ahead interpreting the frame we received
     if (a_HdlcFrame.HasPayload()) {
         // I-Frame or U-Frame with UI
         if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_PAYLOAD)) {
-            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_PAYLOAD, a_HdlcFrame.GetPayload(), a_HdlcFrame.IsIFrame(), a_bMessageInvalid, false);
+            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_PAYLOAD, a_HdlcFrame.GetPayload(), a_HdlcFrame.IsIFrame(), a_bMessageInvalid, false, &a_HdlcFrame);
         } // if
         
         // If it is an I-Frame, the data may have to be acked
@@ -204,7 +236,7 @@ void ProtocolState::InterpretDeserializedFrame(const std::vector<unsigned char>
                 // We found the respective sequence number to the last transmitted I-frame
                 m_bWaitForAck = false;
                 m_Timer.cancel();
-                m_WaitQueueReliable.pop_front();
+                PopWaitQueue(m_WaitQueueReliable, PAYLOAD_CONFIRMATION_ACKNOWLEDGED);
             } // if
             
             m_SSeqOutgoing = a_HdlcFrame.GetRSeq();
@@ -222,7 +254,7 @@ void ProtocolState::InterpretDeserializedFrame(const std::vector<unsigned char>
                 m_Timer.cancel();
                 if (a_HdlcFrame.GetRSeq() == ((m_SSeqOutgoing + 1) & 0x07)) {
                     // We found the respective sequence number to the last transmitted I-frame
-                    m_WaitQueueReliable.pop_front();
+                    PopWaitQueue(m_WaitQueueReliable, PAYLOAD_CONFIRMATION_ACKNOWLEDGED);
                 } // if
             } // if
             
@@ -264,10 +296,7 @@ void ProtocolState::InterpretDeserializedFrame(const std::vector<unsigned char>
         } // else
     } // if
     
-    if (m_bAwaitsNextHDLCFrame) {
-        // Check if we have to send something now
-        OpportunityForTransmission();
-    } // if
+    return l_bAliveStateChanged;
 }
 
 void ProtocolState::OpportunityForTransmission() {
@@ -348,7 +377,7 @@ void ProtocolState::OpportunityForTransmission() {
         // Check if packets are waiting for unreliable transmission
         if (l_HdlcFrame.IsEmpty() && (m_WaitQueueUnreliable.empty() == false)) {
             l_HdlcFrame = PrepareUFrameUI();
-            m_WaitQueueUnreliable.pop_front();
+            PopWaitQueue(m_WaitQueueUnreliable, PAYLOAD_CONFIRMATION_TRANSMITTED);
         } // if
         
         // If there is nothing to send, try to fill the wait queues, but only if necessary.
@@ -363,27 +392,19 @@ void ProtocolState::OpportunityForTransmission() {
     } // if
 
     if (l_HdlcFrame.IsEmpty() == false) {
-        // Deliver unescaped frame to clients that have interest
+        // Transmit the frame first, then mirror the unescaped frame to clients that have interest. They are served later.
         m_bAwaitsNextHDLCFrame = false;
         auto l_HDLCFrameBuffer = FrameGenerator::SerializeFrame(l_HdlcFrame);
-        if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_RAW)) {
-            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_RAW, l_HDLCFrameBuffer, l_HdlcFrame.IsIFrame(), false, true); // not escaped
-        } // if
-        
-        if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_DISSECTED)) {
-            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_DISSECTED, l_HdlcFrame.Dissect(), l_HdlcFrame.IsIFrame(), false, true);
-        } // if
-        
         m_SerialPortHandler->TransmitHDLCFrame(std::move(FrameGenerator::EscapeFrame(l_HDLCFrameBuffer)));
+        if (m_SnifferMirror->IsRequired()) {
+            m_SnifferMirror->AddFrame(l_HDLCFrameBuffer, l_HdlcFrame.IsIFrame(), false, true); // not escaped
+        } // if
     } // if
 }
 
 HdlcFrame ProtocolState::PrepareIFrame() {
     // Fresh Payload to be sent is available.
     assert(m_WaitQueueReliable.empty() == false);
-    if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_PAYLOAD)) {
-        m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_PAYLOAD, m_WaitQueueReliable.front(), true, false, true);
-    } // if
 
     // Prepare I-Frame    
     HdlcFrame l_HdlcFrame;
@@ -392,7 +413,11 @@ HdlcFrame ProtocolState::PrepareIFrame() {
     l_HdlcFrame.SetPF(false);
     l_HdlcFrame.SetSSeq(m_SSeqOutgoing);
     l_HdlcFrame.SetRSeq(m_RSeqIncoming);
-    l_HdlcFrame.SetPayload(m_WaitQueueReliable.front());
+    l_HdlcFrame.SetPayload(m_WaitQueueReliable.front().m_Payload);
+    if (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_PAYLOAD)) {
+        m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_PAYLOAD, m_WaitQueueReliable.front().m_Payload, true, false, true, &l_HdlcFrame);
+    } // if
+    
     return(l_HdlcFrame);
 }
 
@@ -417,14 +442,14 @@ HdlcFrame ProtocolState::PrepareSFrameSREJ() {
 
 HdlcFrame ProtocolState::PrepareUFrameUI() {
     assert(m_WaitQueueUnreliable.empty() == false);
-    m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_PAYLOAD, m_WaitQueueUnreliable.front(), false, false, true);
 
     // Prepare UI-Frame
     HdlcFrame l_HdlcFrame;
     l_HdlcFrame.SetAddress(0x30);
     l_HdlcFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_U_UI);
     l_HdlcFrame.SetPF(false);
-    l_HdlcFrame.SetPayload(m_WaitQueueUnreliable.front());
+    l_HdlcFrame.SetPayload(m_WaitQueueUnreliable.front().m_Payload);
+    m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_PAYLOAD, m_WaitQueueUnreliable.front().m_Payload, false, false, true, &l_HdlcFrame);
     return(l_HdlcFrame);
 }
 
@@ -435,3 +460,24 @@ HdlcFrame ProtocolState::PrepareUFrameTEST() {
     l_HdlcFrame.SetPF(false);
     return(l_HdlcFrame);
 }
+
+void ProtocolState::PopWaitQueue(std::deque<WaitQueueEntry> &a_WaitQueue, E_PAYLOAD_CONFIRMATION a_ePayloadConfirmation) {
+    // Remove the payload first, as the callback may add subsequent payloads
+    assert(a_WaitQueue.empty() == false);
+    PayloadConfirmationCallback l_OnConfirmation = std::move(a_WaitQueue.front().m_OnConfirmation);
+    a_WaitQueue.pop_front();
+    if (l_OnConfirmation) {
+        l_OnConfirmation(a_ePayloadConfirmation);
+    } // if
+}
+
+void ProtocolState::DropWaitQueues() {
+    // Inform the originators of all pending payloads
+    while (m_WaitQueueReliable.empty() == false) {
+        PopWaitQueue(m_WaitQueueReliable, PAYLOAD_CONFIRMATION_DROPPED);
+    } // while
+    
+    while (m_WaitQueueUnreliable.empty() == false) {
+        PopWaitQueue(m_WaitQueueUnreliable, PAYLOAD_CONFIRMATION_DROPPED);
+    } // while
+}
@@ -44,6 +44,8 @@
 #include "AliveState.h"
 #include "HdlcFrame.h"
 #include "FrameParser.h"
+#include "SnifferMirror.h"
+#include "PayloadConfirmation.h"
 class ISerialPortHandler;
 
 class ProtocolState: public std::enable_shared_from_this<ProtocolState> {
@@ -54,24 +56,27 @@ public:
     void Stop();
     void Shutdown();
 
-    void SendPayload(const std::vector<unsigned char> &a_Payload, bool a_bReliable);
+    void SendPayload(const std::vector<unsigned char> &a_Payload, bool a_bReliable, PayloadConfirmationCallback a_OnConfirmation);
     void TriggerNextHDLCFrame();
     void AddReceivedRawBytes(const unsigned char* a_Buffer, size_t a_Bytes);
-    void InterpretDeserializedFrame(const std::vector<unsigned char> &a_Payload, const HdlcFrame& a_HdlcFrame, bool a_bMessageInvalid);
+    void InterpretDeserializedFrames(const std::vector<DeserializedFrame> &a_DeserializedFrames);
     
     // Query state
     bool IsAlive() const { return m_AliveState->IsAlive(); }
     bool IsRunning() const  { return m_bStarted; }
+    size_t GetDroppedSnifferFrames() const { return m_SnifferMirror->GetDroppedFrames(); }
 
 private:
     // Internal helpers
     void Reset();
+    bool InterpretDeserializedFrame(const std::vector<unsigned char> &a_Payload, const HdlcFrame& a_HdlcFrame, bool a_bMessageInvalid);
     void OpportunityForTransmission();
     HdlcFrame PrepareIFrame();
     HdlcFrame PrepareSFrameRR();
     HdlcFrame PrepareSFrameSREJ();
     HdlcFrame PrepareUFrameUI();
     HdlcFrame PrepareUFrameTEST();
+    void DropWaitQueues();
     
     // Members
     bool m_bStarted;
@@ -91,14 +96,23 @@ private:
     // Parser and generator
     std::shared_ptr<ISerialPortHandler> m_SerialPortHandler;
     FrameParser m_FrameParser;
+    std::vector<DeserializedFrame> m_DeserializedFrames; // Frames of the last chunk of received bytes, processed as a batch
     
-    // Wait queues
-    std::deque<std::vector<unsigned char>> m_WaitQueueReliable;
-    std::deque<std::vector<unsigned char>> m_WaitQueueUnreliable;
+    // Wait queues. The optional callback is invoked as soon as the fate of the payload is known.
+    typedef struct {
+        std::vector<unsigned char> m_Payload;
+        PayloadConfirmationCallback m_OnConfirmation;
+    } WaitQueueEntry;
+    std::deque<WaitQueueEntry> m_WaitQueueReliable;
+    std::deque<WaitQueueEntry> m_WaitQueueUnreliable;
+    void PopWaitQueue(std::deque<WaitQueueEntry> &a_WaitQueue, E_PAYLOAD_CONFIRMATION a_ePayloadConfirmation);
     
     // Alive state
     std::shared_ptr<AliveState> m_AliveState;
     
+    // Delivery of frames to RAW, DISSECTED, and STRUCTURED clients, decoupled from the protocol handling
+    std::shared_ptr<SnifferMirror> m_SnifferMirror;
+    
     // Timer
     boost::asio::deadline_timer m_Timer;
     bool m_bAliveReceivedSometing;
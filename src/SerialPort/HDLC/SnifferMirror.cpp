@@ -0,0 +1,139 @@
+/**
+ * \file SnifferMirror.cpp
+ * \brief 
+ *
+ * Copyright (c) 2016, Florian Evers, florian-evers@gmx.de
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer. 
+ * 
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.  
+ *     
+ *     (3)The name of the author may not be used to
+ *     endorse or promote products derived from this software without
+ *     specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SnifferMirror.h"
+#include <assert.h>
+#include <chrono>
+#include "ISerialPortHandler.h"
+#include "FrameParser.h"
+
+SnifferMirror::SnifferMirror(std::shared_ptr<ISerialPortHandler> a_SerialPortHandler, boost::asio::io_service& a_IOService): m_SerialPortHandler(a_SerialPortHandler), m_IOService(a_IOService) {
+    m_Ring.resize(max_frames);
+    m_Head = 0;
+    m_Count = 0;
+    m_bDeliveryScheduled = false;
+    m_DroppedFrames = 0;
+    m_PendingDroppedFrames = 0;
+}
+
+void SnifferMirror::Shutdown() {
+    // Drop all pending frames, do not emit any subsequent events
+    m_SerialPortHandler.reset();
+    m_Count = 0;
+}
+
+bool SnifferMirror::IsRequired() const {
+    return ((m_SerialPortHandler) && ((m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_RAW)) ||
+                                      (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_DISSECTED)) ||
+                                      (m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_STRUCTURED))));
+}
+
+void SnifferMirror::AddFrame(const std::vector<unsigned char> &a_UnescapedBuffer, bool a_bReliable, bool a_bInvalid, bool a_bWasSent) {
+    if (m_Count == max_frames) {
+        // The sniffers cannot keep up. Never stall the protocol handling, drop this frame.
+        ++m_DroppedFrames;
+        ++m_PendingDroppedFrames;
+        return;
+    } // if
+    
+    // Copy the frame into the next free slot, reusing its memory
+    MirroredFrame& l_MirroredFrame = m_Ring[(m_Head + m_Count) % max_frames];
+    l_MirroredFrame.m_UnescapedBuffer.assign(a_UnescapedBuffer.begin(), a_UnescapedBuffer.end());
+    l_MirroredFrame.m_bReliable = a_bReliable;
+    l_MirroredFrame.m_bInvalid  = a_bInvalid;
+    l_MirroredFrame.m_bWasSent  = a_bWasSent;
+    l_MirroredFrame.m_Timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    l_MirroredFrame.m_DroppedBefore = m_PendingDroppedFrames;
+    m_PendingDroppedFrames = 0;
+    ++m_Count;
+    
+    if (!m_bDeliveryScheduled) {
+        // Deliver later, after all events that are already pending
+        m_bDeliveryScheduled = true;
+        auto self(shared_from_this());
+        m_IOService.post([this, self]() { DoDeliver(); });
+    } // if
+}
+
+void SnifferMirror::DoDeliver() {
+    m_bDeliveryScheduled = false;
+    for (size_t l_Index = 0; ((l_Index < max_frames_per_run) && (m_Count) && (m_SerialPortHandler)); ++l_Index) {
+        const MirroredFrame& l_MirroredFrame = m_Ring[m_Head];
+        bool l_bRaw        = m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_RAW);
+        bool l_bDissected  = m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_DISSECTED);
+        bool l_bStructured = m_SerialPortHandler->RequiresBufferType(BUFFER_TYPE_STRUCTURED);
+        
+        if (l_MirroredFrame.m_DroppedBefore) {
+            // Inform the sniffers where frames are missing
+            m_SerialPortHandler->DeliverGapToClients(BUFFER_TYPE_RAW, l_MirroredFrame.m_DroppedBefore);
+            m_SerialPortHandler->DeliverGapToClients(BUFFER_TYPE_DISSECTED, l_MirroredFrame.m_DroppedBefore);
+            m_SerialPortHandler->DeliverGapToClients(BUFFER_TYPE_STRUCTURED, l_MirroredFrame.m_DroppedBefore);
+        } // if
+        
+        // Parse the frame only once, and only if required by the buffer types or by filters
+        HdlcFrame l_HdlcFrame;
+        if ((l_bDissected) || (l_bStructured) || ((l_bRaw) && (m_SerialPortHandler->RequiresHdlcFrame(BUFFER_TYPE_RAW)))) {
+            l_HdlcFrame = FrameParser::DeserializeFrame(l_MirroredFrame.m_UnescapedBuffer);
+        } // if
+        
+        if (l_bRaw) {
+            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_RAW, l_MirroredFrame.m_UnescapedBuffer, l_MirroredFrame.m_bReliable, l_MirroredFrame.m_bInvalid, l_MirroredFrame.m_bWasSent, &l_HdlcFrame); // not escaped
+        } // if
+        
+        if ((l_bDissected) && (m_SerialPortHandler)) {
+            l_HdlcFrame.Dissect(m_DissectedBuffer, true);
+            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_DISSECTED, m_DissectedBuffer, l_MirroredFrame.m_bReliable, l_MirroredFrame.m_bInvalid, l_MirroredFrame.m_bWasSent, &l_HdlcFrame);
+        } // if
+        
+        if ((l_bStructured) && (m_SerialPortHandler)) {
+            l_HdlcFrame.CreateStructuredRecord(m_DissectedBuffer, l_MirroredFrame.m_bInvalid, l_MirroredFrame.m_bWasSent, l_MirroredFrame.m_Timestamp);
+            m_SerialPortHandler->DeliverBufferToClients(BUFFER_TYPE_STRUCTURED, m_DissectedBuffer, l_MirroredFrame.m_bReliable, l_MirroredFrame.m_bInvalid, l_MirroredFrame.m_bWasSent, &l_HdlcFrame);
+        } // if
+        
+        if (m_Count) {
+            // Not dropped by a shutdown while delivering
+            m_Head = ((m_Head + 1) % max_frames);
+            --m_Count;
+        } // if
+    } // for
+    
+    if ((m_Count) && (m_SerialPortHandler)) {
+        // More frames are pending. Yield to other events first.
+        m_bDeliveryScheduled = true;
+        auto self(shared_from_this());
+        m_IOService.post([this, self]() { DoDeliver(); });
+    } // if
+}
@@ -0,0 +1,95 @@
+/**
+ * \file SnifferMirror.h
+ * \brief 
+ *
+ * Copyright (c) 2016, Florian Evers, florian-evers@gmx.de
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     (1) Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer. 
+ * 
+ *     (2) Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.  
+ *     
+ *     (3)The name of the author may not be used to
+ *     endorse or promote products derived from this software without
+ *     specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SNIFFER_MIRROR_H
+#define SNIFFER_MIRROR_H
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <boost/asio.hpp>
+class ISerialPortHandler;
+
+/*! \class SnifferMirror
+ *  \brief Class SnifferMirror
+ * 
+ *  This class decouples the delivery of HDLC frames to RAW, DISSECTED, and STRUCTURED clients ("sniffers") from the protocol
+ *  handling.
+ *  The protocol handling only appends a copy of each frame to a bounded ring. The frames are dissected and delivered later
+ *  in small chunks, thus other pending events of the io_service are processed in between.
+ */
+class SnifferMirror: public std::enable_shared_from_this<SnifferMirror> {
+public:
+    // CTOR and resetter
+    SnifferMirror(std::shared_ptr<ISerialPortHandler> a_SerialPortHandler, boost::asio::io_service& a_IOService);
+    void Shutdown();
+    
+    // Called by the protocol handling
+    bool IsRequired() const;
+    void AddFrame(const std::vector<unsigned char> &a_UnescapedBuffer, bool a_bReliable, bool a_bInvalid, bool a_bWasSent);
+    
+    // Statistics
+    size_t GetDroppedFrames() const { return m_DroppedFrames; }
+
+private:
+    // Internal helpers
+    void DoDeliver();
+    
+    // Members
+    std::shared_ptr<ISerialPortHandler> m_SerialPortHandler;
+    boost::asio::io_service& m_IOService;
+    
+    // The ring of mirrored frames. The slots are reused, thus there are no allocations in steady state.
+    typedef struct {
+        std::vector<unsigned char> m_UnescapedBuffer;
+        bool m_bReliable;
+        bool m_bInvalid;
+        bool m_bWasSent;
+        uint64_t m_Timestamp; // Microseconds since the epoch
+        uint32_t m_DroppedBefore; // Number of frames dropped right before this one, reported via a gap indication
+    } MirroredFrame;
+    enum { max_frames = 512 };          // The capacity of the ring
+    enum { max_frames_per_run = 16 };   // The number of frames delivered before other events are processed
+    std::vector<MirroredFrame> m_Ring;
+    size_t m_Head;
+    size_t m_Count;
+    bool m_bDeliveryScheduled;
+    size_t m_DroppedFrames;
+    uint32_t m_PendingDroppedFrames; // Dropped frames not yet assigned to a slot
+    std::vector<unsigned char> m_DissectedBuffer; // Reused for each dissected frame or structured record
+};
+
+#endif // SNIFFER_MIRROR_H
@@ -0,0 +1,121 @@
+/**
+ * \file IoServicePool.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "IoServicePool.h"
+#include <iostream>
+#include <assert.h>
+#include <string.h>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+IoServicePool::IoServicePool(boost::asio::io_service& a_IOService, size_t a_Threads) {
+    // Checks
+    assert(a_Threads);
+    m_IOServices.emplace_back(&a_IOService);
+    for (size_t l_Index = 1; l_Index < a_Threads; ++l_Index) {
+        m_OwnedIOServices.emplace_back(new boost::asio::io_service(1));
+        m_IOServices.emplace_back(m_OwnedIOServices.back().get());
+    } // for
+}
+
+IoServicePool::~IoServicePool() {
+    Stop();
+}
+
+bool IoServicePool::IsCpuAffinitySupported() {
+#if defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void IoServicePool::SetCpuAffinity(const std::vector<unsigned int>& a_Cpus) {
+    assert(a_Cpus.size() == m_IOServices.size());
+    assert(m_Threads.empty());
+    m_Cpus = a_Cpus;
+}
+
+void IoServicePool::Start() {
+    // Run each owned event loop in a dedicated thread. The first event loop is run by the caller.
+    assert(m_Threads.empty());
+    if (!m_Cpus.empty()) {
+        PinCurrentThread(0, m_Cpus[0]);
+    } // if
+    
+    for (size_t l_Index = 1; l_Index < m_IOServices.size(); ++l_Index) {
+        boost::asio::io_service* l_IOService = m_IOServices[l_Index];
+        boost::asio::io_service* l_MainIOService = m_IOServices.front();
+        bool l_bPinned = (!m_Cpus.empty());
+        unsigned int l_Cpu = (l_bPinned ? m_Cpus[l_Index] : 0);
+        m_Work.emplace_back(new boost::asio::io_service::work(*l_IOService));
+        m_Threads.emplace_back([l_IOService, l_MainIOService, l_Index, l_bPinned, l_Cpu]() {
+            if (l_bPinned) {
+                PinCurrentThread(l_Index, l_Cpu);
+            } // if
+            
+            try {
+                l_IOService->run();
+            } catch (std::exception& a_Error) {
+                // Terminate the daemon, as done for the main thread
+                std::cerr << "Exception: " << a_Error.what() << std::endl;
+                l_MainIOService->stop();
+            } // catch
+        });
+    } // for
+}
+
+void IoServicePool::Stop() {
+    // Stop all owned event loops and wait for their threads. Pending handlers are not executed anymore.
+    m_Work.clear();
+    for (auto it = m_OwnedIOServices.begin(); it != m_OwnedIOServices.end(); ++it) {
+        (*it)->stop();
+    } // for
+    
+    for (auto it = m_Threads.begin(); it != m_Threads.end(); ++it) {
+        it->join();
+    } // for
+    
+    m_Threads.clear();
+}
+
+void IoServicePool::PinCurrentThread(size_t a_Index, unsigned int a_Cpu) {
+    // A failure is not fatal, the event loop just runs unpinned
+#if defined(__linux__)
+    if (a_Cpu >= CPU_SETSIZE) {
+        std::cerr << "Failed to pin event loop " << a_Index << " to CPU " << a_Cpu << ": no such CPU" << std::endl;
+        return;
+    } // if
+    
+    cpu_set_t l_CpuSet;
+    CPU_ZERO(&l_CpuSet);
+    CPU_SET(a_Cpu, &l_CpuSet);
+    int l_Error = ::pthread_setaffinity_np(::pthread_self(), sizeof(l_CpuSet), &l_CpuSet);
+    if (l_Error) {
+        std::cerr << "Failed to pin event loop " << a_Index << " to CPU " << a_Cpu << ": " << ::strerror(l_Error) << std::endl;
+    } // if
+#else
+    (void)a_Index;
+    (void)a_Cpu;
+#endif
+}
@@ -0,0 +1,67 @@
+/**
+ * \file IoServicePool.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IO_SERVICE_POOL_H
+#define IO_SERVICE_POOL_H
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <boost/asio.hpp>
+
+/*! \class IoServicePool
+ *  \brief Class IoServicePool
+ * 
+ *  A set of event loops, each being an io_service that is run by exactly one thread. The first one is provided by the
+ *  caller and run by the main thread, the others are owned by this object. As each event loop is run by a single
+ *  thread, all handlers of one loop are serialized, and objects that are only accessed via the same event loop need no
+ *  further synchronization. Optionally, each thread is pinned to a CPU, keeping the state of its serial ports in the
+ *  caches of that CPU.
+ */
+class IoServicePool {
+public:
+    // CTOR and DTOR
+    IoServicePool(boost::asio::io_service& a_IOService, size_t a_Threads);
+    ~IoServicePool();
+    
+    size_t GetSize() const { return m_IOServices.size(); }
+    boost::asio::io_service& GetIOService(size_t a_Index) const { return *(m_IOServices[a_Index]); }
+    
+    // CPU affinity, one CPU per event loop. Must be set before Start() is called.
+    static bool IsCpuAffinitySupported();
+    void SetCpuAffinity(const std::vector<unsigned int>& a_Cpus);
+    
+    void Start();
+    void Stop();
+    
+private:
+    // Internal helpers
+    static void PinCurrentThread(size_t a_Index, unsigned int a_Cpu);
+    
+    // Members
+    std::vector<boost::asio::io_service*> m_IOServices; //!< All event loops, the first one is run by the main thread
+    std::vector<std::unique_ptr<boost::asio::io_service>> m_OwnedIOServices;
+    std::vector<std::unique_ptr<boost::asio::io_service::work>> m_Work; //!< Keep the owned event loops running while idle
+    std::vector<std::thread> m_Threads;
+    std::vector<unsigned int> m_Cpus; //!< The CPU of each event loop, empty if the threads are not pinned
+};
+
+#endif // IO_SERVICE_POOL_H
@@ -0,0 +1,62 @@
+/**
+ * \file LinkTransport.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LinkTransport.h"
+#include "SerialLinkTransport.h"
+#include "SocketLinkTransport.h"
+#include "Rfc2217LinkTransport.h"
+#include "PtyLinkTransport.h"
+
+std::shared_ptr<LinkTransport> LinkTransport::Create(const std::string &a_SerialPortName, boost::asio::io_service& a_IOService) {
+    // Unknown schemes are taken as device names, thus, each name yields a transport. Errors are reported by Open().
+    std::string l_Scheme = GetScheme(a_SerialPortName);
+    if (l_Scheme == "tcp") {
+        return std::make_shared<SocketLinkTransport>(a_IOService, SocketLinkTransport::SOCKET_TYPE_TCP, a_SerialPortName.substr(6));
+    } // if
+    
+    if (l_Scheme == "rfc2217") {
+        return std::make_shared<Rfc2217LinkTransport>(a_IOService, a_SerialPortName.substr(10));
+    } // if
+    
+    if (l_Scheme == "unix") {
+        return std::make_shared<SocketLinkTransport>(a_IOService, SocketLinkTransport::SOCKET_TYPE_UNIX, a_SerialPortName.substr(5));
+    } // if
+    
+    if (l_Scheme == "pty") {
+        return std::make_shared<PtyLinkTransport>(a_IOService, a_SerialPortName.substr(4));
+    } // if
+    
+    return std::make_shared<SerialLinkTransport>(a_IOService, a_SerialPortName);
+}
+
+std::string LinkTransport::GetScheme(const std::string &a_SerialPortName) {
+    if (a_SerialPortName.compare(0, 6, "tcp://") == 0) {
+        return "tcp";
+    } else if (a_SerialPortName.compare(0, 10, "rfc2217://") == 0) {
+        return "rfc2217";
+    } else if (a_SerialPortName.compare(0, 5, "unix:") == 0) {
+        return "unix";
+    } else if (a_SerialPortName.compare(0, 4, "pty:") == 0) {
+        return "pty";
+    } // else if
+    
+    return std::string();
+}
@@ -0,0 +1,67 @@
+/**
+ * \file LinkTransport.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINK_TRANSPORT_H
+#define LINK_TRANSPORT_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+
+/*! \class LinkTransport
+ *  \brief Class LinkTransport
+ * 
+ *  The byte stream that carries the HDLC frames between the HDLCd and a device. The transport is chosen by the scheme of
+ *  the serial port name given by the clients:
+ *  - "tcp://host:port" connects to a terminal server that forwards the raw byte stream, e.g., ser2net in raw mode
+ *  - "rfc2217://host:port" connects to a terminal server speaking telnet with the COM port option of RFC 2217
+ *  - "unix:/path" connects to a unix domain stream socket, e.g., of a local test endpoint
+ *  - "pty:" or "pty:/path" creates a pseudo terminal for a local test endpoint, optionally linked at the given path
+ *  - everything else is the name of a serial port device, e.g., /dev/ttyUSB0
+ *  The HDLC protocol handling is the same for all transports. All schemes except serial port devices have to be allowed
+ *  explicitly, see SerialPortHandlerCollection::AllowTransport().
+ */
+class LinkTransport {
+public:
+    typedef std::function<void(const boost::system::error_code&, std::size_t)> IoHandler;
+    typedef std::function<void(const boost::system::error_code&)> OpenHandler;
+    
+    // DTOR and factory
+    virtual ~LinkTransport() {}
+    static std::shared_ptr<LinkTransport> Create(const std::string &a_SerialPortName, boost::asio::io_service& a_IOService);
+    static std::string GetScheme(const std::string &a_SerialPortName); // "tcp", "rfc2217", "unix", "pty", or empty for a device
+    
+    // Open and close. The open handler is invoked via the event loop, or right away if opening cannot block, e.g., for a
+    // device. It reports the error that prevented opening, or operation_aborted if Close() was called meanwhile.
+    virtual void AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler) = 0;
+    virtual void Close() = 0;
+    virtual void SetBaudRate(unsigned int a_BaudRate) = 0;
+    
+    // Asynchronous I/O via the event loop, at most one read and one write at a time
+    virtual void AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) = 0;
+    virtual void AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) = 0;
+    
+    // The file descriptor for direct reads and writes by a dedicated thread, -1 if the byte stream needs further processing
+    virtual int GetNativeHandle() = 0;
+};
+
+#endif // LINK_TRANSPORT_H
@@ -0,0 +1,161 @@
+/**
+ * \file PtyLinkTransport.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PtyLinkTransport.h"
+#include <iostream>
+#include <boost/system/system_error.hpp>
+#include <errno.h>
+#include <string.h>
+#if !defined(BOOST_ASIO_WINDOWS)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+PtyLinkTransport::PtyLinkTransport(boost::asio::io_service& a_IOService, const std::string &a_LinkPath): m_LinkPath(a_LinkPath)
+#if !defined(BOOST_ASIO_WINDOWS)
+    , m_Master(a_IOService)
+#endif
+{
+    m_bLinked = false;
+#if !defined(BOOST_ASIO_WINDOWS)
+    m_SlaveFileDescriptor = -1;
+#else
+    (void)a_IOService;
+#endif
+}
+
+PtyLinkTransport::~PtyLinkTransport() {
+    Close();
+}
+
+void PtyLinkTransport::AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler) {
+    // Creating a pseudo terminal does not block
+    boost::system::error_code l_ErrorCode;
+    try {
+        Open(a_BaudRate);
+    } catch (boost::system::system_error& a_Error) {
+        l_ErrorCode = a_Error.code();
+    } // catch
+    
+    a_OpenHandler(l_ErrorCode);
+}
+
+void PtyLinkTransport::Open(unsigned int) {
+#if !defined(BOOST_ASIO_WINDOWS)
+    int l_MasterFileDescriptor = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (l_MasterFileDescriptor < 0) {
+        throw boost::system::system_error(errno, boost::system::system_category(), "posix_openpt");
+    } // if
+    
+    const char* l_SlaveName = NULL;
+    if ((::grantpt(l_MasterFileDescriptor) != 0) || (::unlockpt(l_MasterFileDescriptor) != 0) || ((l_SlaveName = ::ptsname(l_MasterFileDescriptor)) == NULL)) {
+        int l_Error = errno;
+        ::close(l_MasterFileDescriptor);
+        throw boost::system::system_error(l_Error, boost::system::system_category(), "pty");
+    } // if
+    
+    // Raw mode, thus, the line discipline passes all bytes unchanged
+    std::string l_SlavePath(l_SlaveName);
+    m_SlaveFileDescriptor = ::open(l_SlavePath.c_str(), O_RDWR | O_NOCTTY);
+    struct termios l_Termios;
+    if ((m_SlaveFileDescriptor < 0) || (::tcgetattr(m_SlaveFileDescriptor, &l_Termios) != 0)) {
+        int l_Error = errno;
+        ::close(l_MasterFileDescriptor);
+        Close();
+        throw boost::system::system_error(l_Error, boost::system::system_category(), l_SlavePath);
+    } // if
+    
+    ::cfmakeraw(&l_Termios);
+    ::tcsetattr(m_SlaveFileDescriptor, TCSANOW, &l_Termios);
+    m_Master.assign(l_MasterFileDescriptor);
+    
+    // Replace a stale link of a previous run, but never anything else
+    if (!m_LinkPath.empty()) {
+        struct stat l_Stat;
+        if ((::lstat(m_LinkPath.c_str(), &l_Stat) == 0) && (S_ISLNK(l_Stat.st_mode))) {
+            ::unlink(m_LinkPath.c_str());
+        } // if
+        
+        if (::symlink(l_SlavePath.c_str(), m_LinkPath.c_str()) == 0) {
+            m_bLinked = true;
+        } else {
+            std::cerr << "Failed to link " << m_LinkPath << " to the pseudo terminal " << l_SlavePath << ": " << ::strerror(errno) << std::endl;
+        } // else
+    } // if
+    
+    std::cerr << "Pseudo terminal " << l_SlavePath << " opened" << (m_bLinked ? (", linked at " + m_LinkPath) : std::string()) << std::endl;
+#else
+    throw boost::system::system_error(boost::asio::error::operation_not_supported, "Pseudo terminals are not supported on this platform");
+#endif
+}
+
+void PtyLinkTransport::Close() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    boost::system::error_code l_ErrorCode;
+    m_Master.cancel(l_ErrorCode);
+    m_Master.close(l_ErrorCode);
+    if (m_SlaveFileDescriptor >= 0) {
+        ::close(m_SlaveFileDescriptor);
+        m_SlaveFileDescriptor = -1;
+    } // if
+#endif
+    if (m_bLinked) {
+        m_bLinked = false;
+#if !defined(BOOST_ASIO_WINDOWS)
+        ::unlink(m_LinkPath.c_str());
+#endif
+    } // if
+}
+
+void PtyLinkTransport::SetBaudRate(unsigned int) {
+    // There is no baud rate
+}
+
+void PtyLinkTransport::AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+#if !defined(BOOST_ASIO_WINDOWS)
+    m_Master.async_read_some(boost::asio::buffer(a_Buffer, a_Bytes), a_IoHandler);
+#else
+    (void)a_Buffer;
+    (void)a_Bytes;
+    a_IoHandler(boost::asio::error::operation_not_supported, 0);
+#endif
+}
+
+void PtyLinkTransport::AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+#if !defined(BOOST_ASIO_WINDOWS)
+    m_Master.async_write_some(boost::asio::buffer(a_Buffer, a_Bytes), a_IoHandler);
+#else
+    (void)a_Buffer;
+    (void)a_Bytes;
+    a_IoHandler(boost::asio::error::operation_not_supported, 0);
+#endif
+}
+
+int PtyLinkTransport::GetNativeHandle() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    return m_Master.native_handle();
+#else
+    return -1;
+#endif
+}
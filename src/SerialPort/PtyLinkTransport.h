@@ -0,0 +1,60 @@
+/**
+ * \file PtyLinkTransport.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PTY_LINK_TRANSPORT_H
+#define PTY_LINK_TRANSPORT_H
+
+#include "LinkTransport.h"
+
+/*! \class PtyLinkTransport
+ *  \brief Class PtyLinkTransport
+ * 
+ *  A pseudo terminal created by the HDLCd. A local test endpoint, e.g., a device simulator, opens the slave side, whose
+ *  name is reported on stderr. If a path is given, a symbolic link to the slave side is created there as well. The slave
+ *  side is kept open by the HDLCd, thus, the test endpoint may come and go without closing the serial port.
+ */
+class PtyLinkTransport: public LinkTransport {
+public:
+    // CTOR and DTOR
+    PtyLinkTransport(boost::asio::io_service& a_IOService, const std::string &a_LinkPath);
+    ~PtyLinkTransport();
+    
+    void AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler);
+    void Close();
+    void SetBaudRate(unsigned int a_BaudRate);
+    void AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    void AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    int GetNativeHandle();
+    
+private:
+    // Internal helpers
+    void Open(unsigned int a_BaudRate); // Throws boost::system::system_error on failure
+    
+    // Members
+    std::string m_LinkPath;
+    bool m_bLinked;
+#if !defined(BOOST_ASIO_WINDOWS)
+    boost::asio::posix::stream_descriptor m_Master;
+    int m_SlaveFileDescriptor;
+#endif
+};
+
+#endif // PTY_LINK_TRANSPORT_H
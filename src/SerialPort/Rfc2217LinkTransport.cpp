@@ -0,0 +1,217 @@
+/**
+ * \file Rfc2217LinkTransport.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Rfc2217LinkTransport.h"
+#include <assert.h>
+
+Rfc2217LinkTransport::Rfc2217LinkTransport(boost::asio::io_service& a_IOService, const std::string &a_Address): SocketLinkTransport(a_IOService, SOCKET_TYPE_TCP, a_Address) {
+    m_eTelnetState = TELNET_STATE_DATA;
+    m_TelnetCommand = 0;
+    m_bWriting = false;
+}
+
+void Rfc2217LinkTransport::AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler) {
+    SocketLinkTransport::AsyncOpen(a_BaudRate, [this, a_BaudRate, a_OpenHandler](const boost::system::error_code& a_ErrorCode) {
+        if (!a_ErrorCode) {
+            m_eTelnetState = TELNET_STATE_DATA;
+            m_TelnetCommands.clear();
+            m_FrameBuffer.clear();
+            m_FrameIoHandler = nullptr;
+            m_bWriting = false;
+            
+            // Binary transmission in both directions without go-aheads, and the COM port control option
+            const unsigned char l_Negotiation[] = {
+                TELNET_IAC, TELNET_WILL, OPTION_BINARY, TELNET_IAC, TELNET_DO, OPTION_BINARY,
+                TELNET_IAC, TELNET_WILL, OPTION_SGA, TELNET_IAC, TELNET_DO, OPTION_SGA,
+                TELNET_IAC, TELNET_WILL, OPTION_COM_PORT
+            };
+            m_TelnetCommands.assign(l_Negotiation, l_Negotiation + sizeof(l_Negotiation));
+            AddComPortCommand(COM_PORT_SET_DATASIZE, std::vector<unsigned char>(1, 8));
+            AddComPortCommand(COM_PORT_SET_PARITY, std::vector<unsigned char>(1, 1));   // None
+            AddComPortCommand(COM_PORT_SET_STOPSIZE, std::vector<unsigned char>(1, 1)); // One stop bit
+            AddComPortCommand(COM_PORT_SET_CONTROL, std::vector<unsigned char>(1, 1));  // No flow control
+            SetBaudRate(a_BaudRate);
+        } // if
+        
+        a_OpenHandler(a_ErrorCode);
+    });
+}
+
+void Rfc2217LinkTransport::SetBaudRate(unsigned int a_BaudRate) {
+    std::vector<unsigned char> l_Value;
+    l_Value.emplace_back((a_BaudRate >> 24) & 0xFF);
+    l_Value.emplace_back((a_BaudRate >> 16) & 0xFF);
+    l_Value.emplace_back((a_BaudRate >>  8) & 0xFF);
+    l_Value.emplace_back((a_BaudRate >>  0) & 0xFF);
+    AddComPortCommand(COM_PORT_SET_BAUDRATE, l_Value);
+    DoWrite();
+}
+
+void Rfc2217LinkTransport::AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+    // Deliver only data bytes. If a read yielded only telnet commands, read again.
+    m_Socket.async_read_some(boost::asio::buffer(a_Buffer, a_Bytes), [this, a_Buffer, a_Bytes, a_IoHandler](const boost::system::error_code& a_ErrorCode, std::size_t a_BytesRead) {
+        if (a_ErrorCode) {
+            a_IoHandler(a_ErrorCode, 0);
+            return;
+        } // if
+        
+        size_t l_DataBytes = RemoveTelnetCommands(a_Buffer, a_BytesRead);
+        DoWrite();
+        if (l_DataBytes) {
+            a_IoHandler(a_ErrorCode, l_DataBytes);
+        } else {
+            AsyncReadSome(a_Buffer, a_Bytes, a_IoHandler);
+        } // else
+    });
+}
+
+void Rfc2217LinkTransport::AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+    // The escaped frame is written completely, thus, telnet commands are never sent between two escaped IAC bytes
+    assert(!m_FrameIoHandler);
+    m_FrameBuffer.clear();
+    for (size_t l_Index = 0; l_Index < a_Bytes; ++l_Index) {
+        m_FrameBuffer.emplace_back(a_Buffer[l_Index]);
+        if (a_Buffer[l_Index] == TELNET_IAC) {
+            m_FrameBuffer.emplace_back(TELNET_IAC);
+        } // if
+    } // for
+    
+    m_FrameIoHandler = [a_Bytes, a_IoHandler](const boost::system::error_code& a_ErrorCode, std::size_t) {
+        a_IoHandler(a_ErrorCode, (a_ErrorCode ? 0 : a_Bytes));
+    };
+    DoWrite();
+}
+
+size_t Rfc2217LinkTransport::RemoveTelnetCommands(unsigned char* a_Buffer, size_t a_Bytes) {
+    // Strip all commands in place, the state is kept across reads
+    size_t l_DataBytes = 0;
+    for (size_t l_Index = 0; l_Index < a_Bytes; ++l_Index) {
+        unsigned char l_Byte = a_Buffer[l_Index];
+        switch (m_eTelnetState) {
+            case TELNET_STATE_DATA:
+                if (l_Byte == TELNET_IAC) {
+                    m_eTelnetState = TELNET_STATE_IAC;
+                } else {
+                    a_Buffer[l_DataBytes++] = l_Byte;
+                } // else
+                break;
+            case TELNET_STATE_IAC:
+                if (l_Byte == TELNET_IAC) {
+                    // An escaped data byte
+                    a_Buffer[l_DataBytes++] = l_Byte;
+                    m_eTelnetState = TELNET_STATE_DATA;
+                } else if ((l_Byte >= TELNET_WILL) && (l_Byte <= TELNET_DONT)) {
+                    m_TelnetCommand = l_Byte;
+                    m_eTelnetState = TELNET_STATE_OPTION;
+                } else if (l_Byte == TELNET_SB) {
+                    m_eTelnetState = TELNET_STATE_SB;
+                } else {
+                    // A command without an option, e.g., NOP
+                    m_eTelnetState = TELNET_STATE_DATA;
+                } // else
+                break;
+            case TELNET_STATE_OPTION:
+                // Accept the options we requested, and refuse all others. Refusals are never answered, thus, no loops.
+                if ((m_TelnetCommand == TELNET_DO) && (l_Byte != OPTION_BINARY) && (l_Byte != OPTION_SGA) && (l_Byte != OPTION_COM_PORT)) {
+                    m_TelnetCommands.emplace_back(TELNET_IAC);
+                    m_TelnetCommands.emplace_back(TELNET_WONT);
+                    m_TelnetCommands.emplace_back(l_Byte);
+                } else if ((m_TelnetCommand == TELNET_WILL) && (l_Byte != OPTION_BINARY) && (l_Byte != OPTION_SGA)) {
+                    m_TelnetCommands.emplace_back(TELNET_IAC);
+                    m_TelnetCommands.emplace_back(TELNET_DONT);
+                    m_TelnetCommands.emplace_back(l_Byte);
+                } // else if
+                
+                m_eTelnetState = TELNET_STATE_DATA;
+                break;
+            case TELNET_STATE_SB:
+                // Notifications of the terminal server, e.g., line state changes, are ignored
+                if (l_Byte == TELNET_IAC) {
+                    m_eTelnetState = TELNET_STATE_SB_IAC;
+                } // if
+                break;
+            case TELNET_STATE_SB_IAC:
+                m_eTelnetState = ((l_Byte == TELNET_SE) ? TELNET_STATE_DATA : TELNET_STATE_SB);
+                break;
+            default:
+                m_eTelnetState = TELNET_STATE_DATA;
+                break;
+        } // switch
+    } // for
+    
+    return l_DataBytes;
+}
+
+void Rfc2217LinkTransport::AddComPortCommand(unsigned char a_Command, const std::vector<unsigned char> &a_Value) {
+    m_TelnetCommands.emplace_back(TELNET_IAC);
+    m_TelnetCommands.emplace_back(TELNET_SB);
+    m_TelnetCommands.emplace_back(OPTION_COM_PORT);
+    m_TelnetCommands.emplace_back(a_Command);
+    for (auto it = a_Value.begin(); it != a_Value.end(); ++it) {
+        m_TelnetCommands.emplace_back(*it);
+        if (*it == TELNET_IAC) {
+            m_TelnetCommands.emplace_back(TELNET_IAC);
+        } // if
+    } // for
+    
+    m_TelnetCommands.emplace_back(TELNET_IAC);
+    m_TelnetCommands.emplace_back(TELNET_SE);
+}
+
+void Rfc2217LinkTransport::DoWrite() {
+    // One write at a time: all pending telnet commands first, then the pending frame
+    if (m_bWriting) {
+        return;
+    } // if
+    
+    IoHandler l_FrameIoHandler;
+    if (!m_TelnetCommands.empty()) {
+        m_WriteBuffer.swap(m_TelnetCommands);
+        m_TelnetCommands.clear();
+    } else if (m_FrameIoHandler) {
+        m_WriteBuffer.swap(m_FrameBuffer);
+        l_FrameIoHandler.swap(m_FrameIoHandler);
+    } else {
+        return;
+    } // else
+    
+    m_bWriting = true;
+    auto self(shared_from_this());
+    boost::asio::async_write(m_Socket, boost::asio::buffer(m_WriteBuffer), [this, self, l_FrameIoHandler](const boost::system::error_code& a_ErrorCode, std::size_t a_BytesWritten) {
+        m_bWriting = false;
+        if (l_FrameIoHandler) {
+            if (!a_ErrorCode) {
+                DoWrite();
+            } // if
+            
+            l_FrameIoHandler(a_ErrorCode, a_BytesWritten);
+        } else if (a_ErrorCode) {
+            // Telnet commands only. A pending frame fails as well, otherwise the error is detected by the next read.
+            if (m_FrameIoHandler) {
+                IoHandler l_PendingFrameIoHandler;
+                l_PendingFrameIoHandler.swap(m_FrameIoHandler);
+                l_PendingFrameIoHandler(a_ErrorCode, 0);
+            } // if
+        } else {
+            DoWrite();
+        } // else
+    });
+}
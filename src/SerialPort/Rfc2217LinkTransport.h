@@ -0,0 +1,94 @@
+/**
+ * \file Rfc2217LinkTransport.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFC2217_LINK_TRANSPORT_H
+#define RFC2217_LINK_TRANSPORT_H
+
+#include <vector>
+#include "SocketLinkTransport.h"
+
+/*! \class Rfc2217LinkTransport
+ *  \brief Class Rfc2217LinkTransport
+ * 
+ *  A TCP connection to a terminal server speaking telnet with the COM port control option of RFC 2217, e.g., ser2net in
+ *  telnet mode. The serial port of the terminal server is configured for 8N1 without flow control, and the baud rate is
+ *  changed remotely. Telnet commands are removed from the received byte stream, and IAC bytes of the HDLC frames are
+ *  doubled. Telnet commands may appear anywhere within the byte stream, thus, our responses are sent between writes.
+ *  All writes are serialized via the event loop: pending telnet commands are written first, then the pending frame.
+ */
+class Rfc2217LinkTransport: public SocketLinkTransport, public std::enable_shared_from_this<Rfc2217LinkTransport> {
+public:
+    // CTOR
+    Rfc2217LinkTransport(boost::asio::io_service& a_IOService, const std::string &a_Address);
+    
+    void AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler);
+    void SetBaudRate(unsigned int a_BaudRate);
+    void AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    void AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    int GetNativeHandle() { return -1; }
+    
+private:
+    // Internal helpers
+    size_t RemoveTelnetCommands(unsigned char* a_Buffer, size_t a_Bytes);
+    void AddComPortCommand(unsigned char a_Command, const std::vector<unsigned char> &a_Value);
+    void DoWrite();
+    
+    // Telnet
+    enum {
+        TELNET_SE   = 240,
+        TELNET_SB   = 250,
+        TELNET_WILL = 251,
+        TELNET_WONT = 252,
+        TELNET_DO   = 253,
+        TELNET_DONT = 254,
+        TELNET_IAC  = 255
+    };
+    enum {
+        OPTION_BINARY = 0,
+        OPTION_SGA = 3,
+        OPTION_COM_PORT = 44
+    };
+    enum {
+        COM_PORT_SET_BAUDRATE = 1,
+        COM_PORT_SET_DATASIZE = 2,
+        COM_PORT_SET_PARITY = 3,
+        COM_PORT_SET_STOPSIZE = 4,
+        COM_PORT_SET_CONTROL = 5
+    };
+    typedef enum {
+        TELNET_STATE_DATA = 0,
+        TELNET_STATE_IAC,
+        TELNET_STATE_OPTION,
+        TELNET_STATE_SB,
+        TELNET_STATE_SB_IAC
+    } E_TELNET_STATE;
+    
+    // Members
+    E_TELNET_STATE m_eTelnetState;
+    unsigned char m_TelnetCommand;
+    std::vector<unsigned char> m_TelnetCommands; //!< Pending telnet commands, sent if no write is in progress
+    std::vector<unsigned char> m_FrameBuffer;    //!< The pending escaped frame, sent after the pending telnet commands
+    IoHandler m_FrameIoHandler;                  //!< Invoked after the pending frame was written
+    std::vector<unsigned char> m_WriteBuffer;    //!< The telnet commands or the escaped frame being written
+    bool m_bWriting;
+};
+
+#endif // RFC2217_LINK_TRANSPORT_H
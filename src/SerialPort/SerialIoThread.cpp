@@ -0,0 +1,624 @@
+/**
+ * \file SerialIoThread.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SerialIoThread.h"
+#include <chrono>
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#if !defined(BOOST_ASIO_WINDOWS)
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+#if defined(HDLCD_HAS_IO_URING)
+#include <liburing.h>
+#endif
+
+SerialIoThread::SerialIoThread(boost::asio::io_service& a_IOService, int a_Priority, unsigned int a_BusyPollMicroseconds): m_IOService(a_IOService),
+    m_Priority(a_Priority), m_BusyPollMicroseconds(a_BusyPollMicroseconds),
+    m_ReceivedFrames(received_frames), m_TransmitFrames(transmitted_frames)
+#if !defined(BOOST_ASIO_WINDOWS)
+    , m_NotificationDescriptor(a_IOService)
+#endif
+{
+    m_FileDescriptor = -1;
+    m_bStarted = false;
+    m_TransmittedFrames = 0;
+    m_ReportedFrames = 0;
+    m_bNotified = false;
+    m_bReceiveStalled = false;
+    m_bStop = false;
+    m_bFailed = false;
+    m_CpuNanoseconds = 0;
+    m_BusyPollNanoseconds = 0;
+    m_BusyPollReads = 0;
+    m_WakeupPipe[0] = m_WakeupPipe[1] = -1;
+    m_NotificationPipe[0] = m_NotificationPipe[1] = -1;
+}
+
+SerialIoThread::~SerialIoThread() {
+    Stop();
+}
+
+bool SerialIoThread::IsSupported() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SerialIoThread::IsPrioritySupported() {
+#if !defined(BOOST_ASIO_WINDOWS) && defined(SCHED_FIFO)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SerialIoThread::SetOnFramesCallback(std::function<void(const std::vector<DeserializedFrame>&)> a_OnFramesCallback) {
+    m_OnFramesCallback = a_OnFramesCallback;
+}
+
+void SerialIoThread::SetOnTransmittedCallback(std::function<void()> a_OnTransmittedCallback) {
+    m_OnTransmittedCallback = a_OnTransmittedCallback;
+}
+
+void SerialIoThread::SetOnErrorCallback(std::function<void(const std::string&)> a_OnErrorCallback) {
+    m_OnErrorCallback = a_OnErrorCallback;
+}
+
+bool SerialIoThread::Start(int a_FileDescriptor) {
+    assert(!m_bStarted);
+#if !defined(BOOST_ASIO_WINDOWS)
+    // Both pipes are non-blocking: a full pipe already carries a pending notification
+    if (::pipe(m_WakeupPipe) != 0) {
+        std::cerr << "Failed to create the wakeup pipe of the serial I/O thread: " << ::strerror(errno) << std::endl;
+        return false;
+    } // if
+    
+    if (::pipe(m_NotificationPipe) != 0) {
+        std::cerr << "Failed to create the notification pipe of the serial I/O thread: " << ::strerror(errno) << std::endl;
+        ::close(m_WakeupPipe[0]);
+        ::close(m_WakeupPipe[1]);
+        m_WakeupPipe[0] = m_WakeupPipe[1] = -1;
+        return false;
+    } // if
+    
+    for (int l_Index = 0; l_Index < 2; ++l_Index) {
+        ::fcntl(m_WakeupPipe[l_Index], F_SETFL, ::fcntl(m_WakeupPipe[l_Index], F_GETFL) | O_NONBLOCK);
+        ::fcntl(m_NotificationPipe[l_Index], F_SETFL, ::fcntl(m_NotificationPipe[l_Index], F_GETFL) | O_NONBLOCK);
+    } // for
+    
+    // The read end of the notification pipe is owned by the stream descriptor now
+    m_NotificationDescriptor.assign(m_NotificationPipe[0]);
+    m_FileDescriptor = a_FileDescriptor;
+    m_bStarted = true;
+    DoWaitForNotification();
+    m_Thread = std::thread([this]() { Run(); });
+    return true;
+#else
+    (void)a_FileDescriptor;
+    return false;
+#endif
+}
+
+void SerialIoThread::Stop() {
+    if (!m_bStarted) {
+        return;
+    } // if
+    
+    // Wait for the dedicated thread, then release everything. The serial port itself is closed by the caller.
+    m_bStarted = false;
+#if !defined(BOOST_ASIO_WINDOWS)
+    m_bStop = true;
+    char l_Byte = 0;
+    if (::write(m_WakeupPipe[1], &l_Byte, 1) < 0) {
+        // The pipe is full, thus, the thread is woken up anyways
+    } // if
+    
+    m_Thread.join();
+    boost::system::error_code l_ErrorCode;
+    m_NotificationDescriptor.close(l_ErrorCode);
+    ::close(m_NotificationPipe[1]);
+    ::close(m_WakeupPipe[0]);
+    ::close(m_WakeupPipe[1]);
+    m_WakeupPipe[0] = m_WakeupPipe[1] = -1;
+    m_NotificationPipe[0] = m_NotificationPipe[1] = -1;
+#endif
+    m_FileDescriptor = -1;
+    m_ReceivedFrames.Clear();
+    m_TransmitFrames.Clear();
+}
+
+void SerialIoThread::TransmitFrame(std::vector<unsigned char> a_Buffer) {
+    // Only one frame is in transit at a time, thus, the ring is never full
+    assert(m_bStarted);
+    bool l_bPushed = m_TransmitFrames.Push(std::move(a_Buffer));
+    assert(l_bPushed);
+    (void)l_bPushed;
+#if !defined(BOOST_ASIO_WINDOWS)
+    char l_Byte = 0;
+    if (::write(m_WakeupPipe[1], &l_Byte, 1) < 0) {
+        // The pipe is full, thus, the thread is woken up anyways
+    } // if
+#endif
+}
+
+void SerialIoThread::DoWaitForNotification() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    auto self(shared_from_this());
+    m_NotificationDescriptor.async_read_some(boost::asio::buffer(m_NotificationBuffer, sizeof(m_NotificationBuffer)), [this, self](boost::system::error_code a_ErrorCode, std::size_t) {
+        if ((a_ErrorCode) || (!m_bStarted)) {
+            // Stopped
+            return;
+        } // if
+        
+        OnNotification();
+    });
+#endif
+}
+
+void SerialIoThread::OnNotification() {
+    // Notifications that arrive from now on are not lost, as the rings are checked afterwards
+    auto self(shared_from_this());
+    m_bNotified = false;
+    
+    // Take all received frames as one batch, then allow the dedicated thread to continue reading
+    m_DeserializedFrames.clear();
+    DeserializedFrame l_DeserializedFrame;
+    while (m_ReceivedFrames.Pop(l_DeserializedFrame)) {
+        m_DeserializedFrames.emplace_back(std::move(l_DeserializedFrame));
+    } // while
+    
+    if (m_bReceiveStalled.exchange(false)) {
+#if !defined(BOOST_ASIO_WINDOWS)
+        char l_Byte = 0;
+        if (::write(m_WakeupPipe[1], &l_Byte, 1) < 0) {
+            // The pipe is full, thus, the thread is woken up anyways
+        } // if
+#endif
+    } // if
+    
+    if ((!m_DeserializedFrames.empty()) && (m_OnFramesCallback)) {
+        m_OnFramesCallback(m_DeserializedFrames);
+        if (!m_bStarted) {
+            // Stopped by the callback
+            return;
+        } // if
+    } // if
+    
+    size_t l_TransmittedFrames = m_TransmittedFrames.load();
+    if (l_TransmittedFrames != m_ReportedFrames) {
+        m_ReportedFrames = l_TransmittedFrames;
+        if (m_OnTransmittedCallback) {
+            m_OnTransmittedCallback();
+            if (!m_bStarted) {
+                // Stopped by the callback
+                return;
+            } // if
+        } // if
+    } // if
+    
+    if (m_bFailed) {
+        // The dedicated thread terminated already
+        if (m_OnErrorCallback) {
+            m_OnErrorCallback(m_Error);
+        } // if
+        
+        return;
+    } // if
+    
+    DoWaitForNotification();
+}
+
+void SerialIoThread::Run() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    SetPriority();
+    if ((m_BusyPollMicroseconds) || (!LoopIoUring())) {
+        // Busy polling requires non-blocking reads, which are plain system calls anyways
+        Loop();
+    } // if
+    
+    // Account the CPU time consumed by this thread, including busy polling
+    struct timespec l_CpuTime;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &l_CpuTime) == 0) {
+        m_CpuNanoseconds = ((uint64_t)l_CpuTime.tv_sec * 1000000000ULL + l_CpuTime.tv_nsec);
+    } // if
+#endif
+}
+
+void SerialIoThread::Loop() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    // The serial port is accessed via non-blocking reads and writes, which is required for busy polling
+    ::fcntl(m_FileDescriptor, F_SETFL, ::fcntl(m_FileDescriptor, F_GETFL) | O_NONBLOCK);
+    FrameParser l_FrameParser;
+    std::vector<DeserializedFrame> l_DeserializedFrames; // Parsed, but not yet taken by the ring
+    std::vector<unsigned char> l_SendBuffer;
+    size_t l_SendBufferOffset = 0;
+    bool l_bSending = false;
+    unsigned char l_ReadBuffer[max_length];
+    unsigned char l_WakeupBuffer[64];
+    const std::chrono::microseconds l_BusyPollBudget(m_BusyPollMicroseconds);
+    std::chrono::steady_clock::time_point l_LastActivity = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point l_SpinStart;
+    bool l_bSpinning = false;
+    while (!m_bStop) {
+        if ((!l_bSending) && (m_TransmitFrames.Pop(l_SendBuffer))) {
+            l_bSending = true;
+            l_SendBufferOffset = 0;
+        } // if
+        
+        // Stop reading from the serial port if the event loop lags behind, the kernel buffers the bytes meanwhile
+        struct pollfd l_PollFds[2];
+        l_PollFds[0].fd = m_WakeupPipe[0];
+        l_PollFds[0].events = POLLIN;
+        l_PollFds[0].revents = 0;
+        l_PollFds[1].fd = m_FileDescriptor;
+        l_PollFds[1].events = ((l_DeserializedFrames.empty() ? POLLIN : 0) | (l_bSending ? POLLOUT : 0));
+        l_PollFds[1].revents = 0;
+        
+        // Shortly after activity, spin on non-blocking reads and writes instead of sleeping in poll(). The ring of
+        // frames to transmit and the stop flag are checked directly, thus, the wakeup pipe is not needed meanwhile.
+        bool l_bBusyPoll = false;
+        if (m_BusyPollMicroseconds) {
+            std::chrono::steady_clock::time_point l_Now = std::chrono::steady_clock::now();
+            l_bBusyPoll = ((l_Now - l_LastActivity) < l_BusyPollBudget);
+            if ((l_bBusyPoll) && (!l_bSpinning)) {
+                l_bSpinning = true;
+                l_SpinStart = l_Now;
+            } else if ((!l_bBusyPoll) && (l_bSpinning)) {
+                // The budget is exhausted without any activity
+                l_bSpinning = false;
+                m_BusyPollNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(l_Now - l_SpinStart).count();
+            } // else if
+        } // if
+        
+        if (l_bBusyPoll) {
+            l_PollFds[1].revents = l_PollFds[1].events;
+        } else if (::poll(l_PollFds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            } // if
+            
+            Fail("POLL", errno);
+            return;
+        } // else if
+        
+        if (l_PollFds[0].revents & POLLIN) {
+            while (::read(m_WakeupPipe[0], l_WakeupBuffer, sizeof(l_WakeupBuffer)) > 0) {
+            } // while
+        } // if
+        
+        bool l_bActivity = false;
+        if (l_PollFds[1].revents & POLLIN) {
+            ssize_t l_BytesRead = ::read(m_FileDescriptor, l_ReadBuffer, sizeof(l_ReadBuffer));
+            if (l_BytesRead > 0) {
+                l_bActivity = true;
+                l_FrameParser.AddReceivedRawBytes(l_ReadBuffer, l_BytesRead, l_DeserializedFrames);
+                if (l_bBusyPoll) {
+                    ++m_BusyPollReads;
+                } // if
+            } else if ((l_BytesRead == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+                Fail("READ", ((l_BytesRead == 0) ? EIO : errno));
+                return;
+            } // else if
+        } else if (l_PollFds[1].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            Fail("READ", EIO);
+            return;
+        } // else if
+        
+        if ((l_bSending) && (l_PollFds[1].revents & POLLOUT)) {
+            ssize_t l_BytesSent = ::write(m_FileDescriptor, &l_SendBuffer[l_SendBufferOffset], (l_SendBuffer.size() - l_SendBufferOffset));
+            if (l_BytesSent > 0) {
+                l_bActivity = true;
+                l_SendBufferOffset += l_BytesSent;
+                if (l_SendBufferOffset == l_SendBuffer.size()) {
+                    // Indicate that we are ready to transmit the next HDLC frame
+                    l_bSending = false;
+                    ++m_TransmittedFrames;
+                    Notify();
+                } // if
+            } else if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                Fail("WRITE", errno);
+                return;
+            } // else if
+        } // if
+        
+        if (!l_DeserializedFrames.empty()) {
+            FlushReceivedFrames(l_DeserializedFrames);
+        } // if
+        
+        if ((l_bActivity) && (m_BusyPollMicroseconds)) {
+            // Restart the budget. The time spent spinning until now was spent waiting for this activity.
+            l_LastActivity = std::chrono::steady_clock::now();
+            if (l_bSpinning) {
+                l_bSpinning = false;
+                m_BusyPollNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(l_LastActivity - l_SpinStart).count();
+            } // if
+        } // if
+    } // while
+#endif
+}
+
+bool SerialIoThread::LoopIoUring() {
+    // Returns false if io_uring is not available, e.g., with older kernels. The caller falls back to poll() then.
+#if defined(HDLCD_HAS_IO_URING)
+    struct io_uring l_Ring;
+    struct io_uring_params l_Params;
+    ::memset(&l_Params, 0x00, sizeof(l_Params));
+    if (::io_uring_queue_init_params(8, &l_Ring, &l_Params) < 0) {
+        return false;
+    } // if
+    
+    if (!(l_Params.features & IORING_FEAT_RW_CUR_POS)) {
+        // Required to read from and write to a serial port, as it has no file offset
+        ::io_uring_queue_exit(&l_Ring);
+        return false;
+    } // if
+    
+    FrameParser l_FrameParser;
+    std::vector<DeserializedFrame> l_DeserializedFrames; // Parsed, but not yet taken by the ring
+    std::vector<unsigned char> l_SendBuffer;
+    size_t l_SendBufferOffset = 0;
+    unsigned char l_ReadBuffer[max_length];
+    unsigned char l_WakeupBuffer[64];
+    
+    // The read buffer is registered once, thus, the kernel does not have to map it for each read
+    struct iovec l_ReadIovec;
+    l_ReadIovec.iov_base = l_ReadBuffer;
+    l_ReadIovec.iov_len = sizeof(l_ReadBuffer);
+    bool l_bFixedBuffer = (::io_uring_register_buffers(&l_Ring, &l_ReadIovec, 1) == 0);
+    
+    // io_uring waits for the serial port itself, but it would fail with EAGAIN on a non-blocking descriptor
+    ::fcntl(m_FileDescriptor, F_SETFL, ::fcntl(m_FileDescriptor, F_GETFL) & ~O_NONBLOCK);
+    
+    // The wakeup pipe is non-blocking, thus, it is polled and then read directly. A multishot poll stays armed.
+#if defined(IORING_POLL_ADD_MULTI) && defined(IORING_CQE_F_MORE)
+    bool l_bMultishot = true;
+#else
+    bool l_bMultishot = false;
+#endif
+    void* l_WakeupTag = l_WakeupBuffer;
+    void* l_ReadTag = l_ReadBuffer;
+    void* l_WriteTag = &l_SendBuffer;
+    bool l_bWaitingForWakeup = false;
+    bool l_bReading = false;
+    bool l_bSending = false;
+    unsigned int l_InFlight = 0;
+    const char* l_FailedOperation = NULL;
+    int l_Error = 0;
+    while ((!m_bStop) && (!l_FailedOperation)) {
+        // Prepare all operations that are not in flight yet, and submit them together
+        if (!l_bWaitingForWakeup) {
+            struct io_uring_sqe* l_Sqe = ::io_uring_get_sqe(&l_Ring);
+#if defined(IORING_POLL_ADD_MULTI) && defined(IORING_CQE_F_MORE)
+            if (l_bMultishot) {
+                ::io_uring_prep_poll_multishot(l_Sqe, m_WakeupPipe[0], POLLIN);
+            } else {
+                ::io_uring_prep_poll_add(l_Sqe, m_WakeupPipe[0], POLLIN);
+            } // else
+#else
+            ::io_uring_prep_poll_add(l_Sqe, m_WakeupPipe[0], POLLIN);
+#endif
+            ::io_uring_sqe_set_data(l_Sqe, l_WakeupTag);
+            l_bWaitingForWakeup = true;
+            ++l_InFlight;
+        } // if
+        
+        if ((!l_bReading) && (l_DeserializedFrames.empty())) {
+            // Stop reading from the serial port if the event loop lags behind, the kernel buffers the bytes meanwhile
+            struct io_uring_sqe* l_Sqe = ::io_uring_get_sqe(&l_Ring);
+            if (l_bFixedBuffer) {
+                ::io_uring_prep_read_fixed(l_Sqe, m_FileDescriptor, l_ReadBuffer, sizeof(l_ReadBuffer), (__u64)-1, 0);
+            } else {
+                ::io_uring_prep_read(l_Sqe, m_FileDescriptor, l_ReadBuffer, sizeof(l_ReadBuffer), (__u64)-1);
+            } // else
+            
+            ::io_uring_sqe_set_data(l_Sqe, l_ReadTag);
+            l_bReading = true;
+            ++l_InFlight;
+        } // if
+        
+        if ((!l_bSending) && (m_TransmitFrames.Pop(l_SendBuffer))) {
+            l_SendBufferOffset = 0;
+            struct io_uring_sqe* l_Sqe = ::io_uring_get_sqe(&l_Ring);
+            ::io_uring_prep_write(l_Sqe, m_FileDescriptor, &l_SendBuffer[0], l_SendBuffer.size(), (__u64)-1);
+            ::io_uring_sqe_set_data(l_Sqe, l_WriteTag);
+            l_bSending = true;
+            ++l_InFlight;
+        } // if
+        
+        int l_Result = ::io_uring_submit_and_wait(&l_Ring, 1);
+        if (l_Result < 0) {
+            if (l_Result == -EINTR) {
+                continue;
+            } // if
+            
+            l_FailedOperation = "IO_URING";
+            l_Error = -l_Result;
+            break;
+        } // if
+        
+        // Process all completions that are available
+        struct io_uring_cqe* l_Cqe;
+        while ((!l_FailedOperation) && (::io_uring_peek_cqe(&l_Ring, &l_Cqe) == 0)) {
+            void* l_Tag = ::io_uring_cqe_get_data(l_Cqe);
+            int l_Res = l_Cqe->res;
+            bool l_bMore = false;
+#if defined(IORING_CQE_F_MORE)
+            l_bMore = ((l_Cqe->flags & IORING_CQE_F_MORE) != 0);
+#endif
+            ::io_uring_cqe_seen(&l_Ring, l_Cqe);
+            if (!l_bMore) {
+                --l_InFlight;
+            } // if
+            
+            if (l_Tag == l_WakeupTag) {
+                l_bWaitingForWakeup = l_bMore;
+                if ((l_Res == -EINVAL) && (l_bMultishot)) {
+                    // Multishot polls are not supported by this kernel
+                    l_bMultishot = false;
+                } else if (l_Res < 0) {
+                    l_FailedOperation = "POLL";
+                    l_Error = -l_Res;
+                } else {
+                    while (::read(m_WakeupPipe[0], l_WakeupBuffer, sizeof(l_WakeupBuffer)) > 0) {
+                    } // while
+                } // else
+            } else if (l_Tag == l_ReadTag) {
+                l_bReading = false;
+                if (l_Res > 0) {
+                    l_FrameParser.AddReceivedRawBytes(l_ReadBuffer, l_Res, l_DeserializedFrames);
+                } else if (l_Res != -EINTR) {
+                    l_FailedOperation = "READ";
+                    l_Error = ((l_Res == 0) ? EIO : -l_Res);
+                } // else if
+            } else if (l_Tag == l_WriteTag) {
+                if (l_Res > 0) {
+                    l_SendBufferOffset += l_Res;
+                } else if (l_Res != -EINTR) {
+                    l_FailedOperation = "WRITE";
+                    l_Error = ((l_Res == 0) ? EIO : -l_Res);
+                    break;
+                } // else if
+                
+                if (l_SendBufferOffset == l_SendBuffer.size()) {
+                    // Indicate that we are ready to transmit the next HDLC frame
+                    l_bSending = false;
+                    ++m_TransmittedFrames;
+                    Notify();
+                } else {
+                    // Only a partial transmission. We are not done yet.
+                    struct io_uring_sqe* l_Sqe = ::io_uring_get_sqe(&l_Ring);
+                    ::io_uring_prep_write(l_Sqe, m_FileDescriptor, &l_SendBuffer[l_SendBufferOffset], (l_SendBuffer.size() - l_SendBufferOffset), (__u64)-1);
+                    ::io_uring_sqe_set_data(l_Sqe, l_WriteTag);
+                    ++l_InFlight;
+                } // else
+            } // else if
+        } // while
+        
+        if (!l_DeserializedFrames.empty()) {
+            FlushReceivedFrames(l_DeserializedFrames);
+        } // if
+    } // while
+    
+    // Cancel all operations in flight and wait for them, as they refer to the buffers on this stack
+    void* l_Tags[3] = { (l_bWaitingForWakeup ? l_WakeupTag : NULL), (l_bReading ? l_ReadTag : NULL), (l_bSending ? l_WriteTag : NULL) };
+    for (size_t l_Index = 0; l_Index < 3; ++l_Index) {
+        if (l_Tags[l_Index]) {
+            struct io_uring_sqe* l_Sqe = ::io_uring_get_sqe(&l_Ring);
+            ::io_uring_prep_cancel(l_Sqe, l_Tags[l_Index], 0);
+            ::io_uring_sqe_set_data(l_Sqe, NULL);
+        } // if
+    } // for
+    
+    ::io_uring_submit(&l_Ring);
+    while (l_InFlight) {
+        struct io_uring_cqe* l_Cqe;
+        if (::io_uring_wait_cqe(&l_Ring, &l_Cqe) < 0) {
+            break;
+        } // if
+        
+        bool l_bMore = false;
+#if defined(IORING_CQE_F_MORE)
+        l_bMore = ((l_Cqe->flags & IORING_CQE_F_MORE) != 0);
+#endif
+        if ((::io_uring_cqe_get_data(l_Cqe)) && (!l_bMore)) {
+            --l_InFlight;
+        } // if
+        
+        ::io_uring_cqe_seen(&l_Ring, l_Cqe);
+    } // while
+    
+    ::io_uring_queue_exit(&l_Ring);
+    if (l_FailedOperation) {
+        Fail(l_FailedOperation, l_Error);
+    } // if
+    
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SerialIoThread::SetPriority() {
+    // A failure is not fatal, the thread just runs with the default policy
+#if !defined(BOOST_ASIO_WINDOWS) && defined(SCHED_FIFO)
+    if (m_Priority <= 0) {
+        return;
+    } // if
+    
+    struct sched_param l_SchedParam;
+    ::memset(&l_SchedParam, 0x00, sizeof(l_SchedParam));
+    l_SchedParam.sched_priority = m_Priority;
+    int l_Error = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &l_SchedParam);
+    if (l_Error) {
+        std::cerr << "Failed to set SCHED_FIFO priority " << m_Priority << " for the serial I/O thread: " << ::strerror(l_Error) << std::endl;
+    } // if
+#endif
+}
+
+void SerialIoThread::FlushReceivedFrames(std::vector<DeserializedFrame> &a_DeserializedFrames) {
+    // Move as many frames as possible into the ring, keeping their order
+    size_t l_Pushed = 0;
+    while ((l_Pushed < a_DeserializedFrames.size()) && (m_ReceivedFrames.Push(std::move(a_DeserializedFrames[l_Pushed])))) {
+        ++l_Pushed;
+    } // while
+    
+    if (l_Pushed < a_DeserializedFrames.size()) {
+        // The ring is full. Announce the stall first, then retry, as the event loop may have emptied the ring meanwhile.
+        m_bReceiveStalled = true;
+        while ((l_Pushed < a_DeserializedFrames.size()) && (m_ReceivedFrames.Push(std::move(a_DeserializedFrames[l_Pushed])))) {
+            ++l_Pushed;
+        } // while
+    } // if
+    
+    a_DeserializedFrames.erase(a_DeserializedFrames.begin(), a_DeserializedFrames.begin() + l_Pushed);
+    if (l_Pushed) {
+        Notify();
+    } // if
+}
+
+void SerialIoThread::Notify() {
+    // Only one notification is in flight at a time
+#if !defined(BOOST_ASIO_WINDOWS)
+    if (!m_bNotified.exchange(true)) {
+        char l_Byte = 0;
+        if (::write(m_NotificationPipe[1], &l_Byte, 1) < 0) {
+            // The pipe is full, thus, the event loop is notified anyways
+        } // if
+    } // if
+#endif
+}
+
+void SerialIoThread::Fail(const char* a_Operation, int a_Error) {
+    // Report the error via the event loop, which stops the serial port
+    m_Error = std::string("SERIAL ") + a_Operation + " ERROR:" + ::strerror(a_Error);
+    m_bFailed = true;
+    m_bNotified = false;
+    Notify();
+}
@@ -0,0 +1,127 @@
+/**
+ * \file SerialIoThread.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERIAL_IO_THREAD_H
+#define SERIAL_IO_THREAD_H
+
+#include <atomic>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "FrameParser.h"
+#include "SpscRing.h"
+
+/*! \class SerialIoThread
+ *  \brief Class SerialIoThread
+ * 
+ *  Reads from and writes to an opened serial port via a dedicated thread, which also runs the frame parser. Thus, the
+ *  byte-level handling of the serial port is never delayed by clients that are served by the event loop of the serial
+ *  port. Deserialized frames and escaped frames for transmission are exchanged with the event loop via lock-free rings.
+ *  The event loop is notified via a pipe, the dedicated thread sleeps in poll() on the serial port and another pipe.
+ *  Optionally, the dedicated thread runs with the real-time scheduling policy SCHED_FIFO, and spins on non-blocking
+ *  reads for a limited time after each activity, avoiding the wakeup latency of poll() for frames that follow closely.
+ *  If built with liburing and supported by the kernel, the dedicated thread waits via io_uring instead of poll(), which
+ *  submits the reads and writes of the serial port and the wakeup in a single system call.
+ *  Each object serves one opened serial port: it is started once, and a new object is created if the serial port is
+ *  reopened.
+ */
+class SerialIoThread: public std::enable_shared_from_this<SerialIoThread> {
+public:
+    // CTOR and DTOR
+    SerialIoThread(boost::asio::io_service& a_IOService, int a_Priority, unsigned int a_BusyPollMicroseconds);
+    ~SerialIoThread();
+    static bool IsSupported();
+    static bool IsPrioritySupported();
+    
+    // Callbacks, invoked via the event loop
+    void SetOnFramesCallback(std::function<void(const std::vector<DeserializedFrame>&)> a_OnFramesCallback);
+    void SetOnTransmittedCallback(std::function<void()> a_OnTransmittedCallback);
+    void SetOnErrorCallback(std::function<void(const std::string&)> a_OnErrorCallback);
+    
+    // To be called via the event loop
+    bool Start(int a_FileDescriptor);
+    void Stop();
+    void TransmitFrame(std::vector<unsigned char> a_Buffer);
+    
+    // Statistics, valid after Stop()
+    uint64_t GetCpuNanoseconds() const { return m_CpuNanoseconds; }
+    uint64_t GetBusyPollNanoseconds() const { return m_BusyPollNanoseconds; }
+    size_t GetBusyPollReads() const { return m_BusyPollReads; }
+    
+private:
+    // Internal helpers, event loop
+    void DoWaitForNotification();
+    void OnNotification();
+    
+    // Internal helpers, dedicated thread
+    void Run();
+    void Loop();
+    bool LoopIoUring();
+    void SetPriority();
+    void FlushReceivedFrames(std::vector<DeserializedFrame> &a_DeserializedFrames);
+    void Notify();
+    void Fail(const char* a_Operation, int a_Error);
+    
+    // Members
+    boost::asio::io_service& m_IOService;
+    int m_Priority; //!< The SCHED_FIFO priority of the dedicated thread, 0 for the default policy
+    unsigned int m_BusyPollMicroseconds; //!< The time to spin after each activity before sleeping in poll(), 0 to never spin
+    int m_FileDescriptor;
+    bool m_bStarted;
+    std::function<void(const std::vector<DeserializedFrame>&)> m_OnFramesCallback;
+    std::function<void()> m_OnTransmittedCallback;
+    std::function<void(const std::string&)> m_OnErrorCallback;
+    
+    // Exchange of frames with the event loop
+    enum { received_frames = 256 };    // Must be a power of two
+    enum { transmitted_frames = 16 };  // Must be a power of two
+    SpscRing<DeserializedFrame> m_ReceivedFrames;
+    SpscRing<std::vector<unsigned char>> m_TransmitFrames;
+    std::vector<DeserializedFrame> m_DeserializedFrames; //!< Reused by the event loop
+    std::atomic<size_t> m_TransmittedFrames; //!< Incremented by the dedicated thread after each transmitted frame
+    size_t m_ReportedFrames; //!< The number of transmitted frames reported to the event loop
+    std::atomic<bool> m_bNotified;
+    std::atomic<bool> m_bReceiveStalled;
+    std::atomic<bool> m_bStop;
+    std::atomic<bool> m_bFailed;
+    std::string m_Error; //!< Written by the dedicated thread before m_bFailed is set
+    
+    // Statistics, written by the dedicated thread
+    std::atomic<uint64_t> m_CpuNanoseconds;      //!< The CPU time consumed by the dedicated thread, set on termination
+    std::atomic<uint64_t> m_BusyPollNanoseconds; //!< The time spent spinning without activity
+    std::atomic<size_t> m_BusyPollReads;         //!< The number of reads that returned bytes while spinning
+    
+    // Wakeup of the dedicated thread and notification of the event loop
+    int m_WakeupPipe[2];
+    int m_NotificationPipe[2];
+#if !defined(BOOST_ASIO_WINDOWS)
+    boost::asio::posix::stream_descriptor m_NotificationDescriptor;
+#endif
+    enum { max_length = 1024 };
+    unsigned char m_NotificationBuffer[64];
+    std::thread m_Thread;
+};
+
+#endif // SERIAL_IO_THREAD_H
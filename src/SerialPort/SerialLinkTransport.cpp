@@ -0,0 +1,73 @@
+/**
+ * \file SerialLinkTransport.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SerialLinkTransport.h"
+#include <boost/system/system_error.hpp>
+
+SerialLinkTransport::SerialLinkTransport(boost::asio::io_service& a_IOService, const std::string &a_DeviceName): m_SerialPort(a_IOService), m_DeviceName(a_DeviceName) {
+}
+
+void SerialLinkTransport::AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler) {
+    // Opening a device does not block
+    boost::system::error_code l_ErrorCode;
+    try {
+        Open(a_BaudRate);
+    } catch (boost::system::system_error& a_Error) {
+        l_ErrorCode = a_Error.code();
+    } // catch
+    
+    a_OpenHandler(l_ErrorCode);
+}
+
+void SerialLinkTransport::Open(unsigned int a_BaudRate) {
+    m_SerialPort.open(m_DeviceName);
+    m_SerialPort.set_option(boost::asio::serial_port::parity(boost::asio::serial_port::parity::none));
+    m_SerialPort.set_option(boost::asio::serial_port::character_size(boost::asio::serial_port::character_size(8)));
+    m_SerialPort.set_option(boost::asio::serial_port::stop_bits(boost::asio::serial_port::stop_bits::one));
+    m_SerialPort.set_option(boost::asio::serial_port::flow_control(boost::asio::serial_port::flow_control::none));
+    m_SerialPort.set_option(boost::asio::serial_port::baud_rate(a_BaudRate));
+}
+
+void SerialLinkTransport::Close() {
+    boost::system::error_code l_ErrorCode;
+    m_SerialPort.cancel(l_ErrorCode);
+    m_SerialPort.close(l_ErrorCode);
+}
+
+void SerialLinkTransport::SetBaudRate(unsigned int a_BaudRate) {
+    m_SerialPort.set_option(boost::asio::serial_port::baud_rate(a_BaudRate));
+}
+
+void SerialLinkTransport::AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+    m_SerialPort.async_read_some(boost::asio::buffer(a_Buffer, a_Bytes), a_IoHandler);
+}
+
+void SerialLinkTransport::AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+    m_SerialPort.async_write_some(boost::asio::buffer(a_Buffer, a_Bytes), a_IoHandler);
+}
+
+int SerialLinkTransport::GetNativeHandle() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    return m_SerialPort.native_handle();
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,53 @@
+/**
+ * \file SerialLinkTransport.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERIAL_LINK_TRANSPORT_H
+#define SERIAL_LINK_TRANSPORT_H
+
+#include "LinkTransport.h"
+
+/*! \class SerialLinkTransport
+ *  \brief Class SerialLinkTransport
+ * 
+ *  A serial port device, configured for 8N1 without flow control
+ */
+class SerialLinkTransport: public LinkTransport {
+public:
+    // CTOR
+    SerialLinkTransport(boost::asio::io_service& a_IOService, const std::string &a_DeviceName);
+    
+    void AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler);
+    void Close();
+    void SetBaudRate(unsigned int a_BaudRate);
+    void AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    void AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    int GetNativeHandle();
+    
+private:
+    // Internal helpers
+    void Open(unsigned int a_BaudRate); // Throws boost::system::system_error on failure
+    
+    // Members
+    boost::asio::serial_port m_SerialPort;
+    std::string m_DeviceName;
+};
+
+#endif // SERIAL_LINK_TRANSPORT_H
@@ -24,30 +24,55 @@
 #include "HdlcdServerHandler.h"
 #include "SerialPortHandlerCollection.h"
 #include "ProtocolState.h"
+#include "HdlcdPacketData.h"
+#include "SubscriptionFilter.h"
+#include "SharedMemoryRing.h"
+#include "SerialIoThread.h"
+#include "LinkTransport.h"
 #include <string.h>
+#include <algorithm>
 
-SerialPortHandler::SerialPortHandler(const std::string &a_SerialPortName, std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, boost::asio::io_service &a_IOService): m_SerialPort(a_IOService), m_IOService(a_IOService) {
+SerialPortHandler::SerialPortHandler(const std::string &a_SerialPortName, std::shared_ptr<SerialPortHandlerCollection> a_SerialPortHandlerCollection, boost::asio::io_service &a_IOService): m_IOService(a_IOService) {
     m_Registered = true;
     m_SerialPortName = a_SerialPortName;
+    m_LinkTransport = LinkTransport::Create(a_SerialPortName, a_IOService);
     m_SerialPortHandlerCollection = a_SerialPortHandlerCollection;
     m_SendBufferOffset = 0;
+    m_bUsesSerialIoThread = false;
+    m_SerialIoThreadPriority = 0;
+    m_BusyPollMicroseconds = 0;
+    m_FanOutDepth = 0;
+    m_bSubscriptionsChanged = false;
     ::memset(m_BufferTypeSubscribers, 0x00, sizeof(m_BufferTypeSubscribers));
+    ::memset(m_BufferTypeFilters, 0x00, sizeof(m_BufferTypeFilters));
 }
 
 SerialPortHandler::~SerialPortHandler() {
+    StopSerialIoThread();
     Stop();
 }
 
 void SerialPortHandler::AddHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
     assert(a_HdlcdServerHandler->GetBufferType() < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
-    ++(m_BufferTypeSubscribers[a_HdlcdServerHandler->GetBufferType()]);
     m_HdlcdServerHandlerList.push_back(a_HdlcdServerHandler);
+    SubscriptionsChanged();
     if ((m_ProtocolState) && (m_ProtocolState->IsRunning())) {
         // Trigger state update messages, to inform the freshly added client
         PropagateSerialPortState();
     } // if
 }
 
+void SerialPortHandler::RemoveHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
+    for (auto it = m_HdlcdServerHandlerList.begin(); it != m_HdlcdServerHandlerList.end(); ++it) {
+        if (*it == a_HdlcdServerHandler) {
+            // Keep the indices of all other clients stable while a fan-out is in progress
+            it->reset();
+            SubscriptionsChanged();
+            break;
+        } // if
+    } // for
+}
+
 void SerialPortHandler::SuspendSerialPort() {
     if (m_Registered == false) {
         return;
@@ -56,8 +81,8 @@ void SerialPortHandler::SuspendSerialPort() {
     if (m_SerialPortLock.SuspendSerialPort()) {
         // The serial port is now suspended!
         m_ProtocolState->Stop();
-        m_SerialPort.cancel();
-        m_SerialPort.close();
+        StopSerialIoThread();
+        m_LinkTransport->Close();
     } // if
     
     PropagateSerialPortState();
@@ -77,13 +102,26 @@ void SerialPortHandler::ResumeSerialPort() {
 }
 
 void SerialPortHandler::PropagateSerialPortState() {
-    ForEachHdlcdServerHandler([this](std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
-        a_HdlcdServerHandler->UpdateSerialPortState(m_ProtocolState->IsAlive(), m_SerialPortLock.GetLockHolders());
-    });
+    // Index-based iteration, as clients may register or deregister during the callback
+    auto self(shared_from_this());
+    ++m_FanOutDepth;
+    for (size_t l_Index = 0; l_Index < m_HdlcdServerHandlerList.size(); ++l_Index) {
+        if (auto l_HdlcdServerHandler = m_HdlcdServerHandlerList[l_Index]) {
+            l_HdlcdServerHandler->UpdateSerialPortState(m_ProtocolState->IsAlive(), m_SerialPortLock.GetLockHolders());
+        } // if
+    } // for
+    
+    EndFanOut();
 }
 
-void SerialPortHandler::DeliverPayloadToHDLC(const std::vector<unsigned char> &a_Payload, bool a_bReliable) {
-    m_ProtocolState->SendPayload(a_Payload, a_bReliable);
+std::string SerialPortHandler::GetSharedMemoryRingName(E_BUFFER_TYPE a_eBufferType) const {
+    // Empty if the ring could not be created
+    assert(a_eBufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
+    return (m_SharedMemoryRings[a_eBufferType] ? m_SharedMemoryRings[a_eBufferType]->GetName() : std::string());
+}
+
+void SerialPortHandler::DeliverPayloadToHDLC(const std::vector<unsigned char> &a_Payload, bool a_bReliable, PayloadConfirmationCallback a_OnConfirmation) {
+    m_ProtocolState->SendPayload(a_Payload, a_bReliable, std::move(a_OnConfirmation));
 }
 
 bool SerialPortHandler::RequiresBufferType(E_BUFFER_TYPE a_eBufferType) const {
@@ -91,14 +129,67 @@ bool SerialPortHandler::RequiresBufferType(E_BUFFER_TYPE a_eBufferType) const {
     return (m_BufferTypeSubscribers[a_eBufferType] != 0);
 }
 
-void SerialPortHandler::DeliverBufferToClients(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent) {
-    ForEachHdlcdServerHandler([a_eBufferType, &a_Payload, a_bReliable, a_bInvalid, a_bWasSent](std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
-        a_HdlcdServerHandler->DeliverBufferToClient(a_eBufferType, a_Payload, a_bReliable, a_bInvalid, a_bWasSent);
-    });
+bool SerialPortHandler::RequiresHdlcFrame(E_BUFFER_TYPE a_eBufferType) const {
+    assert(a_eBufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
+    return (m_BufferTypeFilters[a_eBufferType] != 0);
+}
+
+void SerialPortHandler::DeliverBufferToClients(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent, const HdlcFrame* a_HdlcFrame) {
+    // Only the clients that subscribed for exactly this kind of buffer are visited
+    assert(a_eBufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
+    auto self(shared_from_this());
+    ++m_FanOutDepth;
+    const auto& l_FilterGroups = m_Subscribers[a_eBufferType][GetSubscriptionIndex(a_bWasSent, a_bInvalid)];
+    if (m_SharedMemoryRings[a_eBufferType]) {
+        // Clients of the shared memory ring receive everything, they evaluate the flags of each record themselves
+        m_SharedMemoryRings[a_eBufferType]->Publish(a_Payload, a_bReliable, a_bInvalid, a_bWasSent);
+    } // if
+    
+    // Create the data packet only once, and only if it is delivered. All subscribers share this immutable object.
+    std::shared_ptr<const HdlcdPacketData> l_PacketData;
+    for (size_t l_GroupIndex = 0; l_GroupIndex < l_FilterGroups.size(); ++l_GroupIndex) {
+        const FilterGroup& l_FilterGroup = l_FilterGroups[l_GroupIndex];
+        if (l_FilterGroup.m_SubscriptionFilter) {
+            // Evaluate the filter once for all clients of this group
+            assert(a_HdlcFrame);
+            if ((!a_HdlcFrame) || (!l_FilterGroup.m_SubscriptionFilter->Matches(*a_HdlcFrame, a_bReliable))) {
+                continue;
+            } // if
+        } // if
+        
+        if (!l_PacketData) {
+            l_PacketData = std::make_shared<const HdlcdPacketData>(HdlcdPacketData::CreatePacket(a_Payload, a_bReliable, a_bInvalid, a_bWasSent));
+        } // if
+        
+        for (size_t l_Index = 0; l_Index < l_FilterGroup.m_HdlcdServerHandlers.size(); ++l_Index) {
+            l_FilterGroup.m_HdlcdServerHandlers[l_Index]->DeliverPacketToClient(l_PacketData);
+        } // for
+    } // for
+    
+    EndFanOut();
+}
+
+void SerialPortHandler::DeliverGapToClients(E_BUFFER_TYPE a_eBufferType, uint32_t a_DroppedFrames) {
+    // The dropped frames are unknown, thus filters cannot be evaluated. Each client of the buffer type is informed once.
+    assert(a_eBufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
+    auto self(shared_from_this());
+    ++m_FanOutDepth;
+    for (size_t l_Index = 0; l_Index < m_HdlcdServerHandlerList.size(); ++l_Index) {
+        auto l_HdlcdServerHandler = m_HdlcdServerHandlerList[l_Index];
+        if ((l_HdlcdServerHandler) && (l_HdlcdServerHandler->GetBufferType() == a_eBufferType) && (!l_HdlcdServerHandler->UsesSharedMemoryRing())) {
+            l_HdlcdServerHandler->ReportGap(a_DroppedFrames);
+        } // if
+    } // for
+    
+    EndFanOut();
 }
 
 bool SerialPortHandler::Start() {
     m_ProtocolState = std::make_shared<ProtocolState>(shared_from_this(), m_IOService);
+    if (auto l_SerialPortHandlerCollection = m_SerialPortHandlerCollection.lock()) {
+        m_bUsesSerialIoThread = l_SerialPortHandlerCollection->UsesSerialIoThread(m_SerialPortName, m_SerialIoThreadPriority, m_BusyPollMicroseconds);
+    } // if
+    
     return OpenSerialPort();
 }
 
@@ -108,39 +199,41 @@ void SerialPortHandler::Stop() {
         
         // Keep a copy here to keep this object alive!
         auto self(shared_from_this());
-        m_SerialPort.cancel();
-        m_SerialPort.close();
+        StopSerialIoThread();
+        m_LinkTransport->Close();
         m_ProtocolState->Shutdown();
+        if (m_ProtocolState->GetDroppedSnifferFrames()) {
+            std::cerr << "Serial port " << m_SerialPortName << " closed, " << m_ProtocolState->GetDroppedSnifferFrames()
+                      << " frames were dropped before delivery to RAW, DISSECTED, and STRUCTURED clients" << std::endl;
+        } // if
+        
         if (auto l_SerialPortHandlerCollection = m_SerialPortHandlerCollection.lock()) {
             l_SerialPortHandlerCollection->DeregisterSerialPortHandler(self);
         } // if
         
-        ForEachHdlcdServerHandler([](std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
-            a_HdlcdServerHandler->Stop();
-        });
+        StopHdlcdServerHandlers();
     } // if
 }
 
 bool SerialPortHandler::OpenSerialPort() {
-    bool l_bResult = true;
-    try {
-        // Open the serial port and start processing
-        m_SerialPort.open(m_SerialPortName);
-        m_SerialPort.set_option(boost::asio::serial_port::parity(boost::asio::serial_port::parity::none));
-        m_SerialPort.set_option(boost::asio::serial_port::character_size(boost::asio::serial_port::character_size(8)));
-        m_SerialPort.set_option(boost::asio::serial_port::stop_bits(boost::asio::serial_port::stop_bits::one));
-        m_SerialPort.set_option(boost::asio::serial_port::flow_control(boost::asio::serial_port::flow_control::none));
-        m_SerialPort.set_option(boost::asio::serial_port::baud_rate(m_BaudRate.GetBaudRate()));
-        
-        // Start processing
-        m_ProtocolState->Start();
-        DoRead();
-        
-        // Trigger first state update message
-        PropagateSerialPortState();
-    } catch (boost::system::system_error& error) {
-        std::cerr << error.what() << std::endl;
-        l_bResult = false;
+    // Open the serial port, processing starts as soon as it is open. Connecting to a terminal server may take a while.
+    auto self(shared_from_this());
+    m_LinkTransport->AsyncOpen(m_BaudRate.GetBaudRate(), [this, self](const boost::system::error_code& a_ErrorCode) {
+        OnSerialPortOpened(a_ErrorCode);
+    });
+    
+    // False if opening failed right away
+    return m_Registered;
+}
+
+void SerialPortHandler::OnSerialPortOpened(const boost::system::error_code& a_ErrorCode) {
+    if ((!m_Registered) || (a_ErrorCode == boost::asio::error::operation_aborted)) {
+        // Stopped or suspended meanwhile
+        return;
+    } // if
+    
+    if (a_ErrorCode) {
+        std::cerr << "Failed to open serial port " << m_SerialPortName << ": " << a_ErrorCode.message() << std::endl;
         m_Registered = false;
         
         // TODO: ugly, code duplication. We must assure that cancel is not called!
@@ -150,18 +243,24 @@ bool SerialPortHandler::OpenSerialPort() {
             l_SerialPortHandlerCollection->DeregisterSerialPortHandler(self);
         } // if
         
-        ForEachHdlcdServerHandler([](std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
-            a_HdlcdServerHandler->Stop();
-        });
-    } // catch
-
-    return l_bResult;
+        StopHdlcdServerHandlers();
+        return;
+    } // if
+    
+    // Start processing
+    m_ProtocolState->Start();
+    if ((!m_bUsesSerialIoThread) || (!StartSerialIoThread())) {
+        DoRead();
+    } // if
+    
+    // Trigger first state update message
+    PropagateSerialPortState();
 }
 
 void SerialPortHandler::ChangeBaudRate() {
     if (m_Registered) {
         m_BaudRate.ToggleBaudRate();
-        m_SerialPort.set_option(boost::asio::serial_port::baud_rate(m_BaudRate.GetBaudRate()));
+        m_LinkTransport->SetBaudRate(m_BaudRate.GetBaudRate());
     } // if
 }
 
@@ -169,6 +268,12 @@ void SerialPortHandler::TransmitHDLCFrame(const std::vector<unsigned char> &a_Pa
     // Copy buffer holding the escaped HDLC frame for transmission via the serial interface
     assert(m_SendBufferOffset == 0);
     assert(m_SerialPortLock.GetSerialPortState() == false);
+    if (m_SerialIoThread) {
+        // Handed over to the dedicated thread
+        m_SerialIoThread->TransmitFrame(a_Payload);
+        return;
+    } // if
+    
     m_SendBuffer = std::move(a_Payload);
     
     // Trigger transmission
@@ -176,14 +281,21 @@ void SerialPortHandler::TransmitHDLCFrame(const std::vector<unsigned char> &a_Pa
 }
 
 void SerialPortHandler::QueryForPayload(bool a_bQueryReliable, bool a_bQueryUnreliable) {
-    ForEachHdlcdServerHandler([a_bQueryReliable, a_bQueryUnreliable](std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
-        a_HdlcdServerHandler->QueryForPayload(a_bQueryReliable, a_bQueryUnreliable);
-    });
+    // Index-based iteration, as this may cause cyclic calls that register or deregister clients
+    auto self(shared_from_this());
+    ++m_FanOutDepth;
+    for (size_t l_Index = 0; l_Index < m_HdlcdServerHandlerList.size(); ++l_Index) {
+        if (auto l_HdlcdServerHandler = m_HdlcdServerHandlerList[l_Index]) {
+            l_HdlcdServerHandler->QueryForPayload(a_bQueryReliable, a_bQueryUnreliable);
+        } // if
+    } // for
+    
+    EndFanOut();
 }
 
 void SerialPortHandler::DoRead() {
     auto self(shared_from_this());
-    m_SerialPort.async_read_some(boost::asio::buffer(m_ReadBuffer, max_length),[this, self](boost::system::error_code a_ErrorCode, std::size_t a_BytesRead) {
+    m_LinkTransport->AsyncReadSome(m_ReadBuffer, max_length, [this, self](const boost::system::error_code& a_ErrorCode, std::size_t a_BytesRead) {
         if (!a_ErrorCode) {
             m_ProtocolState->AddReceivedRawBytes(m_ReadBuffer, a_BytesRead);
             if (m_SerialPortLock.GetSerialPortState() == false) {
@@ -200,7 +312,7 @@ void SerialPortHandler::DoRead() {
 
 void SerialPortHandler::DoWrite() {
     auto self(shared_from_this());
-    m_SerialPort.async_write_some(boost::asio::buffer(&m_SendBuffer[m_SendBufferOffset], (m_SendBuffer.size() - m_SendBufferOffset)),[this, self](boost::system::error_code a_ErrorCode, std::size_t a_BytesSent) {
+    m_LinkTransport->AsyncWriteSome(&m_SendBuffer[m_SendBufferOffset], (m_SendBuffer.size() - m_SendBufferOffset), [this, self](const boost::system::error_code& a_ErrorCode, std::size_t a_BytesSent) {
         if (!a_ErrorCode) {
             m_SendBufferOffset += a_BytesSent;
             if (m_SendBufferOffset == m_SendBuffer.size()) {
@@ -224,42 +336,148 @@ void SerialPortHandler::DoWrite() {
     });
 }
 
-void SerialPortHandler::ForEachHdlcdServerHandler(std::function<void(std::shared_ptr<HdlcdServerHandler>)> a_Function) {
-    assert(a_Function);
-    bool l_RebuildSubscriptions = false;
-    static bool s_bCyclicCallGuard = false;
-    for (auto cur = m_HdlcdServerHandlerList.begin(); cur != m_HdlcdServerHandlerList.end();) {
-        auto next = cur;
-        ++next;
-        if (auto l_ClientHandler = cur->lock()) {
-            // Be careful here, as there are cyclic calls back to this method resulting in an invalid "next" iterator!
-            bool l_bGuardLocked = false;
-            if (!s_bCyclicCallGuard) {
-                s_bCyclicCallGuard = true;
-                l_bGuardLocked = true;
-            } // if
+bool SerialPortHandler::StartSerialIoThread() {
+    // The callbacks are invoked via our event loop, and only as long as the dedicated thread is not stopped
+    assert(!m_SerialIoThread);
+    m_SerialIoThread = std::make_shared<SerialIoThread>(m_IOService, m_SerialIoThreadPriority, m_BusyPollMicroseconds);
+    m_SerialIoThread->SetOnFramesCallback([this](const std::vector<DeserializedFrame> &a_DeserializedFrames) {
+        m_ProtocolState->InterpretDeserializedFrames(a_DeserializedFrames);
+    });
+    
+    m_SerialIoThread->SetOnTransmittedCallback([this]() {
+        // Indicate that we are ready to transmit the next HDLC frame
+        if (m_SerialPortLock.GetSerialPortState() == false) {
+            m_ProtocolState->TriggerNextHDLCFrame();
+        } // if
+    });
+    
+    m_SerialIoThread->SetOnErrorCallback([this](const std::string &a_Error) {
+        if (m_SerialPortLock.GetSerialPortState() == false) {
+            std::cerr << a_Error << std::endl;
+            Stop();
+        } // if
+    });
+    
+    int l_FileDescriptor = m_LinkTransport->GetNativeHandle();
+    if ((l_FileDescriptor < 0) || (!m_SerialIoThread->Start(l_FileDescriptor))) {
+        // Fall back to the event loop
+        std::cerr << "Serial port " << m_SerialPortName << " is served by the event loop instead of a dedicated thread" << std::endl;
+        m_SerialIoThread.reset();
+        return false;
+    } // if
+    
+    return true;
+}
 
-            a_Function(l_ClientHandler);
-            if (l_bGuardLocked) {
-                s_bCyclicCallGuard = false;
-            } // if
-        } else {
-            // Outdated entry. Only remove it if this is not a cyclic call
-            if (!s_bCyclicCallGuard) {
-                m_HdlcdServerHandlerList.erase(cur);
-                l_RebuildSubscriptions = true;
-            } // if
-        } // else
+void SerialPortHandler::StopSerialIoThread() {
+    if (m_SerialIoThread) {
+        m_SerialIoThread->Stop();
+        if (m_BusyPollMicroseconds) {
+            // Report what busy polling did cost
+            std::cerr << "Serial port " << m_SerialPortName << " closed, the dedicated thread consumed " << (m_SerialIoThread->GetCpuNanoseconds() / 1000000)
+                      << " ms CPU time, " << (m_SerialIoThread->GetBusyPollNanoseconds() / 1000000) << " ms thereof spinning, "
+                      << m_SerialIoThread->GetBusyPollReads() << " reads were served while spinning" << std::endl;
+        } // if
         
-        cur = next;
+        m_SerialIoThread.reset();
+    } // if
+}
+
+void SerialPortHandler::SubscriptionsChanged() {
+    // The subscription lists must not change while a fan-out iterates over them
+    if (m_FanOutDepth) {
+        m_bSubscriptionsChanged = true;
+    } else {
+        RebuildSubscriptions();
+    } // else
+}
+
+void SerialPortHandler::EndFanOut() {
+    // Apply the registrations and deregistrations that happened during the fan-out
+    assert(m_FanOutDepth);
+    if ((--m_FanOutDepth == 0) && (m_bSubscriptionsChanged)) {
+        RebuildSubscriptions();
+    } // if
+}
+
+void SerialPortHandler::RebuildSubscriptions() {
+    // Rebuild the subscription database. This happens only if a client registers or deregisters.
+    assert(m_FanOutDepth == 0);
+    m_bSubscriptionsChanged = false;
+    m_HdlcdServerHandlerList.erase(std::remove(m_HdlcdServerHandlerList.begin(), m_HdlcdServerHandlerList.end(), nullptr), m_HdlcdServerHandlerList.end());
+    ::memset(m_BufferTypeSubscribers, 0x00, sizeof(m_BufferTypeSubscribers));
+    ::memset(m_BufferTypeFilters, 0x00, sizeof(m_BufferTypeFilters));
+    for (size_t l_BufferType = 0; l_BufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER; ++l_BufferType) {
+        for (size_t l_SubscriptionIndex = 0; l_SubscriptionIndex < 4; ++l_SubscriptionIndex) {
+            m_Subscribers[l_BufferType][l_SubscriptionIndex].clear();
+        } // for
+    } // for
+
+    size_t l_RingReaders[BUFFER_TYPE_ARITHMETIC_ENDMARKER] = {};
+    for (auto it = m_HdlcdServerHandlerList.begin(); it != m_HdlcdServerHandlerList.end(); ++it) {
+        E_BUFFER_TYPE l_eBufferType = (*it)->GetBufferType();
+        assert(l_eBufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
+        ++(m_BufferTypeSubscribers[l_eBufferType]);
+        if ((*it)->UsesSharedMemoryRing()) {
+            // Served via the shared memory ring of this buffer type, not via the TCP socket
+            ++(l_RingReaders[l_eBufferType]);
+            continue;
+        } // if
+        
+        auto l_SubscriptionFilter = (*it)->GetSubscriptionFilter();
+        if (l_SubscriptionFilter) {
+            ++(m_BufferTypeFilters[l_eBufferType]);
+        } // if
+        
+        for (int l_WasSent = 0; l_WasSent < 2; ++l_WasSent) {
+            for (int l_Invalid = 0; l_Invalid < 2; ++l_Invalid) {
+                if ((*it)->WantsBuffer(l_WasSent, l_Invalid)) {
+                    // Join the filter group with an identical filter, or create a new one
+                    auto& l_FilterGroups = m_Subscribers[l_eBufferType][GetSubscriptionIndex(l_WasSent, l_Invalid)];
+                    auto l_FilterGroup = l_FilterGroups.begin();
+                    for (; l_FilterGroup != l_FilterGroups.end(); ++l_FilterGroup) {
+                        if ((!l_FilterGroup->m_SubscriptionFilter) && (!l_SubscriptionFilter)) {
+                            break;
+                        } // if
+                        
+                        if ((l_FilterGroup->m_SubscriptionFilter) && (l_SubscriptionFilter) && (l_FilterGroup->m_SubscriptionFilter->IsEqual(*l_SubscriptionFilter))) {
+                            break;
+                        } // if
+                    } // for
+                    
+                    if (l_FilterGroup == l_FilterGroups.end()) {
+                        l_FilterGroups.emplace_back();
+                        l_FilterGroups.back().m_SubscriptionFilter = l_SubscriptionFilter;
+                        l_FilterGroup = (l_FilterGroups.end() - 1);
+                    } // if
+                    
+                    l_FilterGroup->m_HdlcdServerHandlers.push_back(*it);
+                } // if
+            } // for
+        } // for
     } // for
     
-    if (l_RebuildSubscriptions) {
-        // Rebuild the subscription database
-        ::memset(m_BufferTypeSubscribers, 0x00, sizeof(m_BufferTypeSubscribers));
-        ForEachHdlcdServerHandler([this](std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
-            assert(a_HdlcdServerHandler->GetBufferType() < BUFFER_TYPE_ARITHMETIC_ENDMARKER);
-            ++(m_BufferTypeSubscribers[a_HdlcdServerHandler->GetBufferType()]);
-        });
-    } // if
+    // Create the shared memory rings that have readers now, and abandon the ones without readers
+    for (size_t l_BufferType = 0; l_BufferType < BUFFER_TYPE_ARITHMETIC_ENDMARKER; ++l_BufferType) {
+        if ((l_RingReaders[l_BufferType]) && (!m_SharedMemoryRings[l_BufferType])) {
+            auto l_SharedMemoryRing = std::make_shared<SharedMemoryRing>(m_IOService);
+            if (l_SharedMemoryRing->Create()) {
+                m_SharedMemoryRings[l_BufferType] = l_SharedMemoryRing;
+            } // if
+        } else if ((!l_RingReaders[l_BufferType]) && (m_SharedMemoryRings[l_BufferType])) {
+            m_SharedMemoryRings[l_BufferType].reset();
+        } // else if
+    } // for
+}
+
+void SerialPortHandler::StopHdlcdServerHandlers() {
+    // Detach all clients first, as each of them deregisters itself while stopping
+    std::vector<std::shared_ptr<HdlcdServerHandler>> l_HdlcdServerHandlerList;
+    l_HdlcdServerHandlerList.swap(m_HdlcdServerHandlerList);
+    SubscriptionsChanged();
+    for (auto it = l_HdlcdServerHandlerList.begin(); it != l_HdlcdServerHandlerList.end(); ++it) {
+        if (*it) {
+            (*it)->Stop();
+        } // if
+    } // for
 }
@@ -25,14 +25,18 @@
 #include <memory>
 #include <string>
 #include <vector>
-#include <list>
 #include <boost/asio.hpp>
 #include "ISerialPortHandler.h"
+#include "PayloadConfirmation.h"
 #include "SerialPortLock.h"
 #include "BaudRate.h"
 class SerialPortHandlerCollection;
 class HdlcdServerHandler;
+class SubscriptionFilter;
 class ProtocolState;
+class SharedMemoryRing;
+class SerialIoThread;
+class LinkTransport;
 
 class SerialPortHandler: public ISerialPortHandler, public std::enable_shared_from_this<SerialPortHandler> {
 public:
@@ -41,7 +45,8 @@ public:
     ~SerialPortHandler();
     
     void AddHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler);
-    void DeliverPayloadToHDLC(const std::vector<unsigned char> &a_Payload, bool a_bReliable);
+    void RemoveHdlcdServerHandler(std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler);
+    void DeliverPayloadToHDLC(const std::vector<unsigned char> &a_Payload, bool a_bReliable, PayloadConfirmationCallback a_OnConfirmation = nullptr);
     
     bool Start();
     void Stop();
@@ -51,12 +56,17 @@ public:
     void ResumeSerialPort();
     
     void PropagateSerialPortState();
+    const std::string& GetSerialPortName() const { return m_SerialPortName; }
+    std::string GetSharedMemoryRingName(E_BUFFER_TYPE a_eBufferType) const;
 
 private:
     // Called by a ProtocolState object
     bool RequiresBufferType(E_BUFFER_TYPE a_eBufferType) const;
-    void DeliverBufferToClients(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent);
+    bool RequiresHdlcFrame(E_BUFFER_TYPE a_eBufferType) const;
+    void DeliverBufferToClients(E_BUFFER_TYPE a_eBufferType, const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent, const HdlcFrame* a_HdlcFrame);
+    void DeliverGapToClients(E_BUFFER_TYPE a_eBufferType, uint32_t a_DroppedFrames);
     bool OpenSerialPort();
+    void OnSerialPortOpened(const boost::system::error_code& a_ErrorCode);
     void ChangeBaudRate();
     void TransmitHDLCFrame(const std::vector<unsigned char> &a_Payload);
     void QueryForPayload(bool a_bQueryReliable, bool a_bQueryUnreliable);
@@ -64,16 +74,26 @@ private:
     // Internal helpers
     void DoRead();
     void DoWrite();
-    void ForEachHdlcdServerHandler(std::function<void(std::shared_ptr<HdlcdServerHandler>)> a_Function);
+    bool StartSerialIoThread();
+    void StopSerialIoThread();
+    void SubscriptionsChanged();
+    void RebuildSubscriptions();
+    void EndFanOut();
+    void StopHdlcdServerHandlers();
+    static size_t GetSubscriptionIndex(bool a_bWasSent, bool a_bInvalid) { return ((a_bWasSent ? 2 : 0) | (a_bInvalid ? 1 : 0)); }
     
     // Members
     bool m_Registered;
-    boost::asio::serial_port m_SerialPort;
+    std::shared_ptr<LinkTransport> m_LinkTransport;
     boost::asio::io_service &m_IOService;
     std::shared_ptr<ProtocolState> m_ProtocolState;
     std::string m_SerialPortName;
     std::weak_ptr<SerialPortHandlerCollection> m_SerialPortHandlerCollection;
-    std::list<std::weak_ptr<HdlcdServerHandler>> m_HdlcdServerHandlerList;
+    
+    // All registered clients. Each client holds a strong reference to this object as well, thus a client must be stopped
+    // via HdlcdServerHandler::Stop() to be removed. A client that is just released keeps itself and this object alive.
+    // Entries of clients that deregister during a fan-out are cleared, not erased, until the fan-out is completed.
+    std::vector<std::shared_ptr<HdlcdServerHandler>> m_HdlcdServerHandlerList;
     enum { max_length = 1024 };
     unsigned char m_ReadBuffer[max_length];
     
@@ -82,8 +102,27 @@ private:
     SerialPortLock m_SerialPortLock;
     BaudRate m_BaudRate;
     
-    // Track all subscribed clients
+    // Optional: the serial port is read and written via a dedicated thread that also parses the frames
+    bool m_bUsesSerialIoThread;
+    int m_SerialIoThreadPriority;
+    unsigned int m_BusyPollMicroseconds;
+    std::shared_ptr<SerialIoThread> m_SerialIoThread;
+    
+    // Track all subscribed clients. For each buffer type, direction, and validity, only the clients that receive it are listed.
+    // Clients with identical filters form a filter group, thus each filter is evaluated only once per frame.
+    // While a fan-out iterates over the clients, which may register or deregister in between, a rebuild is deferred.
+    typedef struct {
+        std::shared_ptr<const SubscriptionFilter> m_SubscriptionFilter; // Empty if all frames are accepted
+        std::vector<std::shared_ptr<HdlcdServerHandler>> m_HdlcdServerHandlers;
+    } FilterGroup;
     size_t m_BufferTypeSubscribers[BUFFER_TYPE_ARITHMETIC_ENDMARKER];
+    size_t m_BufferTypeFilters[BUFFER_TYPE_ARITHMETIC_ENDMARKER];
+    std::vector<FilterGroup> m_Subscribers[BUFFER_TYPE_ARITHMETIC_ENDMARKER][4];
+    size_t m_FanOutDepth;          // Number of nested iterations over the clients
+    bool m_bSubscriptionsChanged;  // A client registered or deregistered during a fan-out
+    
+    // Shared memory rings, one per buffer type, only existing as long as a client reads from it
+    std::shared_ptr<SharedMemoryRing> m_SharedMemoryRings[BUFFER_TYPE_ARITHMETIC_ENDMARKER];
 };
 
 #endif // SERIAL_PORT_HANDLER_H
@@ -22,23 +22,159 @@
 #include "SerialPortHandlerCollection.h"
 #include "SerialPortHandler.h"
 #include "HdlcdServerHandler.h"
+#include "IoServicePool.h"
+#include "LinkTransport.h"
+#include <iostream>
 
-SerialPortHandlerCollection::SerialPortHandlerCollection(boost::asio::io_service& a_IOService): m_IOService(a_IOService) {
+SerialPortHandlerCollection::SerialPortHandlerCollection(const IoServicePool& a_IoServicePool): m_IoServicePool(a_IoServicePool) {
+    m_NextIOService = 0;
 }
 
 void SerialPortHandlerCollection::Shutdown() {
     // No need to cleanup, this class possesses only weak pointers
 }
 
-std::shared_ptr<std::shared_ptr<SerialPortHandler>> SerialPortHandlerCollection::GetSerialPortHandler(const std::string &a_SerialPortName, std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler) {
+size_t SerialPortHandlerCollection::GetIOServiceCount() const {
+    return m_IoServicePool.GetSize();
+}
+
+bool SerialPortHandlerCollection::AssignIOService(const std::string &a_SerialPortName, size_t a_Index) {
+    // Configured placement, before any client connects
+    if (a_Index >= m_IoServicePool.GetSize()) {
+        return false;
+    } // if
+    
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
+    m_IOServicePlacements[a_SerialPortName] = a_Index;
+    return true;
+}
+
+boost::asio::io_service& SerialPortHandlerCollection::GetIOService(const std::string &a_SerialPortName) {
+    // Nothing to assign if there is only one event loop
+    if (m_IoServicePool.GetSize() == 1) {
+        return m_IoServicePool.GetIOService(0);
+    } // if
+    
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
+    auto l_PlacementIt = m_IOServicePlacements.find(a_SerialPortName);
+    if (l_PlacementIt != m_IOServicePlacements.end()) {
+        return m_IoServicePool.GetIOService(l_PlacementIt->second);
+    } // if
+    
+    auto l_AssignmentIt = m_IOServiceAssignments.find(a_SerialPortName);
+    if (l_AssignmentIt != m_IOServiceAssignments.end()) {
+        return m_IoServicePool.GetIOService(l_AssignmentIt->second);
+    } // if
+    
+    // Assign the serial port to the next event loop on first use. Serial ports that will be rejected are not recorded.
+    size_t l_IOService = m_NextIOService;
+    m_NextIOService = ((m_NextIOService + 1) % m_IoServicePool.GetSize());
+    if (IsTransportAllowed(a_SerialPortName)) {
+        m_IOServiceAssignments[a_SerialPortName] = l_IOService;
+    } // if
+    
+    return m_IoServicePool.GetIOService(l_IOService);
+}
+
+boost::asio::io_service& SerialPortHandlerCollection::GetNextIOService() {
+    // For sessions that are not bound to a serial port
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
+    size_t l_IOService = m_NextIOService;
+    m_NextIOService = ((m_NextIOService + 1) % m_IoServicePool.GetSize());
+    return m_IoServicePool.GetIOService(l_IOService);
+}
+
+void SerialPortHandlerCollection::EnableSerialIoThread(const std::string &a_SerialPortName, int a_Priority, unsigned int a_BusyPollMicroseconds) {
+    // Configured before any client connects, effective whenever the serial port is opened
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
+    m_SerialIoThreads[a_SerialPortName] = std::make_pair(a_Priority, a_BusyPollMicroseconds);
+}
+
+bool SerialPortHandlerCollection::UsesSerialIoThread(const std::string &a_SerialPortName, int &a_Priority, unsigned int &a_BusyPollMicroseconds) {
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
+    auto l_SerialIoThreadIt = m_SerialIoThreads.find(a_SerialPortName);
+    if (l_SerialIoThreadIt == m_SerialIoThreads.end()) {
+        return false;
+    } // if
+    
+    a_Priority = l_SerialIoThreadIt->second.first;
+    a_BusyPollMicroseconds = l_SerialIoThreadIt->second.second;
+    return true;
+}
+
+bool SerialPortHandlerCollection::AllowTransport(const std::string &a_Scheme) {
+    // Serial port devices are always allowed
+    if ((a_Scheme != "tcp") && (a_Scheme != "rfc2217") && (a_Scheme != "unix") && (a_Scheme != "pty")) {
+        return false;
+    } // if
+    
+    m_AllowedTransports.insert(a_Scheme);
+    return true;
+}
+
+bool SerialPortHandlerCollection::SetPtyLinkDirectory(const std::string &a_Directory) {
+    // An absolute path, stored without trailing slashes
+    size_t l_Length = a_Directory.find_last_not_of('/');
+    if ((a_Directory.empty()) || (a_Directory[0] != '/') || (l_Length == std::string::npos)) {
+        return false;
+    } // if
+    
+    m_PtyLinkDirectory = a_Directory.substr(0, l_Length + 1);
+    return true;
+}
+
+bool SerialPortHandlerCollection::IsTransportAllowed(const std::string &a_SerialPortName) const {
+    std::string l_Scheme = LinkTransport::GetScheme(a_SerialPortName);
+    if (l_Scheme.empty()) {
+        return true;
+    } // if
+    
+    if (m_AllowedTransports.find(l_Scheme) == m_AllowedTransports.end()) {
+        return false;
+    } // if
+    
+    if (l_Scheme == "pty") {
+        // The HDLCd replaces and removes the link, thus it must be a plain name within the configured directory
+        std::string l_LinkPath = a_SerialPortName.substr(4);
+        if (l_LinkPath.empty()) {
+            return true;
+        } // if
+        
+        if ((m_PtyLinkDirectory.empty()) || (l_LinkPath.compare(0, m_PtyLinkDirectory.size() + 1, m_PtyLinkDirectory + "/") != 0)) {
+            return false;
+        } // if
+        
+        std::string l_LinkName = l_LinkPath.substr(m_PtyLinkDirectory.size() + 1);
+        return ((!l_LinkName.empty()) && (l_LinkName != ".") && (l_LinkName != "..") && (l_LinkName.find('/') == std::string::npos));
+    } // if
+    
+    return true;
+}
+
+std::shared_ptr<std::shared_ptr<SerialPortHandler>> SerialPortHandlerCollection::GetSerialPortHandler(const std::string &a_SerialPortName, std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler,
+                                                                                                       boost::asio::io_service& a_IOService) {
     std::shared_ptr<std::shared_ptr<SerialPortHandler>> l_SerialPortHandler;
+    if (!IsTransportAllowed(a_SerialPortName)) {
+        std::cerr << "Serial port " << a_SerialPortName << " rejected, its transport is not allowed, see --allow-transport and --pty-dir" << std::endl;
+        return l_SerialPortHandler;
+    } // if
+    
+    // The round-robin assignment of the serial port may have been released and reassigned meanwhile, e.g., if the
+    // serial port was closed while the client was handed over to the event loop of the previous assignment.
+    auto& l_IOService = GetIOService(a_SerialPortName);
+    if (&l_IOService != &a_IOService) {
+        std::cerr << "Serial port " << a_SerialPortName << " was reassigned to another event loop, closing the session" << std::endl;
+        return l_SerialPortHandler;
+    } // if
+    
     bool l_HasToBeStarted = false;
     {
         // This is some magic here to implement automatic cleanup
+        std::lock_guard<std::mutex> l_Lock(m_Mutex);
         auto& l_SerialPortHandlerWeak(m_SerialPortHandlerMap[a_SerialPortName]);
         l_SerialPortHandler = l_SerialPortHandlerWeak.lock();
         if (!l_SerialPortHandler) {
-            auto l_NewSerialPortHandler = std::make_shared<SerialPortHandler>(a_SerialPortName, shared_from_this(), m_IOService);
+            auto l_NewSerialPortHandler = std::make_shared<SerialPortHandler>(a_SerialPortName, shared_from_this(), l_IOService);
             std::shared_ptr<std::shared_ptr<SerialPortHandler>> l_NewSerialPortHandlerStopper(new std::shared_ptr<SerialPortHandler>(l_NewSerialPortHandler), [=](std::shared_ptr<SerialPortHandler>* todelete){ (*todelete)->Stop(); delete(todelete); });
             l_SerialPortHandler = l_NewSerialPortHandlerStopper;
             l_SerialPortHandlerWeak = l_SerialPortHandler;
@@ -57,13 +193,15 @@ std::shared_ptr<std::shared_ptr<SerialPortHandler>> SerialPortHandlerCollection:
 }
 
 void SerialPortHandlerCollection::DeregisterSerialPortHandler(std::shared_ptr<SerialPortHandler> a_SerialPortHandler) {
+    // Only the entry of this serial port is visited. The entries of other serial ports belong to other event loops.
     assert(a_SerialPortHandler);
-    for (auto it = m_SerialPortHandlerMap.begin(); it != m_SerialPortHandlerMap.end(); ++it) {
-        if (auto cph = it->second.lock()) {
-            if (*(cph.get()) == a_SerialPortHandler) {
-                m_SerialPortHandlerMap.erase(it);
-                break;
-            } // if
+    std::lock_guard<std::mutex> l_Lock(m_Mutex);
+    auto it = m_SerialPortHandlerMap.find(a_SerialPortHandler->GetSerialPortName());
+    if (it != m_SerialPortHandlerMap.end()) {
+        auto cph = it->second.lock();
+        if ((!cph) || (*(cph.get()) == a_SerialPortHandler)) {
+            m_SerialPortHandlerMap.erase(it);
+            m_IOServiceAssignments.erase(a_SerialPortHandler->GetSerialPortName());
         } // if
-    } // for
+    } // if
 }
@@ -25,25 +25,58 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <set>
+#include <mutex>
 #include <boost/asio.hpp>
 class HdlcdServerHandler;
 class SerialPortHandler;
+class IoServicePool;
 
 class SerialPortHandlerCollection: public std::enable_shared_from_this<SerialPortHandlerCollection> {
 public:
     // CTOR and resetter
-    SerialPortHandlerCollection(boost::asio::io_service& a_IOService);
+    SerialPortHandlerCollection(const IoServicePool& a_IoServicePool);
     void Shutdown();
     
-    std::shared_ptr<std::shared_ptr<SerialPortHandler>> GetSerialPortHandler(const std::string &a_SerialPortName, std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler);
+    // Each serial port is served by one event loop, together with all clients that access it
+    size_t GetIOServiceCount() const;
+    bool AssignIOService(const std::string &a_SerialPortName, size_t a_Index);
+    boost::asio::io_service& GetIOService(const std::string &a_SerialPortName);
+    boost::asio::io_service& GetNextIOService();
+    
+    // Serial ports that are read and written via a dedicated thread, optionally with real-time priority
+    void EnableSerialIoThread(const std::string &a_SerialPortName, int a_Priority, unsigned int a_BusyPollMicroseconds = 0);
+    bool UsesSerialIoThread(const std::string &a_SerialPortName, int &a_Priority, unsigned int &a_BusyPollMicroseconds);
+    
+    // Transports other than serial port devices, see LinkTransport. They are selected by the clients, thus disabled by default.
+    bool AllowTransport(const std::string &a_Scheme);
+    bool SetPtyLinkDirectory(const std::string &a_Directory);
+    bool IsTransportAllowed(const std::string &a_SerialPortName) const;
+    
+    // To be called via the event loop returned by GetIOService() for the serial port, which is passed for verification
+    std::shared_ptr<std::shared_ptr<SerialPortHandler>> GetSerialPortHandler(const std::string &a_SerialPortName, std::shared_ptr<HdlcdServerHandler> a_HdlcdServerHandler,
+                                                                             boost::asio::io_service& a_IOService);
     
     // To be called by a SerialPortHandler
     void DeregisterSerialPortHandler(std::shared_ptr<SerialPortHandler> a_SerialPortHandler);
 
 private:
     // Members
-    boost::asio::io_service& m_IOService;
+    const IoServicePool& m_IoServicePool;
+    std::mutex m_Mutex; //!< The serial port handlers and the assignments are accessed via all event loops
     std::map<std::string, std::weak_ptr<std::shared_ptr<SerialPortHandler>>> m_SerialPortHandlerMap;
+    
+    // The configured placement of serial ports to event loops, kept for the lifetime of the daemon. Serial ports without
+    // a configured placement are assigned round-robin on first use, and released if their serial port handler deregisters.
+    // Thus, all clients of a serial port meet on the same event loop as long as the serial port is in use.
+    std::map<std::string, size_t> m_IOServicePlacements;
+    std::map<std::string, size_t> m_IOServiceAssignments;
+    size_t m_NextIOService;
+    // The SCHED_FIFO priority and the busy polling budget of each serial port with a dedicated thread
+    std::map<std::string, std::pair<int, unsigned int>> m_SerialIoThreads;
+    // The allowed transports, and the only directory in which pseudo terminals may be linked. Both are set before any client connects.
+    std::set<std::string> m_AllowedTransports;
+    std::string m_PtyLinkDirectory;
 };
 
 #endif // SERIAL_PORT_HANDLER_COLLECTION_H
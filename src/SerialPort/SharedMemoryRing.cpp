@@ -0,0 +1,162 @@
+/**
+ * \file SharedMemoryRing.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SharedMemoryRing.h"
+#include <algorithm>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+SharedMemoryRing::SharedMemoryRing(boost::asio::io_service& a_IOService): m_IOService(a_IOService) {
+    m_FileDescriptor = -1;
+    m_MappedSize = 0;
+    m_RingHeader = NULL;
+    m_Slots = NULL;
+    m_Head = 0;
+    m_bWakeupPending = false;
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    Destroy();
+}
+
+bool SharedMemoryRing::IsSupported() {
+#if defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SharedMemoryRing::Create() {
+#if defined(__linux__)
+    // Each ring gets a unique name
+    static std::atomic<unsigned int> s_RingCounter(0);
+    std::stringstream l_Name;
+    l_Name << "/hdlcd-" << ::getpid() << "-" << (s_RingCounter++);
+    m_Name = l_Name.str();
+    
+    // Clients need write access to register themselves as waiters
+    m_MappedSize = (sizeof(RingHeader) + (slot_count * slot_size));
+    m_FileDescriptor = ::shm_open(m_Name.c_str(), (O_RDWR | O_CREAT | O_EXCL), 0660);
+    if (m_FileDescriptor < 0) {
+        std::cerr << "Failed to create the shared memory ring " << m_Name << ": " << ::strerror(errno) << std::endl;
+        m_Name.clear();
+        return false;
+    } // if
+    
+    void* l_Memory = MAP_FAILED;
+    if (::ftruncate(m_FileDescriptor, m_MappedSize) == 0) {
+        l_Memory = ::mmap(NULL, m_MappedSize, (PROT_READ | PROT_WRITE), MAP_SHARED, m_FileDescriptor, 0);
+    } // if
+    
+    if (l_Memory == MAP_FAILED) {
+        std::cerr << "Failed to map the shared memory ring " << m_Name << ": " << ::strerror(errno) << std::endl;
+        Destroy();
+        return false;
+    } // if
+    
+    // The mapping is zero-filled: all slots are empty. Publish the layout last.
+    m_RingHeader = new (l_Memory) RingHeader();
+    m_Slots = (static_cast<unsigned char*>(l_Memory) + sizeof(RingHeader));
+    m_RingHeader->m_SlotCount = slot_count;
+    m_RingHeader->m_SlotSize = slot_size;
+    m_RingHeader->m_Version = ring_version;
+    std::atomic_thread_fence(std::memory_order_release);
+    m_RingHeader->m_Magic = ring_magic;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SharedMemoryRing::Publish(const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent) {
+    // Single producer: write the record into the oldest slot, protected by its sequence number
+    if (!m_RingHeader) {
+        return;
+    } // if
+    
+    unsigned char* l_Slot = (m_Slots + ((m_Head & (slot_count - 1)) * slot_size));
+    SlotHeader* l_SlotHeader = reinterpret_cast<SlotHeader*>(l_Slot);
+    size_t l_StoredSize = std::min(a_Payload.size(), (size_t)(slot_size - sizeof(SlotHeader)));
+    l_SlotHeader->m_Sequence.store(((2 * m_Head) + 1), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    l_SlotHeader->m_PayloadSize = a_Payload.size();
+    l_SlotHeader->m_StoredSize = l_StoredSize;
+    l_SlotHeader->m_Type = ((a_bReliable ? 0x04 : 0x00) | (a_bInvalid ? 0x02 : 0x00) | (a_bWasSent ? 0x01 : 0x00));
+    if (l_StoredSize) {
+        ::memcpy(l_Slot + sizeof(SlotHeader), a_Payload.data(), l_StoredSize);
+    } // if
+    
+    l_SlotHeader->m_Sequence.store(((2 * m_Head) + 2), std::memory_order_release);
+    
+    // Sequentially consistent, as clients increment the number of waiters before they check the head a last time
+    m_RingHeader->m_Head.store(++m_Head);
+    
+    // Wake up waiting clients once per turn of the event loop, thus a burst of records costs a single system call
+    if ((m_RingHeader->m_Waiters.load()) && (!m_bWakeupPending)) {
+        m_bWakeupPending = true;
+        auto self(shared_from_this());
+        m_IOService.post([this, self]() {
+            m_bWakeupPending = false;
+            Wakeup();
+        });
+    } // if
+}
+
+void SharedMemoryRing::Wakeup() {
+#if defined(__linux__)
+    if (m_RingHeader) {
+        m_RingHeader->m_Futex.fetch_add(1, std::memory_order_release);
+        ::syscall(SYS_futex, &m_RingHeader->m_Futex, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+    } // if
+#endif
+}
+
+void SharedMemoryRing::Destroy() {
+#if defined(__linux__)
+    if (m_RingHeader) {
+        // Tell the clients that no further records follow
+        m_RingHeader->m_Closed.store(1, std::memory_order_release);
+        Wakeup();
+        ::munmap(m_RingHeader, m_MappedSize);
+        m_RingHeader = NULL;
+        m_Slots = NULL;
+    } // if
+    
+    if (m_FileDescriptor >= 0) {
+        ::close(m_FileDescriptor);
+        ::shm_unlink(m_Name.c_str());
+        m_FileDescriptor = -1;
+    } // if
+#endif
+}
@@ -0,0 +1,91 @@
+/**
+ * \file SharedMemoryRing.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/asio.hpp>
+
+/*! \class SharedMemoryRing
+ *  \brief Class SharedMemoryRing
+ * 
+ *  A memory-mapped single-producer / multi-consumer ring of data packets, shared with co-located clients. The HDLCd
+ *  writes each data packet of one buffer type of a serial port into the next slot, overwriting the oldest one. Clients
+ *  read the slots in place and detect lost or overwritten records via sequence numbers. Waiting clients are woken up
+ *  via a futex word within the ring. See doc/protocol.txt for the memory layout.
+ */
+class SharedMemoryRing: public std::enable_shared_from_this<SharedMemoryRing> {
+public:
+    // CTOR, DTOR, and factory
+    SharedMemoryRing(boost::asio::io_service& a_IOService);
+    ~SharedMemoryRing();
+    static bool IsSupported();
+    bool Create();
+    
+    const std::string& GetName() const { return m_Name; }
+    void Publish(const std::vector<unsigned char> &a_Payload, bool a_bReliable, bool a_bInvalid, bool a_bWasSent);
+    
+private:
+    // Internal helpers
+    void Wakeup();
+    void Destroy();
+    
+    // The memory layout, all fields in host byte order
+    enum { ring_magic = 0x48444C43 }; // "HDLC"
+    enum { ring_version = 1 };
+    enum { slot_count = 2048 };       // Must be a power of two
+    enum { slot_size = 2048 };        // Including the slot header
+    typedef struct {
+        uint32_t m_Magic;
+        uint32_t m_Version;
+        uint32_t m_SlotCount;
+        uint32_t m_SlotSize;
+        std::atomic<uint64_t> m_Head;    // The number of published records
+        std::atomic<uint32_t> m_Futex;   // Changes if new records were published
+        std::atomic<uint32_t> m_Waiters; // The number of clients waiting on the futex word
+        std::atomic<uint32_t> m_Closed;  // Set to 1 if the ring is abandoned by the HDLCd
+        uint8_t m_Reserved[28];
+    } RingHeader;
+    typedef struct {
+        std::atomic<uint64_t> m_Sequence; // 2n+1 while record n is written, 2n+2 if record n is complete
+        uint32_t m_PayloadSize;           // The size of the payload of the data packet
+        uint32_t m_StoredSize;            // The number of payload bytes stored in this slot, may be truncated
+        uint8_t  m_Type;                  // The type byte of the data packet: content 0x0* and the flags
+        uint8_t  m_Reserved[7];
+    } SlotHeader;
+    
+    // Members
+    boost::asio::io_service& m_IOService;
+    std::string m_Name;
+    int m_FileDescriptor;
+    size_t m_MappedSize;
+    RingHeader* m_RingHeader;
+    unsigned char* m_Slots;
+    uint64_t m_Head;
+    bool m_bWakeupPending;
+};
+
+#endif // SHARED_MEMORY_RING_H
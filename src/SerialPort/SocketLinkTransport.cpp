@@ -0,0 +1,133 @@
+/**
+ * \file SocketLinkTransport.cpp
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SocketLinkTransport.h"
+#include <boost/system/system_error.hpp>
+
+SocketLinkTransport::SocketLinkTransport(boost::asio::io_service& a_IOService, E_SOCKET_TYPE a_eSocketType, const std::string &a_Address): m_IOService(a_IOService),
+    m_Socket(a_IOService), m_eSocketType(a_eSocketType), m_Address(a_Address), m_Resolver(a_IOService), m_OpenRequests(0) {
+}
+
+void SocketLinkTransport::AsyncOpen(unsigned int, OpenHandler a_OpenHandler) {
+    // The baud rate is up to the terminal server. Neither resolving nor connecting blocks the event loop.
+    unsigned int l_OpenRequest = ++m_OpenRequests;
+    auto l_Endpoints = std::make_shared<Endpoints>();
+    if (m_eSocketType == SOCKET_TYPE_UNIX) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        l_Endpoints->emplace_back(boost::asio::local::stream_protocol::endpoint(m_Address));
+        ConnectNext(l_Endpoints, 0, l_OpenRequest, a_OpenHandler);
+#else
+        a_OpenHandler(boost::asio::error::operation_not_supported);
+#endif
+        return;
+    } // if
+    
+    // "host:port", the host may be an IPv6 address in brackets
+    size_t l_Separator = m_Address.rfind(':');
+    if ((l_Separator == std::string::npos) || (l_Separator == 0) || (l_Separator + 1 == m_Address.size())) {
+        a_OpenHandler(boost::asio::error::invalid_argument);
+        return;
+    } // if
+    
+    std::string l_Host = m_Address.substr(0, l_Separator);
+    if ((l_Host.size() > 2) && (l_Host.front() == '[') && (l_Host.back() == ']')) {
+        l_Host = l_Host.substr(1, l_Host.size() - 2);
+    } // if
+    
+    m_Resolver.async_resolve(boost::asio::ip::tcp::resolver::query(l_Host, m_Address.substr(l_Separator + 1)),
+                             [this, l_Endpoints, l_OpenRequest, a_OpenHandler](const boost::system::error_code& a_ErrorCode, boost::asio::ip::tcp::resolver::iterator a_EndpointIt) {
+        if (l_OpenRequest != m_OpenRequests) {
+            a_OpenHandler(boost::asio::error::operation_aborted);
+            return;
+        } // if
+        
+        for (; ((!a_ErrorCode) && (a_EndpointIt != boost::asio::ip::tcp::resolver::iterator())); ++a_EndpointIt) {
+            l_Endpoints->emplace_back(a_EndpointIt->endpoint());
+        } // for
+        
+        if (a_ErrorCode) {
+            a_OpenHandler(a_ErrorCode);
+        } else if (l_Endpoints->empty()) {
+            a_OpenHandler(boost::asio::error::host_not_found);
+        } else {
+            ConnectNext(l_Endpoints, 0, l_OpenRequest, a_OpenHandler);
+        } // else
+    });
+}
+
+void SocketLinkTransport::Close() {
+    // Pending opens complete with operation_aborted
+    ++m_OpenRequests;
+    m_Resolver.cancel();
+    boost::system::error_code l_ErrorCode;
+    m_Socket.shutdown(boost::asio::socket_base::shutdown_both, l_ErrorCode);
+    m_Socket.close(l_ErrorCode);
+}
+
+void SocketLinkTransport::SetBaudRate(unsigned int) {
+    // The baud rate is up to the terminal server
+}
+
+void SocketLinkTransport::AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+    m_Socket.async_read_some(boost::asio::buffer(a_Buffer, a_Bytes), a_IoHandler);
+}
+
+void SocketLinkTransport::AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler) {
+    m_Socket.async_write_some(boost::asio::buffer(a_Buffer, a_Bytes), a_IoHandler);
+}
+
+int SocketLinkTransport::GetNativeHandle() {
+#if !defined(BOOST_ASIO_WINDOWS)
+    return m_Socket.native_handle();
+#else
+    return -1;
+#endif
+}
+
+void SocketLinkTransport::ConnectNext(std::shared_ptr<Endpoints> a_Endpoints, size_t a_Index, unsigned int a_OpenRequest, OpenHandler a_OpenHandler) {
+    // Try each address in turn, until one of them accepts the connection
+    auto l_OnConnect = [this, a_Endpoints, a_Index, a_OpenRequest, a_OpenHandler](const boost::system::error_code& a_ErrorCode) {
+        if (a_OpenRequest != m_OpenRequests) {
+            a_OpenHandler(boost::asio::error::operation_aborted);
+        } else if (!a_ErrorCode) {
+            boost::system::error_code l_ErrorCode;
+            if (m_eSocketType == SOCKET_TYPE_TCP) {
+                m_Socket.set_option(boost::asio::ip::tcp::no_delay(true), l_ErrorCode);
+            } // if
+            
+            a_OpenHandler(l_ErrorCode);
+        } else if ((a_Index + 1) < a_Endpoints->size()) {
+            ConnectNext(a_Endpoints, (a_Index + 1), a_OpenRequest, a_OpenHandler);
+        } else {
+            a_OpenHandler(a_ErrorCode);
+        } // else
+    };
+    
+    boost::system::error_code l_ErrorCode;
+    m_Socket.close(l_ErrorCode);
+    m_Socket.open((*a_Endpoints)[a_Index].protocol(), l_ErrorCode);
+    if (l_ErrorCode) {
+        l_OnConnect(l_ErrorCode);
+        return;
+    } // if
+    
+    m_Socket.async_connect((*a_Endpoints)[a_Index], l_OnConnect);
+}
@@ -0,0 +1,69 @@
+/**
+ * \file SocketLinkTransport.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOCKET_LINK_TRANSPORT_H
+#define SOCKET_LINK_TRANSPORT_H
+
+#include <vector>
+#include "LinkTransport.h"
+
+/*! \class SocketLinkTransport
+ *  \brief Class SocketLinkTransport
+ * 
+ *  A stream socket carrying the raw byte stream of a device, either connected to a terminal server via TCP, or to a
+ *  local endpoint via a unix domain socket. The HDLC protocol hands over single frames and waits for the acknowledgement
+ *  of the peer, thus, TCP_NODELAY is set to transmit each frame without delay. Corking would only add latency here.
+ */
+class SocketLinkTransport: public LinkTransport {
+public:
+    typedef enum {
+        SOCKET_TYPE_TCP  = 0, // "host:port"
+        SOCKET_TYPE_UNIX = 1  // "/path"
+    } E_SOCKET_TYPE;
+    
+    // CTOR
+    SocketLinkTransport(boost::asio::io_service& a_IOService, E_SOCKET_TYPE a_eSocketType, const std::string &a_Address);
+    
+    void AsyncOpen(unsigned int a_BaudRate, OpenHandler a_OpenHandler);
+    void Close();
+    void SetBaudRate(unsigned int a_BaudRate);
+    void AsyncReadSome(unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    void AsyncWriteSome(const unsigned char* a_Buffer, size_t a_Bytes, IoHandler a_IoHandler);
+    int GetNativeHandle();
+    
+protected:
+    // Members
+    boost::asio::io_service& m_IOService;
+    boost::asio::generic::stream_protocol::socket m_Socket;
+    
+private:
+    // Internal helpers
+    typedef std::vector<boost::asio::generic::stream_protocol::endpoint> Endpoints;
+    void ConnectNext(std::shared_ptr<Endpoints> a_Endpoints, size_t a_Index, unsigned int a_OpenRequest, OpenHandler a_OpenHandler);
+    
+    // Members
+    E_SOCKET_TYPE m_eSocketType;
+    std::string m_Address;
+    boost::asio::ip::tcp::resolver m_Resolver;
+    unsigned int m_OpenRequests; // Identifies the latest call of AsyncOpen(), completions of previous ones are aborted
+};
+
+#endif // SOCKET_LINK_TRANSPORT_H
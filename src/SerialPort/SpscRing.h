@@ -0,0 +1,90 @@
+/**
+ * \file SpscRing.h
+ * \brief 
+ *
+ * The HDLC Deamon implements the HDLC protocol to easily talk to devices connected via serial communications.
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <assert.h>
+
+/*! \class SpscRing
+ *  \brief Class SpscRing
+ * 
+ *  A bounded lock-free queue for exactly one producer thread and exactly one consumer thread. The slots are allocated
+ *  once, elements are moved in and out. Head and tail are kept apart by padding, thus, the producer and the
+ *  consumer do not contend for the same cache line unless the ring is almost empty or almost full.
+ */
+template <typename T>
+class SpscRing {
+public:
+    // CTOR. The capacity must be a power of two.
+    explicit SpscRing(size_t a_Capacity): m_Slots(a_Capacity), m_Mask(a_Capacity - 1), m_Head(0), m_Tail(0) {
+        assert((a_Capacity != 0) && ((a_Capacity & m_Mask) == 0));
+    }
+    
+    // To be called by the producer only
+    bool Push(T&& a_Element) {
+        size_t l_Tail = m_Tail.load(std::memory_order_relaxed);
+        if ((l_Tail - m_Head.load(std::memory_order_acquire)) > m_Mask) {
+            // Full
+            return false;
+        } // if
+        
+        m_Slots[l_Tail & m_Mask] = std::move(a_Element);
+        m_Tail.store(l_Tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // To be called by the consumer only
+    bool Pop(T& a_Element) {
+        size_t l_Head = m_Head.load(std::memory_order_relaxed);
+        if (l_Head == m_Tail.load(std::memory_order_acquire)) {
+            // Empty
+            return false;
+        } // if
+        
+        a_Element = std::move(m_Slots[l_Head & m_Mask]);
+        m_Head.store(l_Head + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // To be called by the consumer if no other thread accesses the ring anymore
+    void Clear() {
+        T l_Element;
+        while (Pop(l_Element)) {
+        } // while
+    }
+    
+private:
+    // Members
+    enum { cache_line_size = 64 };
+    std::vector<T> m_Slots;
+    const size_t m_Mask;
+    char m_Padding1[cache_line_size];
+    std::atomic<size_t> m_Head; //!< The number of elements popped, written by the consumer
+    char m_Padding2[cache_line_size];
+    std::atomic<size_t> m_Tail; //!< The number of elements pushed, written by the producer
+    char m_Padding3[cache_line_size];
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,436 @@
+/**
+ * \file main-hdlcd-bench.cpp
+ * \brief 
+ *
+ * The hdlc-tools implement the HDLC protocol to easily talk to devices connected via serial communications
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Config.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+#include "BenchmarkClient.h"
+#include "DeviceSimulator.h"
+#include "LatencyRecorder.h"
+
+// The CPU time (user and system) consumed by a process so far, in nanoseconds
+static bool ReadProcessCpuTime(pid_t a_Pid, uint64_t& a_Nanoseconds) {
+    std::ifstream l_Stat("/proc/" + std::to_string(a_Pid) + "/stat");
+    std::string l_Line;
+    if (!std::getline(l_Stat, l_Line)) {
+        return false;
+    } // if
+    
+    // The process name may contain spaces, thus, skip everything up to the closing parenthesis. The fields utime and
+    // stime are the 12th and 13th field after it.
+    size_t l_Position = l_Line.rfind(')');
+    if (l_Position == std::string::npos) {
+        return false;
+    } // if
+    
+    std::stringstream l_Fields(l_Line.substr(l_Position + 1));
+    std::string l_Field;
+    for (int l_Index = 0; l_Index < 11; ++l_Index) {
+        l_Fields >> l_Field;
+    } // for
+    
+    uint64_t l_UserTicks = 0;
+    uint64_t l_SystemTicks = 0;
+    if (!(l_Fields >> l_UserTicks >> l_SystemTicks)) {
+        return false;
+    } // if
+    
+    a_Nanoseconds = ((l_UserTicks + l_SystemTicks) * 1000000000ULL / ::sysconf(_SC_CLK_TCK));
+    return true;
+}
+
+// The current and the peak resident set size of a process, in kilobytes
+static bool ReadProcessMemory(pid_t a_Pid, uint64_t& a_RssKilobytes, uint64_t& a_PeakRssKilobytes) {
+    std::ifstream l_Status("/proc/" + std::to_string(a_Pid) + "/status");
+    std::string l_Line;
+    bool l_bFound = false;
+    while (std::getline(l_Status, l_Line)) {
+        std::stringstream l_Fields(l_Line);
+        std::string l_Name;
+        uint64_t l_Value = 0;
+        l_Fields >> l_Name >> l_Value;
+        if (l_Name == "VmRSS:") {
+            a_RssKilobytes = l_Value;
+            l_bFound = true;
+        } else if (l_Name == "VmHWM:") {
+            a_PeakRssKilobytes = l_Value;
+        } // else if
+    } // while
+    
+    return l_bFound;
+}
+
+// A JSON object describing a direction of traffic
+static void PrintDirection(std::ostream& a_OutputStream, const char* a_Name, uint64_t a_Sent, uint64_t a_Delivered, uint64_t a_Bytes, double a_Seconds, LatencyRecorder& a_LatencyRecorder) {
+    a_OutputStream << "  \"" << a_Name << "\": {\"sent\": " << a_Sent << ", \"delivered\": " << a_Delivered
+                   << ", \"packets_per_s\": " << (a_Delivered / a_Seconds) << ", \"bytes_per_s\": " << (a_Bytes / a_Seconds)
+                   << ", \"latency_samples\": " << a_LatencyRecorder.GetCount()
+                   << ", \"latency_us\": {\"p50\": " << (a_LatencyRecorder.GetPercentile(50.0) / 1000.0)
+                   << ", \"p99\": " << (a_LatencyRecorder.GetPercentile(99.0) / 1000.0)
+                   << ", \"p999\": " << (a_LatencyRecorder.GetPercentile(99.9) / 1000.0)
+                   << ", \"max\": " << (a_LatencyRecorder.GetMaximum() / 1000.0) << "}}";
+}
+
+int main(int argc, char **argv) {
+    try {
+        // Declare the supported options.
+        boost::program_options::options_description l_Description("Allowed options");
+        l_Description.add_options()
+            ("help,h",    "produce this help message")
+            ("version,v", "show version information")
+            ("daemon",    boost::program_options::value<std::string>()->default_value("hdlcd"),
+                          "the path of the HDLCd executable to benchmark")
+            ("daemon-arg", boost::program_options::value<std::vector<std::string>>()->composing(),
+                          "an additional argument passed to the HDLCd, e.g., --daemon-arg=--threads=2; may be given multiple times")
+            ("port,p",    boost::program_options::value<uint16_t>()->default_value(36963),
+                          "the TCP port of the HDLCd")
+            ("devices,n", boost::program_options::value<unsigned int>()->default_value(1),
+                          "the number of simulated devices, each attached via a pseudo terminal")
+            ("clients,m", boost::program_options::value<unsigned int>()->default_value(1),
+                          "the number of clients per device in each role: payload, port status, HDLC raw, and HDLC dissected")
+            ("pattern",   boost::program_options::value<std::string>()->default_value("reliable"),
+                          "the traffic pattern in both directions: reliable, unreliable, or mixed")
+            ("rate",      boost::program_options::value<unsigned int>()->default_value(100),
+                          "the number of data packets per second sent by each payload client, 0 for back-to-back")
+            ("uplink-rate", boost::program_options::value<unsigned int>()->default_value(100),
+                          "the number of frames per second sent by each simulated device, 0 for none")
+            ("size",      boost::program_options::value<size_t>()->default_value(16),
+                          "the payload size in bytes in both directions, 16 to 4096")
+            ("window",    boost::program_options::value<unsigned int>()->default_value(1),
+                          "the window of the simulated devices, 1 to 7")
+            ("turnaround-us", boost::program_options::value<unsigned int>()->default_value(0),
+                          "the delay in microseconds until the simulated devices ack received I-frames")
+            ("warmup",    boost::program_options::value<unsigned int>()->default_value(3),
+                          "the number of seconds before the measurement starts")
+            ("duration",  boost::program_options::value<unsigned int>()->default_value(10),
+                          "the number of seconds of the measurement")
+        ;
+
+        // Parse the command line
+        boost::program_options::variables_map l_VariablesMap;
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, l_Description), l_VariablesMap);
+        boost::program_options::notify(l_VariablesMap);
+        if (l_VariablesMap.count("version")) {
+            std::cerr << "HDLC daemon benchmark version " << HDLCD_VERSION_MAJOR << "." << HDLCD_VERSION_MINOR << std::endl;
+        } // if
+
+        if (l_VariablesMap.count("help")) {
+            std::cout << l_Description << std::endl;
+            std::cout << "Starts the HDLCd against simulated devices, generates load via clients of all roles, and" << std::endl;
+            std::cout << "reports throughput, latency, CPU time, and memory usage of the HDLCd as JSON on stdout." << std::endl;
+            return 1;
+        } // if
+        
+        std::string l_Pattern = l_VariablesMap["pattern"].as<std::string>();
+        E_TRAFFIC_PATTERN l_eTrafficPattern;
+        if (l_Pattern == "reliable") {
+            l_eTrafficPattern = TRAFFIC_PATTERN_RELIABLE;
+        } else if (l_Pattern == "unreliable") {
+            l_eTrafficPattern = TRAFFIC_PATTERN_UNRELIABLE;
+        } else if (l_Pattern == "mixed") {
+            l_eTrafficPattern = TRAFFIC_PATTERN_MIXED;
+        } else {
+            std::cout << "hdlcd-bench: unknown traffic pattern " << l_Pattern << std::endl;
+            std::cout << "hdlcd-bench: Use --help for more information." << std::endl;
+            return 1;
+        } // else
+        
+        unsigned int l_Devices = l_VariablesMap["devices"].as<unsigned int>();
+        unsigned int l_Clients = l_VariablesMap["clients"].as<unsigned int>();
+        unsigned int l_Rate = l_VariablesMap["rate"].as<unsigned int>();
+        unsigned int l_UplinkRate = l_VariablesMap["uplink-rate"].as<unsigned int>();
+        size_t l_PayloadSize = l_VariablesMap["size"].as<size_t>();
+        unsigned int l_Window = l_VariablesMap["window"].as<unsigned int>();
+        unsigned int l_Duration = l_VariablesMap["duration"].as<unsigned int>();
+        uint16_t l_Port = l_VariablesMap["port"].as<uint16_t>();
+        if ((l_Devices == 0) || (l_Duration == 0)) {
+            std::cout << "hdlcd-bench: at least one device and a duration of at least one second are required" << std::endl;
+            return 1;
+        } // if
+        
+        if ((l_Rate > 1000000) || (l_UplinkRate > 1000000)) {
+            std::cout << "hdlcd-bench: rates must not exceed 1000000 packets per second" << std::endl;
+            return 1;
+        } // if
+        
+        if ((l_PayloadSize < 16) || (l_PayloadSize > 4096)) {
+            std::cout << "hdlcd-bench: the payload size must be in the range 16 to 4096 bytes" << std::endl;
+            return 1;
+        } // if
+        
+        if ((l_Window < 1) || (l_Window > 7)) {
+            std::cout << "hdlcd-bench: the window must be in the range 1 to 7" << std::endl;
+            return 1;
+        } // if
+        
+        // Install signal handlers
+        boost::asio::io_service l_IoService;
+        boost::asio::signal_set l_Signals(l_IoService);
+        l_Signals.add(SIGINT);
+        l_Signals.add(SIGTERM);
+        l_Signals.async_wait([&l_IoService](boost::system::error_code, int){ l_IoService.stop(); });
+        
+        // Simulated devices. For the mixed pattern, every second device sends I-frames.
+        bool l_bMeasuring = false;
+        uint64_t l_DownlinkPackets = 0;
+        uint64_t l_DownlinkBytes = 0;
+        uint64_t l_UplinkSent = 0;
+        LatencyRecorder l_DownlinkLatency;
+        LatencyRecorder l_UplinkLatency;
+        std::vector<std::shared_ptr<DeviceSimulator>> l_DeviceSimulators;
+        for (unsigned int l_Index = 0; l_Index < l_Devices; ++l_Index) {
+            DeviceSimulatorSettings l_Settings;
+            l_Settings.m_BaudRate = 0;
+            l_Settings.m_Window = l_Window;
+            l_Settings.m_TurnaroundMicroseconds = l_VariablesMap["turnaround-us"].as<unsigned int>();
+            l_Settings.m_eNakMode = NAK_MODE_REJ;
+            l_Settings.m_BitErrorRate = 0;
+            l_Settings.m_RxDropRate = 0;
+            l_Settings.m_TxDropRate = 0;
+            l_Settings.m_UplinkRate = l_UplinkRate;
+            l_Settings.m_UplinkSize = l_PayloadSize;
+            l_Settings.m_bUplinkReliable = ((l_eTrafficPattern == TRAFFIC_PATTERN_RELIABLE) || ((l_eTrafficPattern == TRAFFIC_PATTERN_MIXED) && (l_Index & 0x01)));
+            l_Settings.m_bEcho = false;
+            l_Settings.m_bCommands = false;
+            l_Settings.m_Seed = (l_Index + 1);
+            auto l_DeviceSimulator = std::make_shared<DeviceSimulator>(l_IoService, l_Settings);
+            l_DeviceSimulator->SetOnPayloadCallback([&](const std::vector<unsigned char>& a_Payload, bool) {
+                if ((l_bMeasuring) && (a_Payload.size() >= 16)) {
+                    ++l_DownlinkPackets;
+                    l_DownlinkBytes += a_Payload.size();
+                    l_DownlinkLatency.Add(LatencyRecorder::ReadTimestamp(&a_Payload[8]), LatencyRecorder::GetTimestamp());
+                } // if
+            });
+            
+            if (!l_DeviceSimulator->Start()) {
+                return 1;
+            } // if
+            
+            l_DeviceSimulators.emplace_back(l_DeviceSimulator);
+        } // for
+        
+        // Start the HDLCd. Its stdout is redirected to stderr, thus, stdout carries the results only.
+        std::vector<std::string> l_Arguments;
+        l_Arguments.emplace_back(l_VariablesMap["daemon"].as<std::string>());
+        l_Arguments.emplace_back("--port");
+        l_Arguments.emplace_back(std::to_string(l_Port));
+        if (l_VariablesMap.count("daemon-arg")) {
+            auto l_DaemonArguments = l_VariablesMap["daemon-arg"].as<std::vector<std::string>>();
+            l_Arguments.insert(l_Arguments.end(), l_DaemonArguments.begin(), l_DaemonArguments.end());
+        } // if
+        
+        pid_t l_DaemonPid = ::fork();
+        if (l_DaemonPid < 0) {
+            std::cerr << "Failed to start the HDLCd" << std::endl;
+            return 1;
+        } else if (l_DaemonPid == 0) {
+            std::vector<char*> l_ArgumentPointers;
+            for (auto it = l_Arguments.begin(); it != l_Arguments.end(); ++it) {
+                l_ArgumentPointers.emplace_back(&(*it)[0]);
+            } // for
+            
+            l_ArgumentPointers.emplace_back((char*)NULL);
+            ::dup2(STDERR_FILENO, STDOUT_FILENO);
+            ::execvp(l_ArgumentPointers[0], &l_ArgumentPointers[0]);
+            std::cerr << "Failed to execute " << l_Arguments[0] << std::endl;
+            ::_exit(127);
+        } // else if
+        
+        // Wait until the HDLCd accepts clients
+        boost::asio::ip::tcp::endpoint l_Endpoint(boost::asio::ip::address_v4::loopback(), l_Port);
+        bool l_bListening = false;
+        for (int l_Attempt = 0; (l_Attempt < 100) && (!l_bListening); ++l_Attempt) {
+            int l_Status = 0;
+            if (::waitpid(l_DaemonPid, &l_Status, WNOHANG) == l_DaemonPid) {
+                std::cerr << "The HDLCd terminated unexpectedly" << std::endl;
+                return 1;
+            } // if
+            
+            boost::system::error_code l_ErrorCode;
+            boost::asio::ip::tcp::socket l_Socket(l_IoService);
+            l_Socket.connect(l_Endpoint, l_ErrorCode);
+            if (!l_ErrorCode) {
+                l_bListening = true;
+            } else {
+                ::usleep(50000);
+            } // else
+        } // for
+        
+        if (!l_bListening) {
+            std::cerr << "The HDLCd does not accept clients on port " << l_Port << std::endl;
+            ::kill(l_DaemonPid, SIGTERM);
+            ::waitpid(l_DaemonPid, NULL, 0);
+            return 1;
+        } // if
+        
+        // Clients: per device, the given number of clients in each role
+        std::vector<std::shared_ptr<BenchmarkClient>> l_BenchmarkClients;
+        for (auto it = l_DeviceSimulators.begin(); it != l_DeviceSimulators.end(); ++it) {
+            for (int l_Role = CLIENT_ROLE_PAYLOAD; l_Role <= CLIENT_ROLE_DISSECTED; ++l_Role) {
+                for (unsigned int l_Index = 0; l_Index < l_Clients; ++l_Index) {
+                    auto l_BenchmarkClient = std::make_shared<BenchmarkClient>(l_IoService, (E_CLIENT_ROLE)l_Role, (*it)->GetSlavePath(), l_UplinkLatency);
+                    l_BenchmarkClient->Start(l_Endpoint);
+                    l_BenchmarkClient->StartSending(l_eTrafficPattern, l_Rate, l_PayloadSize);
+                    l_BenchmarkClients.emplace_back(l_BenchmarkClient);
+                } // for
+            } // for
+        } // for
+        
+        // Warmup, then measure
+        uint64_t l_CpuStart = 0;
+        uint64_t l_CpuEnd = 0;
+        uint64_t l_RssKilobytes = 0;
+        uint64_t l_PeakRssKilobytes = 0;
+        bool l_bProcessInfo = true;
+        bool l_bCompleted = false;
+        boost::asio::deadline_timer l_Timer(l_IoService);
+        l_Timer.expires_from_now(boost::posix_time::seconds(l_VariablesMap["warmup"].as<unsigned int>()));
+        l_Timer.async_wait([&](const boost::system::error_code& a_ErrorCode) {
+            if (a_ErrorCode) {
+                return;
+            } // if
+            
+            for (auto it = l_BenchmarkClients.begin(); it != l_BenchmarkClients.end(); ++it) {
+                (*it)->ResetStatistics();
+            } // for
+            
+            for (auto it = l_DeviceSimulators.begin(); it != l_DeviceSimulators.end(); ++it) {
+                l_UplinkSent -= (*it)->GetUplinkPayloads();
+            } // for
+            
+            l_bMeasuring = true;
+            uint64_t l_Now = LatencyRecorder::GetTimestamp();
+            l_DownlinkLatency.Start(l_Now);
+            l_UplinkLatency.Start(l_Now);
+            l_bProcessInfo = ReadProcessCpuTime(l_DaemonPid, l_CpuStart);
+            l_Timer.expires_from_now(boost::posix_time::seconds(l_Duration));
+            l_Timer.async_wait([&](const boost::system::error_code& a_ErrorCode) {
+                if (a_ErrorCode) {
+                    return;
+                } // if
+                
+                l_bMeasuring = false;
+                l_bCompleted = true;
+                for (auto it = l_DeviceSimulators.begin(); it != l_DeviceSimulators.end(); ++it) {
+                    l_UplinkSent += (*it)->GetUplinkPayloads();
+                } // for
+                
+                l_DownlinkLatency.Stop();
+                l_UplinkLatency.Stop();
+                l_bProcessInfo = ((l_bProcessInfo) && (ReadProcessCpuTime(l_DaemonPid, l_CpuEnd)) && (ReadProcessMemory(l_DaemonPid, l_RssKilobytes, l_PeakRssKilobytes)));
+                for (auto it = l_BenchmarkClients.begin(); it != l_BenchmarkClients.end(); ++it) {
+                    (*it)->Stop();
+                } // for
+                
+                l_IoService.stop();
+            });
+        });
+        
+        l_IoService.run();
+        
+        // Shutdown
+        for (auto it = l_BenchmarkClients.begin(); it != l_BenchmarkClients.end(); ++it) {
+            (*it)->Stop();
+        } // for
+        
+        ::kill(l_DaemonPid, SIGTERM);
+        ::waitpid(l_DaemonPid, NULL, 0);
+        for (auto it = l_DeviceSimulators.begin(); it != l_DeviceSimulators.end(); ++it) {
+            (*it)->Stop();
+        } // for
+        
+        // Evaluate the statistics of all clients
+        uint64_t l_DownlinkSent = 0;
+        uint64_t l_DownlinkDeferred = 0;
+        uint64_t l_UplinkPackets = 0;
+        uint64_t l_UplinkBytes = 0;
+        uint64_t l_RawPackets = 0;
+        uint64_t l_DissectedPackets = 0;
+        uint64_t l_PortStatusPackets = 0;
+        unsigned int l_FailedClients = 0;
+        for (size_t l_Index = 0; l_Index < l_BenchmarkClients.size(); ++l_Index) {
+            const BenchmarkClient::Statistics& l_Statistics = l_BenchmarkClients[l_Index]->GetStatistics();
+            switch ((l_Index / l_Clients) % 4) {
+                case CLIENT_ROLE_PAYLOAD:
+                    l_DownlinkSent += l_Statistics.m_PacketsSent;
+                    l_DownlinkDeferred += l_Statistics.m_PacketsDeferred;
+                    l_UplinkPackets += l_Statistics.m_DataPacketsReceived;
+                    l_UplinkBytes += l_Statistics.m_BytesReceived;
+                    break;
+                case CLIENT_ROLE_PORT_STATUS:
+                    l_PortStatusPackets += l_Statistics.m_ControlPacketsReceived;
+                    break;
+                case CLIENT_ROLE_RAW:
+                    l_RawPackets += l_Statistics.m_DataPacketsReceived;
+                    break;
+                case CLIENT_ROLE_DISSECTED:
+                    l_DissectedPackets += l_Statistics.m_DataPacketsReceived;
+                    break;
+            } // switch
+            
+            if (l_BenchmarkClients[l_Index]->IsFailed()) {
+                ++l_FailedClients;
+            } // if
+        } // for
+        
+        // Report as JSON. Uplink payloads are delivered to each payload client of a device. The CPU time is related to all data packets delivered by the HDLCd, to devices and clients.
+        double l_Seconds = l_Duration;
+        uint64_t l_DeliveredPackets = (l_DownlinkPackets + l_UplinkPackets + l_RawPackets + l_DissectedPackets);
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "{" << std::endl;
+        std::cout << "  \"completed\": " << (l_bCompleted ? "true" : "false") << "," << std::endl;
+        std::cout << "  \"devices\": " << l_Devices << ", \"clients_per_role\": " << l_Clients << ", \"pattern\": \"" << l_Pattern
+                  << "\", \"rate\": " << l_Rate << ", \"uplink_rate\": " << l_UplinkRate << ", \"size\": " << l_PayloadSize
+                  << ", \"window\": " << l_Window << ", \"duration_s\": " << l_Duration << "," << std::endl;
+        PrintDirection(std::cout, "tcp_to_device", l_DownlinkSent, l_DownlinkPackets, l_DownlinkBytes, l_Seconds, l_DownlinkLatency);
+        std::cout << "," << std::endl;
+        PrintDirection(std::cout, "device_to_tcp", l_UplinkSent, l_UplinkPackets, l_UplinkBytes, l_Seconds, l_UplinkLatency);
+        std::cout << "," << std::endl;
+        std::cout << "  \"deferred_sends\": " << l_DownlinkDeferred << ", \"raw_packets\": " << l_RawPackets << ", \"dissected_packets\": " << l_DissectedPackets
+                  << ", \"port_status_packets\": " << l_PortStatusPackets << ", \"failed_clients\": " << l_FailedClients << "," << std::endl;
+        if (l_bProcessInfo) {
+            double l_CpuSeconds = ((l_CpuEnd - l_CpuStart) / 1e9);
+            std::cout << "  \"daemon\": {\"cpu_s\": " << l_CpuSeconds << ", \"cpu_us_per_packet\": "
+                      << (l_DeliveredPackets ? (l_CpuSeconds * 1e6 / l_DeliveredPackets) : 0.0)
+                      << ", \"rss_kb\": " << l_RssKilobytes << ", \"peak_rss_kb\": " << l_PeakRssKilobytes << "}" << std::endl;
+        } else {
+            std::cout << "  \"daemon\": null" << std::endl;
+        } // else
+        
+        std::cout << "}" << std::endl;
+        return ((l_bCompleted && (l_FailedClients == 0)) ? 0 : 1);
+        
+    } catch (std::exception& a_Error) {
+        std::cerr << "Exception: " << a_Error.what() << "\n";
+        return 1;
+    } // catch
+}
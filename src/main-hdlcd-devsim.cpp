@@ -0,0 +1,152 @@
+/**
+ * \file main-hdlcd-devsim.cpp
+ * \brief 
+ *
+ * The hdlc-tools implement the HDLC protocol to easily talk to devices connected via serial communications
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Config.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+#include "DeviceSimulator.h"
+
+int main(int argc, char **argv) {
+    try {
+        // Declare the supported options.
+        boost::program_options::options_description l_Description("Allowed options");
+        l_Description.add_options()
+            ("help,h",    "produce this help message")
+            ("version,v", "show version information")
+            ("link,l",    boost::program_options::value<std::string>()->default_value(""),
+                          "create a symbolic link to the pseudo terminal, e.g., /tmp/ttyDEV0")
+            ("baud,b",    boost::program_options::value<unsigned int>()->default_value(0),
+                          "the baud rate of the device; frames at another baud rate are discarded; 0 to accept any baud rate")
+            ("window,w",  boost::program_options::value<unsigned int>()->default_value(1),
+                          "the number of received I-frames acked at once, and the send window for uplink I-frames, 1 to 7")
+            ("turnaround-us", boost::program_options::value<unsigned int>()->default_value(0),
+                          "the delay in microseconds until received I-frames are acked if the window is not full")
+            ("nak",       boost::program_options::value<std::string>()->default_value("rej"),
+                          "the answer to out-of-sequence I-frames: rej, srej, or ignore")
+            ("bit-error-rate", boost::program_options::value<double>()->default_value(0),
+                          "the probability of a bit error per transmitted byte")
+            ("rx-drop-rate",   boost::program_options::value<double>()->default_value(0),
+                          "the probability of dropping a received frame")
+            ("tx-drop-rate",   boost::program_options::value<double>()->default_value(0),
+                          "the probability of dropping a frame to transmit")
+            ("uplink-rate",    boost::program_options::value<unsigned int>()->default_value(0),
+                          "the number of uplink frames per second, 0 for none")
+            ("uplink-size",    boost::program_options::value<size_t>()->default_value(16),
+                          "the payload size of uplink frames in bytes, at least 16 for the sequence number and timestamp")
+            ("uplink-reliable", "send uplink frames as I-frames instead of UI-frames")
+            ("echo",      "send the payload of each received I-frame or UI-frame back")
+            ("seed",      boost::program_options::value<unsigned int>()->default_value(1),
+                          "the seed of the random number generator for error injection")
+        ;
+
+        // Parse the command line
+        boost::program_options::variables_map l_VariablesMap;
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, l_Description), l_VariablesMap);
+        boost::program_options::notify(l_VariablesMap);
+        if (l_VariablesMap.count("version")) {
+            std::cerr << "HDLC device simulator version " << HDLCD_VERSION_MAJOR << "." << HDLCD_VERSION_MINOR << std::endl;
+        } // if
+
+        if (l_VariablesMap.count("help")) {
+            std::cout << l_Description << std::endl;
+            std::cout << "Simulates an HDLC device attached via a pseudo terminal, for load and latency tests of the HDLCd." << std::endl;
+            std::cout << "Commands on stdin, one per line: rnr, rr, rej, srej, baud RATE, stats, quit" << std::endl;
+            return 1;
+        } // if
+        
+        DeviceSimulatorSettings l_Settings;
+        l_Settings.m_LinkPath = l_VariablesMap["link"].as<std::string>();
+        l_Settings.m_BaudRate = l_VariablesMap["baud"].as<unsigned int>();
+        l_Settings.m_Window = l_VariablesMap["window"].as<unsigned int>();
+        l_Settings.m_TurnaroundMicroseconds = l_VariablesMap["turnaround-us"].as<unsigned int>();
+        l_Settings.m_BitErrorRate = l_VariablesMap["bit-error-rate"].as<double>();
+        l_Settings.m_RxDropRate = l_VariablesMap["rx-drop-rate"].as<double>();
+        l_Settings.m_TxDropRate = l_VariablesMap["tx-drop-rate"].as<double>();
+        l_Settings.m_UplinkRate = l_VariablesMap["uplink-rate"].as<unsigned int>();
+        l_Settings.m_UplinkSize = l_VariablesMap["uplink-size"].as<size_t>();
+        l_Settings.m_bUplinkReliable = (l_VariablesMap.count("uplink-reliable") != 0);
+        l_Settings.m_bEcho = (l_VariablesMap.count("echo") != 0);
+        l_Settings.m_bCommands = true;
+        l_Settings.m_Seed = l_VariablesMap["seed"].as<unsigned int>();
+        
+        std::string l_NakMode = l_VariablesMap["nak"].as<std::string>();
+        if (l_NakMode == "rej") {
+            l_Settings.m_eNakMode = NAK_MODE_REJ;
+        } else if (l_NakMode == "srej") {
+            l_Settings.m_eNakMode = NAK_MODE_SREJ;
+        } else if (l_NakMode == "ignore") {
+            l_Settings.m_eNakMode = NAK_MODE_IGNORE;
+        } else {
+            std::cout << "hdlcd-devsim: unknown answer to out-of-sequence I-frames " << l_NakMode << std::endl;
+            std::cout << "hdlcd-devsim: Use --help for more information." << std::endl;
+            return 1;
+        } // else
+        
+        if ((l_Settings.m_Window < 1) || (l_Settings.m_Window > 7)) {
+            std::cout << "hdlcd-devsim: the window must be in the range 1 to 7" << std::endl;
+            return 1;
+        } // if
+        
+        if ((l_Settings.m_BitErrorRate < 0) || (l_Settings.m_BitErrorRate > 1) || (l_Settings.m_RxDropRate < 0) || (l_Settings.m_RxDropRate > 1) ||
+            (l_Settings.m_TxDropRate < 0) || (l_Settings.m_TxDropRate > 1)) {
+            std::cout << "hdlcd-devsim: error rates must be in the range 0 to 1" << std::endl;
+            return 1;
+        } // if
+        
+        if (l_Settings.m_UplinkRate > 1000000) {
+            std::cout << "hdlcd-devsim: the uplink rate must not exceed 1000000 frames per second" << std::endl;
+            return 1;
+        } // if
+        
+        if ((l_Settings.m_UplinkSize < 16) || (l_Settings.m_UplinkSize > 4096)) {
+            std::cout << "hdlcd-devsim: the uplink payload size must be in the range 16 to 4096 bytes" << std::endl;
+            return 1;
+        } // if
+
+        // Install signal handlers
+        boost::asio::io_service l_IoService;
+        boost::asio::signal_set l_Signals(l_IoService);
+        l_Signals.add(SIGINT);
+        l_Signals.add(SIGTERM);
+        l_Signals.async_wait([&l_IoService](boost::system::error_code, int){ l_IoService.stop(); });
+        
+        // Start the simulated device
+        auto l_DeviceSimulator = std::make_shared<DeviceSimulator>(l_IoService, l_Settings);
+        if (!l_DeviceSimulator->Start()) {
+            return 1;
+        } // if
+        
+        l_IoService.run();
+        
+        // Shutdown
+        l_DeviceSimulator->Stop();
+        l_DeviceSimulator->PrintStatistics(std::cout);
+        
+    } catch (std::exception& a_Error) {
+        std::cerr << "Exception: " << a_Error.what() << "\n";
+        return 1;
+    } // catch
+    
+    return 0;
+}
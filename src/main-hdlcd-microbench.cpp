@@ -0,0 +1,272 @@
+/**
+ * \file main-hdlcd-microbench.cpp
+ * \brief 
+ *
+ * The hdlc-tools implement the HDLC protocol to easily talk to devices connected via serial communications
+ * Copyright (C) 2016  Florian Evers, florian-evers@gmx.de
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Config.h"
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+#include "FCS16.h"
+#include "FrameGenerator.h"
+#include "FrameParser.h"
+#include "HdlcFrame.h"
+#include "MicroBenchmark.h"
+#include "MockSerialPortHandler.h"
+#include "ProtocolState.h"
+
+// An escaped HDLC frame as it is seen on the serial line
+static std::vector<unsigned char> CreateEscapedFrame(HdlcFrame::E_HDLC_FRAMETYPE a_eHDLCFrameType, unsigned char a_Seq, const std::vector<unsigned char>& a_Payload) {
+    HdlcFrame l_HdlcFrame;
+    l_HdlcFrame.SetAddress(0x30);
+    l_HdlcFrame.SetHDLCFrameType(a_eHDLCFrameType);
+    l_HdlcFrame.SetSSeq(a_Seq);
+    l_HdlcFrame.SetRSeq(a_Seq);
+    l_HdlcFrame.SetPayload(a_Payload);
+    return FrameGenerator::EscapeFrame(FrameGenerator::SerializeFrame(l_HdlcFrame));
+}
+
+// Feeds a byte stream to a parser in chunks, as read from a serial port, and returns the number of frames
+static size_t ParseStream(FrameParser& a_FrameParser, std::vector<DeserializedFrame>& a_DeserializedFrames, const std::vector<unsigned char>& a_Stream, size_t a_ChunkSize) {
+    size_t l_Frames = 0;
+    for (size_t l_Offset = 0; l_Offset < a_Stream.size(); l_Offset += a_ChunkSize) {
+        a_DeserializedFrames.clear();
+        a_FrameParser.AddReceivedRawBytes(&a_Stream[l_Offset], std::min(a_ChunkSize, a_Stream.size() - l_Offset), a_DeserializedFrames);
+        l_Frames += a_DeserializedFrames.size();
+    } // for
+    
+    return l_Frames;
+}
+
+int main(int argc, char **argv) {
+    try {
+        // Declare the supported options.
+        boost::program_options::options_description l_Description("Allowed options");
+        l_Description.add_options()
+            ("help,h",    "produce this help message")
+            ("version,v", "show version information")
+            ("filter,f",  boost::program_options::value<std::string>()->default_value(""),
+                          "run only the benchmarks whose name contains this string, e.g., parser/")
+            ("min-time",  boost::program_options::value<double>()->default_value(0.5),
+                          "the minimum duration of each measurement in seconds")
+            ("chunk",     boost::program_options::value<size_t>()->default_value(256),
+                          "the number of bytes handed over to the parser at once, as read from a serial port")
+            ("json",      "print the results as JSON instead of a table")
+        ;
+
+        // Parse the command line
+        boost::program_options::variables_map l_VariablesMap;
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, l_Description), l_VariablesMap);
+        boost::program_options::notify(l_VariablesMap);
+        if (l_VariablesMap.count("version")) {
+            std::cerr << "HDLC micro-benchmarks version " << HDLCD_VERSION_MAJOR << "." << HDLCD_VERSION_MINOR << std::endl;
+        } // if
+
+        if (l_VariablesMap.count("help")) {
+            std::cout << l_Description << std::endl;
+            std::cout << "Measures the framing functions and the protocol state machine of the HDLCd in isolation." << std::endl;
+            return 1;
+        } // if
+        
+        size_t l_ChunkSize = l_VariablesMap["chunk"].as<size_t>();
+        if (l_ChunkSize == 0) {
+            std::cout << "hdlcd-microbench: the chunk size must be at least 1 byte" << std::endl;
+            return 1;
+        } // if
+        
+        // All inputs are generated with a fixed seed, thus, each run measures exactly the same workload
+        std::mt19937 l_RandomGenerator(1);
+        auto l_RandomBytes = [&l_RandomGenerator](size_t a_Size) {
+            std::vector<unsigned char> l_Bytes(a_Size);
+            for (auto it = l_Bytes.begin(); it != l_Bytes.end(); ++it) {
+                *it = (l_RandomGenerator() & 0xFF);
+            } // for
+            
+            return l_Bytes;
+        };
+        
+        // The largest payload accepted by the parser: 1024 bytes minus flags, address, control field, and FCS
+        const size_t l_MaxPayloadSize = (1024 - 6);
+        std::vector<unsigned char> l_TypicalPayload = l_RandomBytes(64);
+        std::vector<unsigned char> l_EscapePayload(64);
+        for (size_t l_Index = 0; l_Index < l_EscapePayload.size(); ++l_Index) {
+            l_EscapePayload[l_Index] = ((l_Index & 0x01) ? 0x7D : 0x7E);
+        } // for
+        
+        std::vector<unsigned char> l_MaxPayload = l_RandomBytes(l_MaxPayloadSize);
+        
+        // Byte streams: realistic traffic, escape-heavy payloads, junk, and frames of maximum length
+        std::vector<unsigned char> l_TypicalStream;
+        std::vector<unsigned char> l_EscapeStream;
+        std::vector<unsigned char> l_MaxLengthStream;
+        for (unsigned char l_Index = 0; l_Index < 64; ++l_Index) {
+            std::vector<unsigned char> l_Frame;
+            switch (l_Index % 4) {
+                case 0:  l_Frame = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_I, (l_Index & 0x07), l_RandomBytes(16 + l_RandomGenerator() % 240)); break;
+                case 1:  l_Frame = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_S_RR, (l_Index & 0x07), std::vector<unsigned char>()); break;
+                case 2:  l_Frame = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_U_UI, 0, l_RandomBytes(16 + l_RandomGenerator() % 240)); break;
+                default: l_Frame = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_U_TEST, 0, std::vector<unsigned char>()); break;
+            } // switch
+            
+            l_TypicalStream.insert(l_TypicalStream.end(), l_Frame.begin(), l_Frame.end());
+            l_Frame = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_I, (l_Index & 0x07), l_EscapePayload);
+            l_EscapeStream.insert(l_EscapeStream.end(), l_Frame.begin(), l_Frame.end());
+            if (l_Index < 16) {
+                l_Frame = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_I, (l_Index & 0x07), l_MaxPayload);
+                l_MaxLengthStream.insert(l_MaxLengthStream.end(), l_Frame.begin(), l_Frame.end());
+            } // if
+        } // for
+        
+        std::vector<unsigned char> l_JunkStream = l_RandomBytes(16384);
+        std::vector<unsigned char> l_FcsBuffer = l_RandomBytes(4096);
+        
+        MicroBenchmark l_MicroBenchmark(l_VariablesMap["min-time"].as<double>(), l_VariablesMap["filter"].as<std::string>());
+        
+        // FCS
+        l_MicroBenchmark.Run("fcs16/4096", l_FcsBuffer.size(), [&]() {
+            volatile uint16_t l_Fcs = pppfcs16(PPPINITFCS16, l_FcsBuffer.data(), l_FcsBuffer.size());
+            (void)l_Fcs;
+            return 1;
+        });
+        
+        // Parser
+        FrameParser l_FrameParser;
+        std::vector<DeserializedFrame> l_DeserializedFrames;
+        l_MicroBenchmark.Run("parser/typical", l_TypicalStream.size(), [&]() {
+            return ParseStream(l_FrameParser, l_DeserializedFrames, l_TypicalStream, l_ChunkSize);
+        });
+        
+        l_MicroBenchmark.Run("parser/escape-heavy", l_EscapeStream.size(), [&]() {
+            return ParseStream(l_FrameParser, l_DeserializedFrames, l_EscapeStream, l_ChunkSize);
+        });
+        
+        l_MicroBenchmark.Run("parser/junk", l_JunkStream.size(), [&]() {
+            return ParseStream(l_FrameParser, l_DeserializedFrames, l_JunkStream, l_ChunkSize);
+        });
+        
+        l_MicroBenchmark.Run("parser/max-length", l_MaxLengthStream.size(), [&]() {
+            return ParseStream(l_FrameParser, l_DeserializedFrames, l_MaxLengthStream, l_ChunkSize);
+        });
+        
+        // Generator
+        HdlcFrame l_IFrame;
+        l_IFrame.SetAddress(0x30);
+        l_IFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_I);
+        l_IFrame.SetPayload(l_TypicalPayload);
+        HdlcFrame l_EscapeFrame = l_IFrame;
+        l_EscapeFrame.SetPayload(l_EscapePayload);
+        HdlcFrame l_MaxLengthFrame = l_IFrame;
+        l_MaxLengthFrame.SetPayload(l_MaxPayload);
+        HdlcFrame l_RRFrame;
+        l_RRFrame.SetAddress(0x30);
+        l_RRFrame.SetHDLCFrameType(HdlcFrame::HDLC_FRAMETYPE_S_RR);
+        
+        l_MicroBenchmark.Run("generator/typical", l_TypicalPayload.size(), [&]() {
+            volatile size_t l_Size = FrameGenerator::EscapeFrame(FrameGenerator::SerializeFrame(l_IFrame)).size();
+            (void)l_Size;
+            return 1;
+        });
+        
+        l_MicroBenchmark.Run("generator/escape-heavy", l_EscapePayload.size(), [&]() {
+            volatile size_t l_Size = FrameGenerator::EscapeFrame(FrameGenerator::SerializeFrame(l_EscapeFrame)).size();
+            (void)l_Size;
+            return 1;
+        });
+        
+        l_MicroBenchmark.Run("generator/max-length", l_MaxPayload.size(), [&]() {
+            volatile size_t l_Size = FrameGenerator::EscapeFrame(FrameGenerator::SerializeFrame(l_MaxLengthFrame)).size();
+            (void)l_Size;
+            return 1;
+        });
+        
+        l_MicroBenchmark.Run("generator/s-frame", 0, [&]() {
+            volatile size_t l_Size = FrameGenerator::EscapeFrame(FrameGenerator::SerializeFrame(l_RRFrame)).size();
+            (void)l_Size;
+            return 1;
+        });
+        
+        // Dissector, reusing the output buffer as the SnifferMirror does
+        std::vector<unsigned char> l_DissectedBuffer;
+        l_MicroBenchmark.Run("dissect/i-frame-hexdump", l_TypicalPayload.size(), [&]() {
+            l_IFrame.Dissect(l_DissectedBuffer, true);
+            return 1;
+        });
+        
+        l_MicroBenchmark.Run("dissect/s-frame", 0, [&]() {
+            l_RRFrame.Dissect(l_DissectedBuffer, true);
+            return 1;
+        });
+        
+        // ProtocolState: a full cycle of sending an I-frame or UI-frame, the write completion, and the ack of the peer
+        for (int l_bSniffers = 0; l_bSniffers <= 1; ++l_bSniffers) {
+            for (int l_bReliable = 1; l_bReliable >= 0; --l_bReliable) {
+                boost::asio::io_service l_IoService;
+                auto l_MockSerialPortHandler = std::make_shared<MockSerialPortHandler>(l_bSniffers != 0);
+                auto l_ProtocolState = std::make_shared<ProtocolState>(l_MockSerialPortHandler, l_IoService);
+                
+                // Become alive: the probe is answered by the peer
+                l_ProtocolState->Start();
+                l_ProtocolState->TriggerNextHDLCFrame();
+                std::vector<unsigned char> l_Test = CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_U_TEST, 0, std::vector<unsigned char>());
+                l_ProtocolState->AddReceivedRawBytes(l_Test.data(), l_Test.size());
+                
+                // The acks of the peer for all sequence numbers
+                std::vector<std::vector<unsigned char>> l_Acks;
+                for (unsigned char l_RSeq = 0; l_RSeq < 8; ++l_RSeq) {
+                    l_Acks.emplace_back(CreateEscapedFrame(HdlcFrame::HDLC_FRAMETYPE_S_RR, l_RSeq, std::vector<unsigned char>()));
+                } // for
+                
+                unsigned char l_SSeq = 0;
+                size_t l_Confirmations = 0;
+                std::string l_Name = (std::string("protocolstate/") + (l_bReliable ? "reliable" : "unreliable") + (l_bSniffers ? "+sniffers" : ""));
+                bool l_bRun = l_MicroBenchmark.Run(l_Name, l_TypicalPayload.size(), [&]() {
+                    l_ProtocolState->SendPayload(l_TypicalPayload, (l_bReliable != 0), [&l_Confirmations](E_PAYLOAD_CONFIRMATION) { ++l_Confirmations; });
+                    l_ProtocolState->TriggerNextHDLCFrame();
+                    if (l_bReliable) {
+                        l_SSeq = ((l_SSeq + 1) & 0x07);
+                        l_ProtocolState->AddReceivedRawBytes(l_Acks[l_SSeq].data(), l_Acks[l_SSeq].size());
+                    } // if
+                    
+                    // Completions of cancelled timers, and deliveries to sniffers
+                    l_IoService.poll();
+                    return 1;
+                });
+                
+                if ((l_bRun) && ((l_Confirmations == 0) || (l_MockSerialPortHandler->GetTransmittedFrames() < l_Confirmations))) {
+                    std::cerr << "hdlcd-microbench: " << l_Name << " did not complete its cycles" << std::endl;
+                } // if
+                
+                l_ProtocolState->Shutdown();
+                l_IoService.poll();
+            } // for
+        } // for
+        
+        l_MicroBenchmark.PrintResults(std::cout, (l_VariablesMap.count("json") != 0));
+        
+    } catch (std::exception& a_Error) {
+        std::cerr << "Exception: " << a_Error.what() << "\n";
+        return 1;
+    } // catch
+    
+    return 0;
+}
@@ -21,10 +21,21 @@
 
 #include "Config.h"
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <errno.h>
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
+#include "IoServicePool.h"
+#include "SerialIoThread.h"
 #include "SerialPortHandlerCollection.h"
 #include "HdlcdServerHandlerCollection.h"
+#include "SlowConsumerPolicy.h"
+#if !defined(BOOST_ASIO_WINDOWS)
+#include <sys/mman.h>
+#endif
 
 int main(int argc, char **argv) {
     try {
@@ -35,6 +46,37 @@ int main(int argc, char **argv) {
             ("version,v", "show version information")
             ("port,p",    boost::program_options::value<uint16_t>(),
                           "the TCP port to accept clients on")
+            ("unix,u",    boost::program_options::value<std::string>()->default_value(""),
+                          "the path of a unix domain socket to accept local clients on, in addition to the TCP port")
+            ("queue-packets", boost::program_options::value<size_t>()->default_value(100000),
+                          "the maximum number of data packets queued for each client, 0 for no limit")
+            ("queue-bytes",   boost::program_options::value<size_t>()->default_value(64 * 1024 * 1024),
+                          "the maximum number of bytes queued for each client, 0 for no limit")
+            ("slow-consumer", boost::program_options::value<std::string>()->default_value("drop-oldest"),
+                          "what to do if the queue of a client is full: drop-oldest, drop-newest, sample, or disconnect")
+            ("slow-payload-consumer", boost::program_options::value<std::string>()->default_value("disconnect"),
+                          "what to do if the queue of a payload client is full: drop-oldest, drop-newest, sample, or disconnect")
+            ("sample-rate",   boost::program_options::value<unsigned int>()->default_value(10),
+                          "keep one of N data packets if the queue of a client is full, for policy 'sample'")
+            ("prefetch",      boost::program_options::value<size_t>()->default_value(4),
+                          "the number of incoming data packets read ahead for each client, at least 1")
+            ("threads,t",     boost::program_options::value<size_t>()->default_value(1),
+                          "the number of event loops, each run by an own thread; each serial port and its clients are served by one of them")
+            ("cpu-affinity",  boost::program_options::value<std::string>()->default_value(""),
+                          "pin the event loops to CPUs, a comma-separated list with one CPU per event loop, e.g., 0,2,4,6")
+            ("place",         boost::program_options::value<std::vector<std::string>>()->composing(),
+                          "serve a serial port by a specific event loop, e.g., /dev/ttyUSB0=1; may be given multiple times")
+            ("serial-thread", boost::program_options::value<std::vector<std::string>>()->composing(),
+                          "read, write, and parse a serial port via a dedicated thread, e.g., /dev/ttyUSB0; may be given multiple times")
+            ("busy-poll",     boost::program_options::value<std::vector<std::string>>()->composing(),
+                          "serve a serial port via a dedicated thread that spins for some microseconds after each activity, e.g., /dev/ttyUSB0=50; may be given multiple times")
+            ("sched-fifo",    boost::program_options::value<int>()->default_value(0),
+                          "run the dedicated serial port threads with SCHED_FIFO and this priority, 1 to 99, or 0 for the default policy")
+            ("mlockall",      "lock all current and future memory pages of the daemon into RAM")
+            ("allow-transport", boost::program_options::value<std::string>()->default_value(""),
+                          "transports that clients may select via the serial port name, a comma-separated list of tcp, rfc2217, unix, and pty; serial port devices are always allowed")
+            ("pty-dir",       boost::program_options::value<std::string>()->default_value(""),
+                          "the directory in which clients may link pseudo terminals via pty:/path; without it, only pty: is accepted")
         ;
 
         // Parse the command line
@@ -59,6 +101,95 @@ int main(int argc, char **argv) {
             return 1;
         } // if
 
+#if !defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        if (!l_VariablesMap["unix"].as<std::string>().empty()) {
+            std::cout << "hdlcd: unix domain sockets are not supported on this platform" << std::endl;
+            return 1;
+        } // if
+#endif
+
+        size_t l_Threads = l_VariablesMap["threads"].as<size_t>();
+        if (l_Threads == 0) {
+            std::cout << "hdlcd: at least one thread is required" << std::endl;
+            return 1;
+        } // if
+
+#if defined(BOOST_ASIO_WINDOWS)
+        if (l_Threads > 1) {
+            std::cout << "hdlcd: multiple threads are not supported on this platform" << std::endl;
+            return 1;
+        } // if
+#endif
+
+        // CPU affinity of the event loops: one CPU per event loop
+        std::vector<unsigned int> l_Cpus;
+        std::stringstream l_CpuList(l_VariablesMap["cpu-affinity"].as<std::string>());
+        std::string l_Cpu;
+        while (std::getline(l_CpuList, l_Cpu, ',')) {
+            if ((l_Cpu.empty()) || (l_Cpu.find_first_not_of("0123456789") != std::string::npos)) {
+                std::cout << "hdlcd: invalid CPU " << l_Cpu << " in the CPU affinity list" << std::endl;
+                return 1;
+            } // if
+            
+            l_Cpus.emplace_back(std::stoul(l_Cpu));
+        } // while
+        
+        if ((!l_Cpus.empty()) && (!IoServicePool::IsCpuAffinitySupported())) {
+            std::cout << "hdlcd: CPU affinity is not supported on this platform" << std::endl;
+            return 1;
+        } // if
+        
+        if ((!l_Cpus.empty()) && (l_Cpus.size() != l_Threads)) {
+            std::cout << "hdlcd: the CPU affinity list must have one entry per thread" << std::endl;
+            return 1;
+        } // if
+
+        // Dedicated threads for serial ports
+        int l_SchedFifoPriority = l_VariablesMap["sched-fifo"].as<int>();
+        if ((l_SchedFifoPriority < 0) || (l_SchedFifoPriority > 99)) {
+            std::cout << "hdlcd: the SCHED_FIFO priority must be in the range 0 to 99" << std::endl;
+            return 1;
+        } // if
+        
+        if (((l_VariablesMap.count("serial-thread")) || (l_VariablesMap.count("busy-poll"))) && (!SerialIoThread::IsSupported())) {
+            std::cout << "hdlcd: dedicated serial port threads are not supported on this platform" << std::endl;
+            return 1;
+        } // if
+        
+        if ((l_SchedFifoPriority) && (!SerialIoThread::IsPrioritySupported())) {
+            std::cout << "hdlcd: SCHED_FIFO is not supported on this platform" << std::endl;
+            return 1;
+        } // if
+
+        if (l_VariablesMap.count("mlockall")) {
+#if !defined(BOOST_ASIO_WINDOWS)
+            // A failure is not fatal, e.g., if the memlock limit is too low
+            if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+                std::cerr << "Failed to lock the memory pages: " << ::strerror(errno) << std::endl;
+            } // if
+#else
+            std::cout << "hdlcd: locking memory pages is not supported on this platform" << std::endl;
+            return 1;
+#endif
+        } // if
+
+        // Limits of the send queues of each client
+        SlowConsumerPolicy l_SlowConsumerPolicy;
+        if (!l_SlowConsumerPolicy.SetAction(l_VariablesMap["slow-consumer"].as<std::string>())) {
+            std::cout << "hdlcd: unknown slow consumer policy " << l_VariablesMap["slow-consumer"].as<std::string>() << std::endl;
+            std::cout << "hdlcd: Use --help for more information." << std::endl;
+            return 1;
+        } // if
+
+        if (!l_SlowConsumerPolicy.SetPayloadAction(l_VariablesMap["slow-payload-consumer"].as<std::string>())) {
+            std::cout << "hdlcd: unknown slow consumer policy " << l_VariablesMap["slow-payload-consumer"].as<std::string>() << std::endl;
+            std::cout << "hdlcd: Use --help for more information." << std::endl;
+            return 1;
+        } // if
+
+        l_SlowConsumerPolicy.SetLimits(l_VariablesMap["queue-packets"].as<size_t>(), l_VariablesMap["queue-bytes"].as<size_t>());
+        l_SlowConsumerPolicy.SetSampleRate(l_VariablesMap["sample-rate"].as<unsigned int>());
+
         // Install signal handlers
         boost::asio::io_service l_IoService;
         boost::asio::signal_set l_Signals(l_IoService);
@@ -67,13 +198,73 @@ int main(int argc, char **argv) {
         l_Signals.async_wait([&l_IoService](boost::system::error_code, int){ l_IoService.stop(); });
         
         // Create and initialize components
-        auto l_SerialPortHandlerCollection  = std::make_shared<SerialPortHandlerCollection> (l_IoService);
-        auto l_HdlcdServerHandlerCollection = std::make_shared<HdlcdServerHandlerCollection>(l_IoService, l_SerialPortHandlerCollection, l_VariablesMap["port"].as<uint16_t>());
+        IoServicePool l_IoServicePool(l_IoService, l_Threads);
+        if (!l_Cpus.empty()) {
+            l_IoServicePool.SetCpuAffinity(l_Cpus);
+        } // if
+        
+        auto l_SerialPortHandlerCollection  = std::make_shared<SerialPortHandlerCollection> (l_IoServicePool);
+        if (l_VariablesMap.count("place")) {
+            // Placement of serial ports: PORT=LOOP, the serial port name may contain "=" itself
+            auto l_Placements = l_VariablesMap["place"].as<std::vector<std::string>>();
+            for (auto it = l_Placements.begin(); it != l_Placements.end(); ++it) {
+                size_t l_Separator = it->rfind('=');
+                std::string l_Index = ((l_Separator == std::string::npos) ? std::string() : it->substr(l_Separator + 1));
+                if ((l_Separator == 0) || (l_Index.empty()) || (l_Index.find_first_not_of("0123456789") != std::string::npos) ||
+                    (!l_SerialPortHandlerCollection->AssignIOService(it->substr(0, l_Separator), std::stoul(l_Index)))) {
+                    std::cout << "hdlcd: invalid placement " << *it << ", expected SERIALPORT=LOOP with LOOP less than the number of threads" << std::endl;
+                    return 1;
+                } // if
+            } // for
+        } // if
+        
+        // Serial ports with dedicated threads, optionally with busy polling
+        if (l_VariablesMap.count("serial-thread")) {
+            auto l_SerialPortNames = l_VariablesMap["serial-thread"].as<std::vector<std::string>>();
+            for (auto it = l_SerialPortNames.begin(); it != l_SerialPortNames.end(); ++it) {
+                l_SerialPortHandlerCollection->EnableSerialIoThread(*it, l_SchedFifoPriority);
+            } // for
+        } // if
+        
+        if (l_VariablesMap.count("busy-poll")) {
+            // Busy polling: PORT=MICROSECONDS, the serial port name may contain "=" itself
+            auto l_BusyPolls = l_VariablesMap["busy-poll"].as<std::vector<std::string>>();
+            for (auto it = l_BusyPolls.begin(); it != l_BusyPolls.end(); ++it) {
+                size_t l_Separator = it->rfind('=');
+                std::string l_Budget = ((l_Separator == std::string::npos) ? std::string() : it->substr(l_Separator + 1));
+                if ((l_Separator == 0) || (l_Budget.empty()) || (l_Budget.size() > 7) || (l_Budget.find_first_not_of("0123456789") != std::string::npos) ||
+                    (std::stoul(l_Budget) == 0) || (std::stoul(l_Budget) > 1000000)) {
+                    std::cout << "hdlcd: invalid busy polling " << *it << ", expected SERIALPORT=MICROSECONDS with 1 to 1000000 microseconds" << std::endl;
+                    return 1;
+                } // if
+                
+                l_SerialPortHandlerCollection->EnableSerialIoThread(it->substr(0, l_Separator), l_SchedFifoPriority, std::stoul(l_Budget));
+            } // for
+        } // if
+        
+        // Transports other than serial port devices, as these let clients make the daemon connect to other hosts or create links
+        std::stringstream l_TransportList(l_VariablesMap["allow-transport"].as<std::string>());
+        std::string l_Transport;
+        while (std::getline(l_TransportList, l_Transport, ',')) {
+            if (!l_SerialPortHandlerCollection->AllowTransport(l_Transport)) {
+                std::cout << "hdlcd: unknown transport " << l_Transport << ", expected tcp, rfc2217, unix, or pty" << std::endl;
+                return 1;
+            } // if
+        } // while
+        
+        if ((!l_VariablesMap["pty-dir"].as<std::string>().empty()) && (!l_SerialPortHandlerCollection->SetPtyLinkDirectory(l_VariablesMap["pty-dir"].as<std::string>()))) {
+            std::cout << "hdlcd: the directory for pseudo terminal links must be an absolute path" << std::endl;
+            return 1;
+        } // if
+        
+        auto l_HdlcdServerHandlerCollection = std::make_shared<HdlcdServerHandlerCollection>(l_IoService, l_SerialPortHandlerCollection, l_VariablesMap["port"].as<uint16_t>(), l_VariablesMap["unix"].as<std::string>(), l_SlowConsumerPolicy, l_VariablesMap["prefetch"].as<size_t>());
         
-        // Start event processing
+        // Start event processing. The main thread runs the first event loop, which also accepts the clients.
+        l_IoServicePool.Start();
         l_IoService.run();
         
-        // Shutdown
+        // Shutdown. All event loops are stopped first, thus, the remaining objects are released by the main thread.
+        l_IoServicePool.Stop();
         l_HdlcdServerHandlerCollection->Shutdown();
         l_SerialPortHandlerCollection->Shutdown();
         